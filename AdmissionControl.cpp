@@ -0,0 +1,88 @@
+//Standard library includes
+#include <algorithm>
+
+//Project includes
+#include "AdmissionControl.h"
+
+
+AdmissionController::AdmissionController(Limits inLimits) : m_limits{ inLimits } {
+	costClass(RequestCost::Cheap).limits = m_limits.cheap;
+	costClass(RequestCost::Moderate).limits = m_limits.moderate;
+	costClass(RequestCost::Expensive).limits = m_limits.expensive;
+
+	//Every class gets at least one thread, or its requests would be admitted and then never run.
+	for (auto& costClass : m_classes) {
+		costClass.limits.maxRunning = std::max(costClass.limits.maxRunning, 1u);
+		for (unsigned i = 0; i < costClass.limits.maxRunning; ++i) m_threads.emplace_back(&AdmissionController::run, this, std::ref(costClass));
+	}
+}
+
+
+bool AdmissionController::submit(RequestCost inCost, Job inJob) {
+	CostClass& target{ costClass(inCost) };
+	{
+		std::lock_guard lock{ m_mutex };
+		//A job can start at once if one of the class's threads is idle, so only the jobs beyond those count against the queue.
+		const std::size_t idleThreads{ target.limits.maxRunning - target.stats.running };
+		if (m_stopping || target.queue.size() >= target.limits.maxQueued + idleThreads) {
+			++target.stats.rejected;
+			return false;
+		}
+		target.queue.push_back({ std::move(inJob), std::chrono::steady_clock::now() });
+		++target.stats.admitted;
+		target.stats.queued = target.queue.size();
+		target.stats.peakQueued = std::max(target.stats.peakQueued, target.stats.queued);
+	}
+	target.jobReady.notify_one();
+	return true;
+}
+
+
+AdmissionController::ClassStats AdmissionController::stats(RequestCost inCost) const {
+	std::lock_guard lock{ m_mutex };
+	return costClass(inCost).stats;
+}
+
+
+void AdmissionController::stop() {
+	{
+		std::lock_guard lock{ m_mutex };
+		if (m_stopping) return;
+		m_stopping = true;
+		for (auto& costClass : m_classes) {
+			costClass.queue.clear();
+			costClass.stats.queued = 0;
+		}
+	}
+	for (auto& costClass : m_classes) costClass.jobReady.notify_all();
+	for (auto& thread : m_threads) thread.join();
+}
+
+
+void AdmissionController::run(CostClass& costClass) {
+	std::unique_lock lock{ m_mutex };
+	while (true) {
+		costClass.jobReady.wait(lock, [&] { return m_stopping || !costClass.queue.empty(); });
+		if (m_stopping) return;
+
+		QueuedJob next{ std::move(costClass.queue.front()) };
+		costClass.queue.pop_front();
+		const auto queueWait{ std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - next.admittedAt) };
+		costClass.stats.queued = costClass.queue.size();
+		costClass.stats.totalQueueWait += queueWait;
+		costClass.stats.maxQueueWait = std::max(costClass.stats.maxQueueWait, queueWait);
+		++costClass.stats.running;
+
+		lock.unlock();
+		try {
+			next.job();
+		}
+		catch (...) {
+			//Nothing we can do with it here, and it mustn't take the thread down. See submit().
+		}
+		lock.lock();
+
+		--costClass.stats.running;
+		++costClass.stats.completed;
+	}
+}
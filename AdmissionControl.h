@@ -0,0 +1,99 @@
+#pragma once
+
+//Standard library includes
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//Decides which requests a server runs, when, and which it turns away.
+//
+//Requests differ hugely in cost. A lookup by short name touches a handful of pages, while listing every customer or running someone's custom
+//SQL can scan the whole database and build a reply the size of it. If every request simply joined one queue for one pool of threads, a burst
+//of expensive ones would take every thread, and lookups would queue behind them - and an unbounded queue of them would grow until memory ran
+//out. So each request is given a cost class, and each class has:
+//	- its own threads, so that the number of requests of that class running at once is capped, and cheap requests always have threads of
+//	  their own no matter how many expensive ones are running, and
+//	- a bounded queue for requests waiting for one of those threads. A request which arrives to a full queue is rejected straight away,
+//	  so that the client hears "busy, try later" at once, instead of waiting out a queue it would most likely time out in anyway.
+
+enum class RequestCost {
+	Cheap,			//Point lookups and small writes, e.g. one customer by short name.
+	Moderate,		//Bounded searches, e.g. name similarity or a postcode, and single customer reports.
+	Expensive		//Anything which may scan a whole table: listing every customer, whole database reports, custom SQL, imports.
+};
+
+constexpr std::size_t requestCostClasses{ 3 };
+
+class AdmissionController {
+public:
+	struct ClassLimits {
+		unsigned maxRunning;		//Threads for this class, and so the most of its requests that run at once.
+		std::size_t maxQueued;		//Requests allowed to wait for one of them before more are rejected.
+	};
+
+	struct Limits {
+		ClassLimits cheap{ 4, 1024 };
+		ClassLimits moderate{ 2, 64 };
+		ClassLimits expensive{ 1, 4 };
+	};
+
+	struct ClassStats {
+		std::size_t admitted{ 0 };
+		std::size_t rejected{ 0 };
+		std::size_t completed{ 0 };
+		unsigned running{ 0 };
+		std::size_t queued{ 0 };
+		std::size_t peakQueued{ 0 };
+		std::chrono::microseconds totalQueueWait{ 0 };	//From being admitted to starting to run, over every request that has started.
+		std::chrono::microseconds maxQueueWait{ 0 };
+	};
+
+	using Job = std::function<void()>;
+
+	explicit AdmissionController(Limits inLimits);
+	AdmissionController() : AdmissionController{ Limits{} } {}
+	~AdmissionController() { stop(); }
+	AdmissionController(const AdmissionController&) = delete;
+	AdmissionController& operator=(const AdmissionController&) = delete;
+
+	//Queues the job to run on one of its class's threads, and returns true, or returns false straight away if the class's queue is full
+	//or we're stopping. Never blocks, so it's safe to call from an event loop. Exceptions thrown by the job are caught and dropped, so a
+	//job which needs to report an error must do it itself.
+	bool submit(RequestCost inCost, Job inJob);
+
+	ClassStats stats(RequestCost inCost) const;
+	const Limits& limits() const { return m_limits; }
+
+	//Waits for the running jobs to finish, then stops the threads. Jobs still queued are thrown away without being run.
+	void stop();
+
+private:
+	struct QueuedJob {
+		Job job;
+		std::chrono::steady_clock::time_point admittedAt;
+	};
+
+	struct CostClass {
+		ClassLimits limits;
+		std::deque<QueuedJob> queue;
+		ClassStats stats;
+		std::condition_variable jobReady;
+	};
+
+	void run(CostClass& costClass);
+	CostClass& costClass(RequestCost inCost) { return m_classes[static_cast<std::size_t>(inCost)]; }
+	const CostClass& costClass(RequestCost inCost) const { return m_classes[static_cast<std::size_t>(inCost)]; }
+
+	Limits m_limits;
+	mutable std::mutex m_mutex;
+	std::array<CostClass, requestCostClasses> m_classes;
+	std::vector<std::thread> m_threads;
+	bool m_stopping{ false };
+};
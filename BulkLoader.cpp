@@ -0,0 +1,463 @@
+//Standard library includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+//Project includes
+#include "BulkLoader.h"
+#include "CustomerTracker.h"
+#include "PreparedStatement.h"
+#include "CsvTokenizer.h"
+#include "MappedFile.h"
+#include "SchemaMigrations.h"
+#include "SqlFunctions.h"
+#include "ConnectionStatus.h"
+
+namespace {
+
+	//The INSERT statements the writer uses, and the file columns bound to each parameter, in order. A column of nullptr is bound separately.
+	const char* insertCustomerStatement{ "INSERT INTO Customers(Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) "
+		"VALUES (?,?,?,?,?,?,CAST(strftime('%s','now') AS INTEGER),CAST(strftime('%s','now') AS INTEGER));" };
+	const std::array<const char*, 6> customerColumns{ "Customer_Short_Name", "First_Name", "Last_Name", "Group_Name", "Credit_Limit", "Outstanding_Credit" };
+
+	const char* insertAddressStatement{ "INSERT INTO CustomerAddress(Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) "
+		"VALUES (?,?,?,?,?,?,?,?,CAST(strftime('%s','now') AS INTEGER),CAST(strftime('%s','now') AS INTEGER));" };
+	const std::array<const char*, 8> addressColumns{ nullptr, "Address_Type", "Contact_Name", "Address_Line_1", "Address_Line_2", "Address_Line_3", "Address_Line_4", "Address_Line_5" };
+
+	constexpr std::size_t maxParameters{ 8 };
+	constexpr int missingColumn{ -1 };
+
+	//Short names are matched without regard to case, like the Customers_Short_Name_NoCase index.
+	std::string foldShortName(std::string_view inName) {
+		std::string folded{ inName };
+		for (char& c : folded) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		return folded;
+	}
+
+
+	//A validated row, ready to bind. Text fields view either the mapped file or the owning batch's storage. Empty views bind as NULL.
+	struct LoadRow {
+		std::array<std::string_view, maxParameters> text;
+		sqlite3_int64 customerID{ 0 };
+		sqlite3_int64 creditLimit{ 0 };
+		sqlite3_int64 outstandingCredit{ 0 };
+		std::size_t line{ 0 };			//Line within the chunk.
+	};
+
+	//Everything a worker produces from one chunk.
+	struct LoadBatch {
+		std::vector<LoadRow> rows;
+		std::vector<BulkLoadRejection> rejections;		//Lines within the chunk, until the writer makes them absolute.
+		std::deque<std::string> storage;				//Copies of any fields that couldn't be left in the mapped file.
+		std::size_t recordsRead{ 0 };
+		std::size_t lines{ 0 };							//Lines in the chunk, so the writer can number the next chunk's lines.
+		std::exception_ptr error;						//Set if the chunk couldn't be parsed at all.
+	};
+
+
+	//A bounded queue which hands items out in sequence order, however they were pushed. Item n can only be pushed once item n - capacity has been
+	//popped, so a worker that races ahead waits, and at most capacity finished batches are ever held in memory. The worker holding the next
+	//item the writer needs is never made to wait, so this can't deadlock.
+	template <typename T>
+	class OrderedBoundedQueue {
+	public:
+		explicit OrderedBoundedQueue(std::size_t inCapacity) : m_slots(inCapacity) {}
+
+		//Blocks until there's room for item inSequence. Returns false if the queue was closed while waiting.
+		bool push(std::size_t inSequence, T&& inItem) {
+			std::unique_lock lock{ m_mutex };
+			m_notFull.wait(lock, [&] { return m_closed || inSequence < m_nextToPop + m_slots.size(); });
+			if (m_closed) return false;
+			m_slots[inSequence % m_slots.size()] = std::move(inItem);
+			m_notEmpty.notify_all();
+			return true;
+		}
+
+		//Blocks until the next item in sequence arrives. Returns nothing if the queue was closed.
+		std::optional<T> pop() {
+			std::unique_lock lock{ m_mutex };
+			auto& slot{ m_slots[m_nextToPop % m_slots.size()] };
+			m_notEmpty.wait(lock, [&] { return m_closed || slot.has_value(); });
+			if (!slot) return std::nullopt;
+			std::optional<T> item{ std::move(slot) };
+			slot.reset();
+			++m_nextToPop;
+			m_notFull.notify_all();
+			return item;
+		}
+
+		//Wakes everyone up, and makes every push and pop fail from then on.
+		void close() {
+			std::lock_guard lock{ m_mutex };
+			m_closed = true;
+			m_notFull.notify_all();
+			m_notEmpty.notify_all();
+		}
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_notFull, m_notEmpty;
+		std::vector<std::optional<T>> m_slots;
+		std::size_t m_nextToPop{ 0 };
+		bool m_closed{ false };
+	};
+
+
+	//What a worker needs to turn a chunk into a batch. Read-only once the workers start, so shared between them without locking.
+	struct LoadContext {
+		BulkLoadKind kind;
+		char delimiter;
+		std::string_view fileContents;
+		std::array<int, maxParameters> fieldIndexes{};			//Which field of a record holds each parameter's column, or missingColumn.
+		int shortNameField{ missingColumn };
+		std::unordered_map<std::string, sqlite3_int64> customerIDs{};	//Existing customers, by folded short name.
+	};
+
+	//Parses a whole number, allowing an empty field to mean 0.
+	bool parseAmount(std::string_view inField, sqlite3_int64& outValue) {
+		outValue = 0;
+		if (inField.empty()) return true;
+		auto [end, error] { std::from_chars(inField.data(), inField.data() + inField.size(), outValue) };
+		return error == std::errc{} && end == inField.data() + inField.size();
+	}
+
+	//Keeps a field alive for the rest of the load. Fields still inside the mapped file are already safe. Anything else lives in the tokenizer,
+	//and is only valid until the next record, so we take a copy.
+	std::string_view keepField(const LoadContext& inContext, LoadBatch& batch, std::string_view inField) {
+		const char* begin{ inContext.fileContents.data() };
+		if (inField.empty() || (inField.data() >= begin && inField.data() + inField.size() <= begin + inContext.fileContents.size())) return inField;
+		return batch.storage.emplace_back(inField);
+	}
+
+	LoadBatch parseChunk(const LoadContext& inContext, std::string_view inChunk) {
+		LoadBatch batch;
+		try {
+			CsvTokenizer tokenizer{ inChunk, inContext.delimiter };
+			std::vector<std::string_view> fields;
+			while (tokenizer.nextRecord(fields)) {
+				++batch.recordsRead;
+				auto field{ [&](int index) { return index >= 0 && static_cast<std::size_t>(index) < fields.size() ? fields[index] : std::string_view{}; } };
+				auto reject{ [&](std::string reason) { batch.rejections.push_back({ tokenizer.recordLine(), std::move(reason) }); } };
+
+				LoadRow row;
+				row.line = tokenizer.recordLine();
+
+				//Short names are stored normalised, so a name with stray whitespace needs tidying, which means a copy. Most won't.
+				std::string_view shortName{ field(inContext.shortNameField) };
+				if (shortName.find("  ") != std::string_view::npos || shortName.find_first_of("\t\r\n") != std::string_view::npos
+					|| (!shortName.empty() && (shortName.front() == ' ' || shortName.back() == ' '))) {
+					std::string normalised{ shortName };
+					normaliseShortName(normalised);
+					shortName = batch.storage.emplace_back(std::move(normalised));
+				}
+				if (shortName.empty()) {
+					reject("No customer short name");
+					continue;
+				}
+				auto existing{ inContext.customerIDs.find(foldShortName(shortName)) };
+
+				for (std::size_t i = 0; i < maxParameters; ++i) row.text[i] = keepField(inContext, batch, field(inContext.fieldIndexes[i]));
+
+				if (inContext.kind == BulkLoadKind::Customers) {
+					if (existing != inContext.customerIDs.end()) {
+						reject("Customer " + std::string{ shortName } + " already exists");
+						continue;
+					}
+					row.text[0] = keepField(inContext, batch, shortName);
+					if (!parseAmount(row.text[4], row.creditLimit) || !parseAmount(row.text[5], row.outstandingCredit)) {
+						reject("Credit amounts must be whole numbers");
+						continue;
+					}
+				}
+				else {
+					if (existing == inContext.customerIDs.end()) {
+						reject("No customer with short name " + std::string{ shortName });
+						continue;
+					}
+					row.customerID = existing->second;
+					if (row.text[3].empty()) {
+						reject("No first address line");
+						continue;
+					}
+				}
+				batch.rows.push_back(row);
+			}
+			batch.lines = tokenizer.line() - 1;
+		}
+		catch (...) {
+			batch.error = std::current_exception();
+		}
+		return batch;
+	}
+
+	//Builds the context for a load from the file's header line, returning the rest of the file.
+	std::string_view readHeader(sqlite3* db, LoadContext& context) {
+		CsvTokenizer headerTokenizer{ context.fileContents, context.delimiter };
+		std::vector<std::string_view> header;
+		if (!headerTokenizer.nextRecord(header)) throw std::runtime_error{ "The file is empty" };
+
+		auto findColumn{ [&](const char* name) {
+			if (!name) return missingColumn;
+			for (std::size_t i = 0; i < header.size(); ++i) {
+				if (foldShortName(header[i]) == foldShortName(name)) return static_cast<int>(i);
+			}
+			return missingColumn;
+		} };
+
+		const bool customers{ context.kind == BulkLoadKind::Customers };
+		context.fieldIndexes.fill(missingColumn);
+		for (std::size_t i = 0; i < (customers ? customerColumns.size() : addressColumns.size()); ++i) {
+			context.fieldIndexes[i] = findColumn(customers ? customerColumns[i] : addressColumns[i]);
+		}
+		context.shortNameField = findColumn("Customer_Short_Name");
+		if (context.shortNameField == missingColumn) throw std::runtime_error{ "The file has no Customer_Short_Name column" };
+		if (!customers && context.fieldIndexes[3] == missingColumn) throw std::runtime_error{ "The file has no Address_Line_1 column" };
+
+		PreparedStatement selectCustomers{ db, "SELECT Customer_ID, Customer_Short_Name FROM Customers;" };
+		while (selectCustomers.stepRow()) {
+			context.customerIDs.emplace(foldShortName(selectCustomers.columnText(1)), sqlite3_column_int64(selectCustomers.get(), 0));
+		}
+
+		return context.fileContents.substr(headerTokenizer.position());
+	}
+
+	void bindRow(PreparedStatement& insert, BulkLoadKind inKind, const LoadRow& inRow) {
+		sqlite3_stmt* statement{ insert.get() };
+		sqlite3_reset(statement);
+		const int parameters{ sqlite3_bind_parameter_count(statement) };
+		for (int i = 0; i < parameters; ++i) {
+			//The mapped file outlives the statement's use of these, so SQLite doesn't need its own copy.
+			if (inRow.text[i].empty()) sqlite3_bind_null(statement, i + 1);
+			else sqlite3_bind_text(statement, i + 1, inRow.text[i].data(), static_cast<int>(inRow.text[i].size()), SQLITE_STATIC);
+		}
+		if (inKind == BulkLoadKind::Customers) {
+			sqlite3_bind_int64(statement, 5, inRow.creditLimit);
+			sqlite3_bind_int64(statement, 6, inRow.outstandingCredit);
+		}
+		else sqlite3_bind_int64(statement, 1, inRow.customerID);
+	}
+
+	//Runs the load itself: workers parse the body of the file in parallel, while this thread writes the rows into target, in one transaction
+	//or in chunks as inLimits says.
+	void runPipeline(sqlite3* target, const LoadContext& context, std::string_view body, const BulkLoadOptions& inOptions, const BatchWriteLimits& inLimits, BulkLoadResult& result) {
+		const std::vector<std::string_view> chunks{ splitCsvChunks(body, inOptions.chunkSize) };
+
+		//One worker per core, leaving a core for the writer, but never more workers than there are chunks to give them.
+		unsigned workers{ inOptions.workerThreads };
+		if (workers == 0) workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		workers = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(workers, chunks.size())));
+		result.workerThreads = workers;
+
+		OrderedBoundedQueue<LoadBatch> queue{ std::max<std::size_t>(inOptions.queueCapacity, 1) };
+		std::atomic<std::size_t> nextChunk{ 0 };
+		std::vector<std::thread> workerThreads;
+		//However we leave, the workers must be stopped and joined first, as they refer to everything above.
+		struct WorkerJoiner {
+			OrderedBoundedQueue<LoadBatch>& queue;
+			std::vector<std::thread>& threads;
+			~WorkerJoiner() {
+				queue.close();
+				for (auto& thread : threads) thread.join();
+			}
+		} joiner{ queue, workerThreads };
+
+		for (unsigned i = 0; i < workers; ++i) {
+			workerThreads.emplace_back([&] {
+				for (std::size_t chunk{ nextChunk++ }; chunk < chunks.size(); chunk = nextChunk++) {
+					if (!queue.push(chunk, parseChunk(context, chunks[chunk]))) return;
+				}
+			});
+		}
+
+		//Everything from here on is the writer.
+		BatchWriter writer{ target, inLimits };
+		try {
+			PreparedStatement insert{ target, context.kind == BulkLoadKind::Customers ? insertCustomerStatement : insertAddressStatement };
+			std::size_t lineBase{ 1 };			//The header is line 1, and each chunk's lines are counted from the end of the last one.
+
+			for (std::size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+				std::optional<LoadBatch> batch{ queue.pop() };
+				if (!batch) throw std::runtime_error{ "The import was stopped" };
+				if (batch->error) std::rethrow_exception(batch->error);
+
+				for (auto& rejection : batch->rejections) {
+					rejection.line += lineBase;
+					result.rejections.push_back(std::move(rejection));
+				}
+				for (const auto& row : batch->rows) {
+					bindRow(insert, context.kind, row);
+					int stepStatus{ sqlite3_step(insert.get()) };
+					if (stepStatus == SQLITE_DONE) {
+						++result.rowsInserted;
+						writer.rowWritten();
+					}
+					//A duplicate within the file itself only shows up here, when the unique index sees it. That's the row's problem, not the load's.
+					else if (stepStatus == SQLITE_CONSTRAINT) result.rejections.push_back({ row.line + lineBase, sqlite3_errmsg(target) });
+					else throw std::runtime_error{ "Error inserting row from line " + std::to_string(row.line + lineBase) + ": " + sqlite3_errmsg(target) };
+				}
+				result.rowsRead += batch->recordsRead;
+				lineBase += batch->lines;
+				if (inOptions.onProgress) inOptions.onProgress();
+			}
+			writer.commit();
+			result.transactions = writer.chunksCommitted();
+			result.secondsYielded = writer.timeYielded().count() / 1000.0;
+		}
+		catch (std::exception& e) {
+			//The writer rolls back the chunk it was on. With one chunk that's everything, but earlier chunks are already in, and whoever
+			//started the load needs to know that.
+			if (writer.chunksCommitted() == 0) throw;
+			throw std::runtime_error{ std::string{ e.what() } + " (the first " + std::to_string(writer.rowsCommitted()) + " rows were already committed, and have been kept)" };
+		}
+	}
+
+
+	//A scratch copy of the database for a rebuild-mode load, deleted again when this goes out of scope - whether or not the load worked.
+	class StagingDatabase {
+	public:
+		explicit StagingDatabase(std::string inPath) : m_path{ std::move(inPath) } {
+			removeFiles();		//A load which was killed part way through may have left one behind.
+			if (sqlite3_open_v2(m_path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK) {
+				std::string errorMessage{ "Error creating staging database: " + std::string{ sqlite3_errmsg(m_db) } };
+				sqlite3_close(m_db);
+				throw std::runtime_error{ errorMessage };
+			}
+			registerConnection(m_db, "Bulk load staging");
+		}
+		~StagingDatabase() {
+			unregisterConnection(m_db);
+			sqlite3_close(m_db);
+			removeFiles();
+		}
+		StagingDatabase(const StagingDatabase&) = delete;
+		StagingDatabase& operator=(const StagingDatabase&) = delete;
+
+		sqlite3* get() const { return m_db; }
+
+	private:
+		void removeFiles() const {
+			std::remove(m_path.c_str());
+			std::remove((m_path + "-journal").c_str());
+			std::remove((m_path + "-wal").c_str());
+		}
+
+		std::string m_path;
+		sqlite3* m_db{ nullptr };
+	};
+
+	//SQLite's count of the changes it has seen made to a connection's database file, by any connection. It's only brought up to date when
+	//the connection next takes a lock on the file, so two readings are the same if nothing was committed between the locks they follow.
+	unsigned int dataVersion(sqlite3* db) {
+		unsigned int version{ 0 };
+		if (sqlite3_file_control(db, "main", SQLITE_FCNTL_DATA_VERSION, &version) != SQLITE_OK) {
+			throw std::runtime_error{ "Error reading database version: " + std::string{ sqlite3_errmsg(db) } };
+		}
+		return version;
+	}
+
+	//Copies the whole of one database over another with the backup API. The destination is written through its own journal,
+	//so if we're interrupted part way through it rolls back to how it was before.
+	//Given inUnchangedSince, the copy is only made if the destination's data version still has that value once we hold its write lock. This is
+	//checked and the copy made under the one lock, so nothing can be committed in between and then lost under the copy.
+	void copyDatabase(sqlite3* from, sqlite3* to, std::optional<unsigned int> inUnchangedSince = std::nullopt) {
+		sqlite3_backup* backup{ sqlite3_backup_init(to, "main", from, "main") };
+		if (!backup) throw std::runtime_error{ "Error starting database copy: " + std::string{ sqlite3_errmsg(to) } };
+		//A step of no pages takes the destination's write lock (waiting through its busy handler if need be) without copying anything.
+		int stepStatus{ inUnchangedSince ? sqlite3_backup_step(backup, 0) : SQLITE_OK };
+		if (stepStatus == SQLITE_OK && inUnchangedSince && dataVersion(to) != *inUnchangedSince) {
+			sqlite3_backup_finish(backup);		//Releases the lock with nothing written.
+			throw std::runtime_error{ "The database was changed by another connection while the load was running, so the load was abandoned "
+				"rather than copied over those changes" };
+		}
+		if (stepStatus == SQLITE_OK) stepStatus = sqlite3_backup_step(backup, -1);
+		sqlite3_backup_finish(backup);
+		if (stepStatus != SQLITE_DONE) throw std::runtime_error{ "Error copying database: " + std::string{ sqlite3_errstr(stepStatus) } };
+	}
+
+	sqlite3_int64 selectMax(sqlite3* db, const char* inStatement) {
+		PreparedStatement selectMaximum{ db, inStatement };
+		return selectMaximum.stepRow() ? sqlite3_column_int64(selectMaximum.get(), 0) : 0;
+	}
+
+	//Rebuild mode. The load goes into a copy of the database with the customer and address indexes and triggers dropped, and with journalling
+	//and syncing turned off, which together make inserts several times faster. Once the rows are in, we do what the triggers would have done in
+	//a few set-based statements, rebuild each index in one sorted pass, put the triggers back, ANALYZE, and copy the result over the real database.
+	//Until that final copy the real database is never touched, and the copy itself is journalled, so the load can be interrupted at any point.
+	//Anything committed to the real database while we work would be lost under the copy, so if anything was, the load is thrown away instead.
+	void runRebuildLoad(sqlite3* db, const LoadContext& context, std::string_view body, const BulkLoadOptions& inOptions, BulkLoadResult& result) {
+		const char* databasePath{ sqlite3_db_filename(db, "main") };
+		if (!databasePath || !*databasePath) throw std::runtime_error{ "Rebuild mode needs a database file to stage the load beside" };
+
+		StagingDatabase staging{ std::string{ databasePath } + "-bulkload" };
+		registerSqlFunctions(staging.get());		//The expression index and the triggers we recreate call our functions.
+		copyDatabase(db, staging.get());
+		const unsigned int copiedVersion{ dataVersion(db) };		//The version the copy was read at, as it was read under a lock just now.
+		//Nothing written to the staging copy matters until it is complete, so it needs neither a journal nor syncing. A bigger cache speeds up the index sorts.
+		//journal_mode returns the new mode as a row, which executeStatement would print, so this goes straight to sqlite3_exec.
+		if (sqlite3_exec(staging.get(), "PRAGMA journal_mode = OFF; PRAGMA synchronous = OFF; PRAGMA cache_size = -262144;", NULL, NULL, NULL) != SQLITE_OK) {
+			throw std::runtime_error{ "Error configuring staging database: " + std::string{ sqlite3_errmsg(staging.get()) } };
+		}
+
+		//Take note of the secondary indexes and triggers, then drop them. Indexes made by UNIQUE constraints can't be dropped, and have no sql.
+		std::vector<std::string> indexDefinitions, triggerDefinitions;
+		{
+			PreparedStatement selectSchema{ staging.get(), "SELECT type, name, sql FROM sqlite_master WHERE type IN ('index', 'trigger') AND sql IS NOT NULL "
+				"AND tbl_name IN ('Customers', 'CustomerAddress');" };
+			std::vector<std::string> dropStatements;
+			while (selectSchema.stepRow()) {
+				const std::string type{ selectSchema.columnText(0) };
+				(type == "index" ? indexDefinitions : triggerDefinitions).push_back(selectSchema.columnText(2));
+				dropStatements.push_back("DROP " + type + " \"" + selectSchema.columnText(1) + "\";");
+			}
+			for (const auto& statement : dropStatements) executeStatement(statement, staging.get(), false);
+		}
+
+		const sqlite3_int64 lastCustomerID{ selectMax(staging.get(), "SELECT COALESCE(MAX(Customer_ID), 0) FROM Customers;") };
+		const sqlite3_int64 lastAddressID{ selectMax(staging.get(), "SELECT COALESCE(MAX(Address_ID), 0) FROM CustomerAddress;") };
+
+		runPipeline(staging.get(), context, body, inOptions, {}, result);
+		if (result.rowsInserted == 0) return;		//Nothing to copy back.
+
+		//Derived columns first, while there are no indexes on them to keep up to date.
+		applyInsertTriggerEffects(staging.get(), lastCustomerID, lastAddressID);
+		for (const auto& definition : indexDefinitions) {
+			executeStatement(definition, staging.get(), false);
+			if (inOptions.onProgress) inOptions.onProgress();
+		}
+		for (const auto& definition : triggerDefinitions) executeStatement(definition, staging.get(), false);
+		executeStatement("ANALYZE;", staging.get(), false);
+
+		copyDatabase(staging.get(), db, copiedVersion);
+	}
+
+}
+
+
+BulkLoadResult bulkLoad(sqlite3* db, const std::string& inPath, BulkLoadKind inKind, const BulkLoadOptions& inOptions) {
+	const auto startTime{ std::chrono::steady_clock::now() };
+	BulkLoadResult result;
+
+	MappedFile file{ inPath };
+	LoadContext context{ inKind, inOptions.delimiter, file.contents() };
+	std::string_view body{ readHeader(db, context) };
+	if (inOptions.rebuildIndexes) runRebuildLoad(db, context, body, inOptions, result);
+	else runPipeline(db, context, body, inOptions, inOptions.transactionLimits, result);
+
+	//Rejections within a chunk are in order, but constraint failures are found after the chunk's validation failures.
+	std::stable_sort(result.rejections.begin(), result.rejections.end(), [](const auto& lhs, const auto& rhs) { return lhs.line < rhs.line; });
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return result;
+}
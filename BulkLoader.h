@@ -0,0 +1,70 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "WriteScheduler.h"
+
+
+//Bulk imports of customers or addresses from CSV (or TSV) files.
+//
+//The first line of the file is a header naming the columns, which may come in any order. Unknown columns are ignored, so a file from the
+//Export Changes report can be loaded back in. Customer files need a Customer_Short_Name column, and may have First_Name, Last_Name, Group_Name,
+//Credit_Limit and Outstanding_Credit. Address files need Customer_Short_Name and Address_Line_1, and may have Address_Type, Contact_Name and
+//Address_Line_2 to Address_Line_5. Empty fields are stored as NULL, except credit amounts, which default to 0.
+//
+//The load is pipelined. The file is memory mapped and split into chunks, which worker threads tokenize, validate and (for addresses) resolve
+//short names for in parallel. The finished batches pass in file order through a bounded queue to a single writer - the calling thread - which
+//owns the prepared INSERT and is the only thread to touch the database. Rows which fail validation are reported and skipped. Anything worse
+//rolls the whole load back, so an import either goes in completely (bar its rejected rows) or not at all - unless transactionLimits are given,
+//in which case the load is committed a chunk at a time, giving way to interactive writers in between (see WriteScheduler.h), and anything
+//worse only rolls back the chunk it happened in.
+
+
+enum class BulkLoadKind { Customers, Addresses };
+
+struct BulkLoadOptions {
+	char delimiter{ ',' };
+	unsigned workerThreads{ 0 };				//0 to use one per core, leaving one for the writer.
+	std::size_t chunkSize{ 4 << 20 };			//Bytes of input handed to a worker at a time.
+	std::size_t queueCapacity{ 8 };				//Parsed chunks allowed to wait for the writer before the workers stop and wait too.
+	bool rebuildIndexes{ false };				//For very large loads. Drop the indexes and triggers, load into a staging copy, then rebuild. See bulkLoad().
+	BatchWriteLimits transactionLimits;			//How much to write in each transaction. No limit by default, so the load is all or nothing.
+	std::function<void()> onProgress;			//Called by the writer after each chunk and each index rebuilt, if set, e.g. to hold off maintenance.
+};
+
+//A row which was skipped, and why.
+struct BulkLoadRejection {
+	std::size_t line;
+	std::string reason;
+};
+
+struct BulkLoadResult {
+	std::size_t rowsRead{ 0 };
+	std::size_t rowsInserted{ 0 };
+	std::vector<BulkLoadRejection> rejections;
+	unsigned workerThreads{ 0 };
+	std::size_t transactions{ 0 };
+	double secondsYielded{ 0 };					//Time spent between transactions letting interactive writers go first.
+	double seconds{ 0 };
+};
+
+//Rebuild mode (rebuildIndexes) is for loads big enough that maintaining the indexes row by row is the bottleneck. The database is copied to a
+//staging file beside it, the load is made into the copy with its indexes and triggers dropped and journalling off, and the indexes are then
+//rebuilt in one pass each and ANALYZE run before the copy replaces the database. The database is untouched until then, so an interrupted load
+//leaves it as it was. No lock is held on the database while the load runs, so other connections can carry on reading and writing, but a load
+//which anything else committed to in the meantime would lose those changes when copied back. Instead, such a load is abandoned (throwing
+//std::runtime_error with nothing loaded) and should be run again, preferably at a quieter time. This needs room for a second copy of the database, and because the case-insensitive short name index is only rebuilt
+//at the end, two short names in the file which differ only in case fail the whole load rather than just the second row. The staging copy is
+//ours alone, so transactionLimits don't apply to it, and the copy back is a single write.
+
+//Loads the file at inPath into the table given by inKind. Throws std::runtime_error if the file can't be read, its header is missing a required
+//column, or the database rejects the load, in which case nothing is loaded.
+BulkLoadResult bulkLoad(sqlite3* db, const std::string& inPath, BulkLoadKind inKind, const BulkLoadOptions& inOptions = {});
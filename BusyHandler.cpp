@@ -0,0 +1,59 @@
+//Standard library includes
+#include <algorithm>
+#include <thread>
+
+//Project includes
+#include "BusyHandler.h"
+
+
+void BusyHandler::install(sqlite3* db) {
+	sqlite3_busy_handler(db, &BusyHandler::callback, this);
+}
+
+
+BusyHandler::Stats BusyHandler::stats() const {
+	std::lock_guard lock{ m_mutex };
+	return m_stats;
+}
+
+
+int BusyHandler::callback(void* inHandler, int inPriorCalls) {
+	return static_cast<BusyHandler*>(inHandler)->wait(inPriorCalls);
+}
+
+
+//Called by SQLite each time it finds the database locked, with the number of times it has already called us for this lock. Sleeps and
+//returns non-zero to have SQLite try again, or returns 0 to give up. SQLite only calls this from the thread using the connection.
+int BusyHandler::wait(int inPriorCalls) {
+	const auto now{ std::chrono::steady_clock::now() };
+	if (inPriorCalls == 0) {
+		m_waitBegan = now;
+		m_waitCounted = std::chrono::microseconds{ 0 };
+		std::lock_guard lock{ m_mutex };
+		++m_stats.waits;
+	}
+
+	const auto waitedSoFar{ std::chrono::duration_cast<std::chrono::microseconds>(now - m_waitBegan) };
+	const auto remaining{ std::chrono::duration_cast<std::chrono::microseconds>(m_settings.timeout) - waitedSoFar };
+	if (remaining.count() <= 0) {
+		std::lock_guard lock{ m_mutex };
+		++m_stats.timeouts;
+		return 0;
+	}
+
+	//Double the delay with each call, taking care not to overflow the shift on a long wait.
+	const long long initialDelay{ std::chrono::duration_cast<std::chrono::microseconds>(m_settings.initialDelay).count() };
+	const long long maxDelay{ std::chrono::duration_cast<std::chrono::microseconds>(m_settings.maxDelay).count() };
+	const long long nominalDelay{ std::max(std::min(initialDelay << std::min(inPriorCalls, 20), maxDelay), 1LL) };
+	std::uniform_int_distribution<long long> jitter{ nominalDelay / 2, nominalDelay };
+	const std::chrono::microseconds delay{ std::min<long long>(jitter(m_random), remaining.count()) };
+	std::this_thread::sleep_for(delay);
+
+	const auto waited{ std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_waitBegan) };
+	std::lock_guard lock{ m_mutex };
+	++m_stats.retries;
+	m_stats.totalWait += waited - m_waitCounted;
+	m_waitCounted = waited;
+	m_stats.maxWait = std::max(m_stats.maxWait, waited);
+	return 1;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+//Standard library includes
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//What a connection does when another connection (in this program or another copy of it) holds the lock it needs. Rather than fail with
+//SQLITE_BUSY straight away, it sleeps and tries again, doubling the sleep each time up to a limit and giving up only once it has waited
+//for the whole timeout. Each sleep is jittered (somewhere between half and all of the nominal delay), so that two connections which
+//collided once don't keep retrying in lockstep and colliding again. Every wait is counted, so contention shows up in the SQLite statistics
+//report as time spent waiting rather than as errors.
+//
+//NB: SQLite can't wait for a lock if waiting could deadlock - e.g. a deferred transaction which has read and now wants to write, while another
+//connection holds a pending write lock - and returns SQLITE_BUSY without calling the handler. Transactions which will write should start with
+//BEGIN IMMEDIATE, so that they wait for the write lock up front, where the handler can help.
+class BusyHandler {
+public:
+	struct Settings {
+		std::chrono::milliseconds initialDelay{ 1 };		//The first sleep. Each one after is twice as long as the last,
+		std::chrono::milliseconds maxDelay{ 100 };			//up to this.
+		std::chrono::milliseconds timeout{ 5000 };			//Give up with SQLITE_BUSY once we've waited this long in all.
+	};
+
+	struct Stats {
+		std::size_t waits{ 0 };								//Times the connection found the database locked.
+		std::size_t retries{ 0 };							//Sleeps taken between them.
+		std::size_t timeouts{ 0 };							//Waits which gave up, and so reached the caller as SQLITE_BUSY.
+		std::chrono::microseconds totalWait{ 0 };
+		std::chrono::microseconds maxWait{ 0 };
+	};
+
+	explicit BusyHandler(Settings inSettings) : m_settings{ inSettings } {}
+	BusyHandler() : BusyHandler{ Settings{} } {}
+	BusyHandler(const BusyHandler&) = delete;
+	BusyHandler& operator=(const BusyHandler&) = delete;
+
+	//Makes this the connection's busy handler, in place of any busy timeout. The handler must outlive the connection.
+	void install(sqlite3* db);
+
+	Stats stats() const;
+	const Settings& settings() const { return m_settings; }
+
+private:
+	static int callback(void* inHandler, int inPriorCalls);
+	int wait(int inPriorCalls);
+
+	Settings m_settings;
+	std::minstd_rand m_random{ std::random_device{}() };
+	std::chrono::steady_clock::time_point m_waitBegan{};
+	std::chrono::microseconds m_waitCounted{ 0 };		//How much of the current wait has already been added to the total.
+
+	mutable std::mutex m_mutex;							//Guards m_stats, which the statistics report reads from other threads.
+	Stats m_stats;
+};
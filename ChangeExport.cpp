@@ -0,0 +1,126 @@
+//Standard library includes
+#include <cstdio>
+#include <stdexcept>
+
+//Project includes
+#include "ChangeExport.h"
+#include "CustomerTracker.h"
+#include "PreparedStatement.h"
+
+namespace {
+
+	//The statements behind the export. Both read their own table's Updated_On index from inSince to the end, and nothing else.
+	const char* changedCustomersStatement{ "SELECT Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On "
+		"FROM Customers WHERE Updated_On >= ? ORDER BY Updated_On;" };
+	const char* changedAddressesStatement{ "SELECT Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, "
+		"Postcode, Created_On, Updated_On FROM CustomerAddress WHERE Updated_On >= ? ORDER BY Updated_On;" };
+
+	//Days since 1970-01-01 to a calendar date, using the proleptic Gregorian calendar. This is the well-known algorithm from Howard Hinnant's
+	//date library, which avoids gmtime() and its thread safety and portability problems.
+	void civilFromDays(sqlite3_int64 inDays, int& year, unsigned& month, unsigned& day) {
+		inDays += 719468;
+		const sqlite3_int64 era{ (inDays >= 0 ? inDays : inDays - 146096) / 146097 };
+		const unsigned dayOfEra{ static_cast<unsigned>(inDays - era * 146097) };
+		const unsigned yearOfEra{ (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365 };
+		const unsigned dayOfYear{ dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100) };
+		const unsigned monthPart{ (5 * dayOfYear + 2) / 153 };
+		day = dayOfYear - (153 * monthPart + 2) / 5 + 1;
+		month = monthPart < 10 ? monthPart + 3 : monthPart - 9;
+		year = static_cast<int>(yearOfEra + era * 400) + (month <= 2 ? 1 : 0);
+	}
+
+	//CSV fields are quoted only when they need to be, with embedded quotes doubled. NULLs are written as empty fields.
+	void writeCsvField(std::ostream& out, const char* inValue) {
+		if (!inValue) return;
+		std::string_view value{ inValue };
+		if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+			out << value;
+			return;
+		}
+		out << '"';
+		for (char c : value) {
+			if (c == '"') out << '"';
+			out << c;
+		}
+		out << '"';
+	}
+
+	std::size_t writeChangedRows(sqlite3* db, const char* inStatement, sqlite3_int64 inSince, std::ostream& out) {
+		PreparedStatement changedRows{ db, inStatement };
+		sqlite3_bind_int64(changedRows.get(), 1, inSince);
+		const int columns{ sqlite3_column_count(changedRows.get()) };
+
+		//Header row first.
+		for (int i = 0; i < columns; ++i) {
+			if (i > 0) out << ',';
+			writeCsvField(out, sqlite3_column_name(changedRows.get(), i));
+		}
+		out << '\n';
+
+		std::size_t rows{ 0 };
+		while (changedRows.stepRow()) {
+			for (int i = 0; i < columns; ++i) {
+				if (i > 0) out << ',';
+				//Timestamps are written in ISO form, so the file makes sense to whoever opens it.
+				if (isTimestampColumn(sqlite3_column_name(changedRows.get(), i)) && sqlite3_column_type(changedRows.get(), i) == SQLITE_INTEGER) {
+					out << formatTimestamp(sqlite3_column_int64(changedRows.get(), i));
+				}
+				else writeCsvField(out, reinterpret_cast<const char*>(sqlite3_column_text(changedRows.get(), i)));
+			}
+			out << '\n';
+			++rows;
+		}
+		return rows;
+	}
+
+}
+
+
+std::string formatTimestamp(sqlite3_int64 inEpochSeconds) {
+	//Floor division, so that times before 1970 still land on the right day.
+	sqlite3_int64 days{ inEpochSeconds / 86400 };
+	sqlite3_int64 secondsOfDay{ inEpochSeconds % 86400 };
+	if (secondsOfDay < 0) {
+		secondsOfDay += 86400;
+		--days;
+	}
+
+	int year;
+	unsigned month, day;
+	civilFromDays(days, year, month, day);
+
+	char buffer[32];
+	std::snprintf(buffer, sizeof buffer, "%04d-%02u-%02u %02d:%02d:%02d", year, month, day,
+		static_cast<int>(secondsOfDay / 3600), static_cast<int>(secondsOfDay / 60 % 60), static_cast<int>(secondsOfDay % 60));
+	return buffer;
+}
+
+
+bool isTimestampColumn(std::string_view inColumnName) {
+	return inColumnName == "Created_On" || inColumnName == "Updated_On";
+}
+
+
+std::optional<sqlite3_int64> parseTimestamp(sqlite3* db, const std::string& inText) {
+	PreparedStatement parse{ db, "SELECT CAST(strftime('%s', ?) AS INTEGER);" };
+	sqlite3_bind_text(parse.get(), 1, inText.c_str(), -1, SQLITE_TRANSIENT);
+	if (!parse.stepRow() || sqlite3_column_type(parse.get(), 0) == SQLITE_NULL) return std::nullopt;
+	return sqlite3_column_int64(parse.get(), 0);
+}
+
+
+ChangeExportResult exportChangesSince(sqlite3* db, sqlite3_int64 inSince, std::ostream& customersOut, std::ostream& addressesOut) {
+	ChangeExportResult result;
+	//Both tables are read inside one transaction, so that the two files describe the same moment in time.
+	executeStatement("BEGIN TRANSACTION", db, false);
+	try {
+		result.customers = writeChangedRows(db, changedCustomersStatement, inSince, customersOut);
+		result.addresses = writeChangedRows(db, changedAddressesStatement, inSince, addressesOut);
+		executeStatement("COMMIT TRANSACTION", db, false);
+	}
+	catch (std::exception&) {
+		sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		throw;
+	}
+	return result;
+}
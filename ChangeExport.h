@@ -0,0 +1,38 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cstddef>
+#include <optional>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Created_On and Updated_On are stored as whole seconds since the Unix epoch (UTC), and Updated_On is indexed on both tables.
+//This makes "what has changed since T" a single range scan on each index, rather than a string comparison against every row.
+//New and updated rows are stamped with CAST(strftime('%s','now') AS INTEGER).
+
+
+//Formats a stored timestamp as "YYYY-MM-DD HH:MM:SS" (UTC) for display.
+std::string formatTimestamp(sqlite3_int64 inEpochSeconds);
+
+//Returns true for the names of the columns which hold timestamps, so that they can be shown as dates rather than raw numbers.
+bool isTimestampColumn(std::string_view inColumnName);
+
+//Converts a date or date and time typed by the user (e.g. "2024-03-01" or "2024-03-01 14:30") into a timestamp, using SQLite's own date parsing.
+//Returns nothing if the text isn't a date SQLite understands. Dates before 1970 are negative, so there's no number we could spare to mean that.
+std::optional<sqlite3_int64> parseTimestamp(sqlite3* db, const std::string& inText);
+
+
+//How many rows exportChangesSince() wrote for each table.
+struct ChangeExportResult {
+	std::size_t customers{ 0 };
+	std::size_t addresses{ 0 };
+};
+
+//Writes every customer and every address created or updated at or after inSince to the given streams as CSV, oldest change first.
+//Each table is read with a single range scan on its Updated_On index. Deleted rows leave nothing behind to export, so they aren't included.
+ChangeExportResult exportChangesSince(sqlite3* db, sqlite3_int64 inSince, std::ostream& customersOut, std::ostream& addressesOut);
@@ -0,0 +1,78 @@
+//Standard library includes
+#include <stdexcept>
+
+//Project includes
+#include "ConnectionPool.h"
+#include "ConnectionStatus.h"
+#include "SqlFunctions.h"
+
+
+ConnectionPool::~ConnectionPool() {
+	for (auto& connection : m_connections) {
+		connection->statements.clear();		//They must be finalised before the connection will close.
+		unregisterConnection(connection->db);
+		sqlite3_close(connection->db);
+	}
+}
+
+
+ConnectionPool::Lease ConnectionPool::acquire() {
+	{
+		std::lock_guard lock{ m_mutex };
+		if (!m_idle.empty()) {
+			PooledConnection* connection{ m_idle.back() };
+			m_idle.pop_back();
+			return Lease{ this, connection };
+		}
+	}
+
+	//Opening a connection reads the schema, so we do it without holding up other threads wanting a connection back.
+	auto connection{ std::make_unique<PooledConnection>() };
+	const int flags{ (m_settings.readOnly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE) | (m_settings.uri ? SQLITE_OPEN_URI : 0) };
+	if (sqlite3_open_v2(m_settings.path.c_str(), &connection->db, flags, NULL) != SQLITE_OK) {
+		std::string errorMessage{ "Error opening worker connection: " + std::string{ sqlite3_errmsg(connection->db) } };
+		sqlite3_close(connection->db);
+		throw std::runtime_error{ errorMessage };
+	}
+	try {
+		registerSqlFunctions(connection->db);
+	}
+	catch (std::exception&) {
+		sqlite3_close(connection->db);
+		throw;
+	}
+	connection->busyHandler = std::make_unique<BusyHandler>(m_settings.busy);
+	connection->busyHandler->install(connection->db);
+
+	std::lock_guard lock{ m_mutex };
+	registerConnection(connection->db, m_settings.name + ' ' + std::to_string(m_connections.size() + 1), connection->busyHandler.get());
+	m_connections.push_back(std::move(connection));
+	return Lease{ this, m_connections.back().get() };
+}
+
+
+std::size_t ConnectionPool::opened() const {
+	std::lock_guard lock{ m_mutex };
+	return m_connections.size();
+}
+
+
+void ConnectionPool::release(PooledConnection* inConnection) {
+	//A job which threw part way through a transaction mustn't leave the next job holding its lock. Nor must a cached statement left part way
+	//through its rows, as that holds a read transaction open.
+	for (auto& cached : inConnection->statements) {
+		if (cached.second) sqlite3_reset(cached.second->get());
+	}
+	if (!sqlite3_get_autocommit(inConnection->db)) sqlite3_exec(inConnection->db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+	std::lock_guard lock{ m_mutex };
+	m_idle.push_back(inConnection);
+}
+
+
+sqlite3_stmt* ConnectionPool::Lease::statement(const std::string& inStatement) {
+	auto& cached{ m_connection->statements[inStatement] };
+	if (!cached) cached = std::make_unique<PreparedStatement>(m_connection->db, inStatement);
+	sqlite3_reset(cached->get());
+	sqlite3_clear_bindings(cached->get());
+	return cached->get();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+//Standard library includes
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "BusyHandler.h"
+#include "PreparedStatement.h"
+
+
+//Connections to the database for worker threads, e.g. the HTTP server's. A connection can only be used by one thread at a time outside SQLite's
+//serialized mode, and even in it a shared connection would make the threads take turns, so each job leases a connection of its own for as
+//long as it runs and hands it back afterwards. Connections are opened as they're first needed, set up the same way as the main one (our SQL
+//functions, a busy handler and a name in the SQLite statistics report), and kept open for the next job until the pool is destroyed.
+class ConnectionPool {
+public:
+	struct Settings {
+		std::string path;						//A file name, or a file: URI when uri is set.
+		bool readOnly{ false };
+		bool uri{ false };
+		BusyHandler::Settings busy;
+		std::string name{ "Worker" };			//Connections are named "<name> 1", "<name> 2" and so on in the statistics report.
+	};
+
+	explicit ConnectionPool(Settings inSettings) : m_settings{ std::move(inSettings) } {}
+	~ConnectionPool();
+	ConnectionPool(const ConnectionPool&) = delete;
+	ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+	class Lease;
+
+	//Returns an idle connection, opening a new one if none is idle. Throws std::runtime_error if a new one can't be opened.
+	Lease acquire();
+
+	std::size_t opened() const;
+
+private:
+	struct PooledConnection {
+		sqlite3* db{ nullptr };
+		std::unique_ptr<BusyHandler> busyHandler;		//Held by pointer, as the connection keeps its address.
+		std::unordered_map<std::string, std::unique_ptr<PreparedStatement>> statements;		//See Lease::statement().
+	};
+
+	void release(PooledConnection* inConnection);
+
+	Settings m_settings;
+	mutable std::mutex m_mutex;
+	std::vector<std::unique_ptr<PooledConnection>> m_connections;
+	std::vector<PooledConnection*> m_idle;
+};
+
+
+//A connection borrowed from the pool, given back when the lease is destroyed. Any transaction left open is rolled back first.
+class ConnectionPool::Lease {
+public:
+	Lease(Lease&& other) noexcept : m_pool{ other.m_pool }, m_connection{ other.m_connection } { other.m_connection = nullptr; }
+	Lease& operator=(Lease&&) = delete;
+	Lease(const Lease&) = delete;
+	Lease& operator=(const Lease&) = delete;
+	~Lease() { if (m_connection) m_pool->release(m_connection); }
+
+	sqlite3* get() const { return m_connection->db; }
+
+	//A statement prepared on this connection, reset and with its bindings cleared, ready to use. Each one is prepared the first time it's asked
+	//for and kept with the connection for the next job, which saves re-preparing it for every request when each only does a few lookups.
+	//Throws std::runtime_error if it won't prepare.
+	sqlite3_stmt* statement(const std::string& inStatement);
+
+private:
+	friend class ConnectionPool;
+	Lease(ConnectionPool* inPool, PooledConnection* inConnection) : m_pool{ inPool }, m_connection{ inConnection } {}
+
+	ConnectionPool* m_pool;
+	PooledConnection* m_connection;
+};
@@ -0,0 +1,218 @@
+//Standard library includes
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+//Project includes
+#include "ConnectionStatus.h"
+#include "ChangeExport.h"
+#include "WriteScheduler.h"
+
+namespace {
+
+	//The registered connections. Reading a connection's status while another thread closes it would be a use after free, so the registry
+	//lock is held for the whole of each report, and unregisterConnection() waits for any report in progress to finish.
+	std::mutex registryMutex;
+
+	struct RegisteredConnection {
+		sqlite3* db;
+		std::string name;
+		std::thread::id owner;
+		const BusyHandler* busyHandler;
+	};
+	std::vector<RegisteredConnection> connections;
+
+	//Outside serialized mode SQLite doesn't lock a connection for us, so we can only safely read one from the thread which uses it.
+	//sqlite3_db_mutex() gives null in exactly those modes.
+	bool readableHere(const RegisteredConnection& inConnection) {
+		return sqlite3_db_mutex(inConnection.db) || inConnection.owner == std::this_thread::get_id();
+	}
+
+	struct StatusCounter {
+		const char* name;
+		int op;
+	};
+
+	constexpr StatusCounter processCounters[]{
+		{ "memory_used", SQLITE_STATUS_MEMORY_USED },
+		{ "malloc_count", SQLITE_STATUS_MALLOC_COUNT },
+		{ "malloc_size", SQLITE_STATUS_MALLOC_SIZE },
+		{ "pagecache_used", SQLITE_STATUS_PAGECACHE_USED },
+		{ "pagecache_overflow", SQLITE_STATUS_PAGECACHE_OVERFLOW },
+		{ "pagecache_size", SQLITE_STATUS_PAGECACHE_SIZE }
+	};
+
+	constexpr StatusCounter connectionCounters[]{
+		{ "cache_used", SQLITE_DBSTATUS_CACHE_USED },
+		{ "cache_hit", SQLITE_DBSTATUS_CACHE_HIT },
+		{ "cache_miss", SQLITE_DBSTATUS_CACHE_MISS },
+		{ "cache_write", SQLITE_DBSTATUS_CACHE_WRITE },
+		{ "cache_spill", SQLITE_DBSTATUS_CACHE_SPILL },
+		{ "lookaside_used", SQLITE_DBSTATUS_LOOKASIDE_USED },
+		{ "lookaside_hit", SQLITE_DBSTATUS_LOOKASIDE_HIT },
+		{ "lookaside_miss_size", SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE },
+		{ "lookaside_miss_full", SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL },
+		{ "schema_used", SQLITE_DBSTATUS_SCHEMA_USED },
+		{ "stmt_used", SQLITE_DBSTATUS_STMT_USED }
+	};
+
+	struct CounterValue {
+		sqlite3_int64 current{ 0 };
+		sqlite3_int64 highwater{ 0 };
+	};
+
+	CounterValue processStatus(int op) {
+		CounterValue value;
+		sqlite3_status64(op, &value.current, &value.highwater, 0);
+		return value;
+	}
+
+	CounterValue connectionStatus(sqlite3* db, int op) {
+		int current{ 0 }, highwater{ 0 };
+		sqlite3_db_status(db, op, &current, &highwater, 0);
+		return { current, highwater };
+	}
+
+	std::string kilobytes(sqlite3_int64 bytes) {
+		return std::to_string(bytes / 1024) + " KB";
+	}
+
+	std::string milliseconds(std::chrono::microseconds inTime) {
+		return std::to_string(inTime.count() / 1000) + '.' + std::to_string(inTime.count() / 100 % 10) + " ms";
+	}
+
+	constexpr std::pair<WritePriority, const char*> writeClasses[]{ { WritePriority::Interactive, "interactive" }, { WritePriority::Batch, "batch" } };
+
+}
+
+
+void registerConnection(sqlite3* db, std::string inName, const BusyHandler* inBusyHandler) {
+	std::lock_guard lock{ registryMutex };
+	connections.push_back({ db, std::move(inName), std::this_thread::get_id(), inBusyHandler });
+}
+
+
+void unregisterConnection(sqlite3* db) {
+	std::lock_guard lock{ registryMutex };
+	connections.erase(std::remove_if(connections.begin(), connections.end(), [db](const auto& connection) { return connection.db == db; }), connections.end());
+}
+
+
+void printSqliteStatus(std::ostream& out) {
+	out << "SQLite " << sqlite3_libversion() << ", whole process:\n"
+		"  Memory in use: " << kilobytes(processStatus(SQLITE_STATUS_MEMORY_USED).current) << " (peak " << kilobytes(processStatus(SQLITE_STATUS_MEMORY_USED).highwater) << ")\n"
+		"  Allocations outstanding: " << processStatus(SQLITE_STATUS_MALLOC_COUNT).current << " (peak " << processStatus(SQLITE_STATUS_MALLOC_COUNT).highwater << ")\n"
+		"  Largest allocation: " << processStatus(SQLITE_STATUS_MALLOC_SIZE).highwater << " bytes\n"
+		"  Preallocated page cache: " << processStatus(SQLITE_STATUS_PAGECACHE_USED).current << " pages in use, "
+		<< kilobytes(processStatus(SQLITE_STATUS_PAGECACHE_OVERFLOW).current) << " overflowed to the heap\n";
+
+	std::lock_guard lock{ registryMutex };
+	for (const auto& connection : connections) {
+		if (!readableHere(connection)) {
+			out << "\nConnection \"" << connection.name << "\" belongs to another thread, and can't be read from here unless SQLite is in serialized mode.\n";
+			continue;
+		}
+		sqlite3* db{ connection.db };
+		const sqlite3_int64 hits{ connectionStatus(db, SQLITE_DBSTATUS_CACHE_HIT).current };
+		const sqlite3_int64 misses{ connectionStatus(db, SQLITE_DBSTATUS_CACHE_MISS).current };
+		out << "\nConnection \"" << connection.name << "\":\n"
+			"  Page cache: " << kilobytes(connectionStatus(db, SQLITE_DBSTATUS_CACHE_USED).current) << ", " << hits << " hits, " << misses << " misses";
+		if (hits + misses > 0) out << " (" << 100 * hits / (hits + misses) << "% hit rate)";
+		out << "\n  Pages written: " << connectionStatus(db, SQLITE_DBSTATUS_CACHE_WRITE).current
+			<< ", spilled mid-transaction: " << connectionStatus(db, SQLITE_DBSTATUS_CACHE_SPILL).current << '\n'
+			<< "  Lookaside: " << connectionStatus(db, SQLITE_DBSTATUS_LOOKASIDE_USED).current << " slots in use (peak " << connectionStatus(db, SQLITE_DBSTATUS_LOOKASIDE_USED).highwater
+			<< "), " << connectionStatus(db, SQLITE_DBSTATUS_LOOKASIDE_HIT).highwater << " hits, " << connectionStatus(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE).highwater
+			<< " too big, " << connectionStatus(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL).highwater << " when full\n"
+			<< "  Schema: " << kilobytes(connectionStatus(db, SQLITE_DBSTATUS_SCHEMA_USED).current)
+			<< ", prepared statements: " << kilobytes(connectionStatus(db, SQLITE_DBSTATUS_STMT_USED).current) << '\n';
+		if (connection.busyHandler) {
+			const BusyHandler::Stats locks{ connection.busyHandler->stats() };
+			out << "  Lock waits: " << locks.waits << " (" << locks.retries << " retries, " << locks.timeouts << " gave up), "
+				<< locks.totalWait.count() / 1000 << " ms in all, longest " << locks.maxWait.count() / 1000 << " ms\n";
+		}
+	}
+	if (connections.empty()) out << "\nNo connections are open.\n";
+
+	//The time each class of write spent queueing for the write lock. See WriteScheduler.h.
+	out << "\nWrite queueing:\n";
+	for (const auto& [priority, name] : writeClasses) {
+		const WriteQueueStats queueing{ writeQueueStats(priority) };
+		out << "  " << name << ": " << queueing.writes << " writes";
+		if (queueing.writes > 0) {
+			out << ", waiting " << milliseconds(queueing.medianDelay) << " at the median, " << milliseconds(queueing.p99Delay) << " at the 99th percentile, "
+				<< milliseconds(queueing.maxDelay) << " at most";
+		}
+		out << '\n';
+	}
+}
+
+
+void writeSqliteStatusLog(std::ostream& out) {
+	const std::string timestamp{ formatTimestamp(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())) };
+
+	out << timestamp << " process";
+	for (const auto& counter : processCounters) {
+		const CounterValue value{ processStatus(counter.op) };
+		out << ' ' << counter.name << '=' << value.current << ' ' << counter.name << "_peak=" << value.highwater;
+	}
+	out << '\n';
+
+	std::lock_guard lock{ registryMutex };
+	for (const auto& connection : connections) {
+		if (!readableHere(connection)) continue;
+		sqlite3* db{ connection.db };
+		out << timestamp << " connection=\"" << connection.name << '"';
+		//The lookaside hit and miss counters only have a high-water value. For everything else, the current value is the one that matters.
+		for (const auto& counter : connectionCounters) {
+			const CounterValue value{ connectionStatus(db, counter.op) };
+			const bool highwaterOnly{ counter.op == SQLITE_DBSTATUS_LOOKASIDE_HIT || counter.op == SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE || counter.op == SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL };
+			out << ' ' << counter.name << '=' << (highwaterOnly ? value.highwater : value.current);
+		}
+		if (connection.busyHandler) {
+			const BusyHandler::Stats locks{ connection.busyHandler->stats() };
+			out << " lock_waits=" << locks.waits << " lock_retries=" << locks.retries << " lock_timeouts=" << locks.timeouts
+				<< " lock_wait_us=" << locks.totalWait.count() << " lock_wait_max_us=" << locks.maxWait.count();
+		}
+		out << '\n';
+	}
+
+	for (const auto& [priority, name] : writeClasses) {
+		const WriteQueueStats queueing{ writeQueueStats(priority) };
+		out << timestamp << " writes=" << name << " count=" << queueing.writes << " queue_us=" << queueing.totalDelay.count() << " queue_max_us=" << queueing.maxDelay.count()
+			<< " queue_p50_us=" << queueing.medianDelay.count() << " queue_p99_us=" << queueing.p99Delay.count() << '\n';
+	}
+	out.flush();
+}
+
+
+void StatusLogger::start(const std::string& inPath, std::chrono::seconds inInterval) {
+	stop();
+	m_log.open(inPath, std::ios::app);
+	if (!m_log) throw std::runtime_error{ "Could not open " + inPath + " for writing" };
+	m_path = inPath;
+	m_interval = inInterval;
+	m_stopping = false;
+	m_thread = std::thread{ &StatusLogger::run, this };
+}
+
+
+void StatusLogger::stop() {
+	if (!m_thread.joinable()) return;
+	{
+		std::lock_guard lock{ m_mutex };
+		m_stopping = true;
+	}
+	m_wakeUp.notify_all();
+	m_thread.join();
+	m_log.close();
+}
+
+
+void StatusLogger::run() {
+	std::unique_lock lock{ m_mutex };
+	do {
+		writeSqliteStatusLog(m_log);
+	} while (!m_wakeUp.wait_for(lock, m_interval, [&] { return m_stopping; }));
+	writeSqliteStatusLog(m_log);		//And a last entry on the way out, so the log covers the whole period.
+}
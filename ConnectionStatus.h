@@ -0,0 +1,60 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "BusyHandler.h"
+
+
+//Reporting on SQLite's memory use and page cache behaviour, from sqlite3_status64() for the process as a whole and sqlite3_db_status() for
+//each connection. The program opens more than one connection (the main one, background maintenance, bulk load staging), so each registers
+//itself here under a name when it's opened, and unregisters before it's closed. A connection should be registered from the thread which uses it,
+//as outside SQLite's serialized threading mode it can only be reported on from that thread.
+
+//If the connection has a BusyHandler, passing it here adds its lock waits to the report. It must stay alive until the connection is unregistered.
+void registerConnection(sqlite3* db, std::string inName, const BusyHandler* inBusyHandler = nullptr);
+void unregisterConnection(sqlite3* db);
+
+//Prints the process-wide counters, then each registered connection's, in a readable form.
+void printSqliteStatus(std::ostream& out);
+
+//Writes the same counters as one line per connection of name=value pairs, headed by a timestamp, for the periodic status log.
+void writeSqliteStatusLog(std::ostream& out);
+
+
+//Appends the status counters to a log file at a fixed interval, from a thread of its own, until stopped. Counters are cumulative, so the
+//change over any period can be worked out by subtracting two entries.
+class StatusLogger {
+public:
+	StatusLogger() = default;
+	~StatusLogger() { stop(); }
+	StatusLogger(const StatusLogger&) = delete;
+	StatusLogger& operator=(const StatusLogger&) = delete;
+
+	//Throws std::runtime_error if the log file can't be opened. Restarts the logger if it's already running.
+	void start(const std::string& inPath, std::chrono::seconds inInterval);
+	void stop();
+	bool running() const { return m_thread.joinable(); }
+	const std::string& path() const { return m_path; }
+
+private:
+	void run();
+
+	std::string m_path;
+	std::ofstream m_log;
+	std::chrono::seconds m_interval{ 60 };
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	bool m_stopping{ false };
+};
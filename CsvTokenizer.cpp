@@ -0,0 +1,203 @@
+//Standard library includes
+#include <stdexcept>
+#include <algorithm>
+
+//Platform includes
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_TOKENIZER_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Project includes
+#include "CsvTokenizer.h"
+
+namespace {
+
+	constexpr std::size_t blockSize{ 64 };
+
+	//Index of the lowest set bit. The mask must not be zero.
+	unsigned lowestSetBit(std::uint64_t inMask) {
+#if defined(_MSC_VER) && defined(_WIN64)
+		unsigned long index;
+		_BitScanForward64(&index, inMask);
+		return index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, static_cast<unsigned long>(inMask))) return index;
+		_BitScanForward(&index, static_cast<unsigned long>(inMask >> 32));
+		return index + 32;
+#else
+		return static_cast<unsigned>(__builtin_ctzll(inMask));
+#endif
+	}
+
+	bool isSpecial(char c, char inDelimiter) {
+		return c == inDelimiter || c == '"' || c == '\n' || c == '\r';
+	}
+
+	//Builds the special character mask for the block at inBlock, byte by byte. Used for the last partial block, and where SSE2 isn't available.
+	std::uint64_t specialMaskScalar(const char* inBlock, std::size_t inLength, char inDelimiter) {
+		std::uint64_t mask{ 0 };
+		for (std::size_t i = 0; i < inLength; ++i) {
+			if (isSpecial(inBlock[i], inDelimiter)) mask |= std::uint64_t{ 1 } << i;
+		}
+		return mask;
+	}
+
+#ifdef CSV_TOKENIZER_SSE2
+	//Compares 16 bytes at a time against each special character, and packs the results into one bit per byte.
+	std::uint64_t specialMaskSimd(const char* inBlock, char inDelimiter) {
+		const __m128i delimiter{ _mm_set1_epi8(inDelimiter) };
+		const __m128i quote{ _mm_set1_epi8('"') };
+		const __m128i lineFeed{ _mm_set1_epi8('\n') };
+		const __m128i carriageReturn{ _mm_set1_epi8('\r') };
+
+		std::uint64_t mask{ 0 };
+		for (std::size_t i = 0; i < blockSize; i += 16) {
+			const __m128i bytes{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(inBlock + i)) };
+			const __m128i matches{ _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, delimiter), _mm_cmpeq_epi8(bytes, quote)),
+				_mm_or_si128(_mm_cmpeq_epi8(bytes, lineFeed), _mm_cmpeq_epi8(bytes, carriageReturn))) };
+			mask |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm_movemask_epi8(matches))) << i;
+		}
+		return mask;
+	}
+#endif
+
+}
+
+
+CsvTokenizer::CsvTokenizer(std::string_view inData, char inDelimiter) : m_data{ inData }, m_delimiter{ inDelimiter } {
+	if (inDelimiter == '"' || inDelimiter == '\n' || inDelimiter == '\r' || inDelimiter == ' ') throw std::invalid_argument{ "Invalid CSV delimiter" };
+}
+
+
+//Returns the position of the first delimiter, quote or line break at or after inFrom, or the size of the input if there isn't one.
+std::size_t CsvTokenizer::nextSpecial(std::size_t inFrom) {
+	while (inFrom < m_data.size()) {
+		//Build the mask for the block starting here if inFrom isn't in the block we already have. We never read past the end of the input,
+		//which matters as it's usually a memory mapped file, and the page after it may not exist.
+		if (!m_blockValid || inFrom < m_blockStart || inFrom >= m_blockStart + blockSize) {
+			m_blockStart = inFrom;
+			const std::size_t remaining{ m_data.size() - inFrom };
+#ifdef CSV_TOKENIZER_SSE2
+			if (remaining >= blockSize) m_blockMask = specialMaskSimd(m_data.data() + inFrom, m_delimiter);
+			else
+#endif
+			m_blockMask = specialMaskScalar(m_data.data() + inFrom, remaining < blockSize ? remaining : blockSize, m_delimiter);
+			m_blockValid = true;
+		}
+
+		const std::uint64_t mask{ m_blockMask >> (inFrom - m_blockStart) };
+		if (mask) return inFrom + lowestSetBit(mask);
+		inFrom = m_blockStart + blockSize;
+	}
+	return m_data.size();
+}
+
+
+bool CsvTokenizer::nextRecord(std::vector<std::string_view>& outFields) {
+	outFields.clear();
+	m_unescaped.clear();
+
+	//Skip any blank lines.
+	while (m_position < m_data.size() && (m_data[m_position] == '\n' || m_data[m_position] == '\r')) {
+		if (m_data[m_position] == '\n' || m_position + 1 == m_data.size() || m_data[m_position + 1] != '\n') ++m_line;
+		++m_position;
+	}
+	if (m_position >= m_data.size()) return false;
+	m_recordLine = m_line;
+
+	while (true) {
+		while (m_position < m_data.size() && isBlank(m_data[m_position])) ++m_position;
+		outFields.push_back(m_position < m_data.size() && m_data[m_position] == '"' ? readQuotedField() : readUnquotedField());
+
+		//We're now at the end of the field, which is either a delimiter, the end of the line, or the end of the input.
+		if (m_position >= m_data.size()) return true;
+		const char terminator{ m_data[m_position++] };
+		if (terminator == m_delimiter) continue;
+		if (terminator == '\r' && m_position < m_data.size() && m_data[m_position] == '\n') ++m_position;
+		++m_line;
+		return true;
+	}
+}
+
+
+std::string_view CsvTokenizer::readUnquotedField() {
+	const std::size_t start{ m_position };
+	//A quote in the middle of an unquoted field is just part of the text.
+	std::size_t end{ nextSpecial(start) };
+	while (end < m_data.size() && m_data[end] == '"') end = nextSpecial(end + 1);
+	m_position = end;
+
+	while (end > start && isBlank(m_data[end - 1])) --end;
+	return m_data.substr(start, end - start);
+}
+
+
+std::string_view CsvTokenizer::readQuotedField() {
+	const std::size_t start{ ++m_position };		//Step past the opening quote.
+	bool hasDoubledQuotes{ false };
+	std::size_t end;
+
+	while (true) {
+		end = nextSpecial(m_position);
+		if (end >= m_data.size()) throw std::runtime_error{ "Unterminated quoted field starting on line " + std::to_string(m_recordLine) };
+		m_position = end + 1;
+		if (m_data[end] == '\n') ++m_line;						//Line breaks inside quotes are part of the field, but still count as lines.
+		else if (m_data[end] == '"') {
+			if (m_position < m_data.size() && m_data[m_position] == '"') {
+				hasDoubledQuotes = true;
+				++m_position;
+			}
+			else break;
+		}
+	}
+
+	//Only blanks are allowed between the closing quote and the end of the field.
+	while (m_position < m_data.size() && isBlank(m_data[m_position])) ++m_position;
+	if (m_position < m_data.size() && (m_data[m_position] == '"' || !isSpecial(m_data[m_position], m_delimiter))) {
+		throw std::runtime_error{ "Unexpected text after a closing quote on line " + std::to_string(m_line) };
+	}
+
+	std::string_view field{ m_data.substr(start, end - start) };
+	if (!hasDoubledQuotes) return field;
+
+	std::string& unescaped{ m_unescaped.emplace_back() };
+	unescaped.reserve(field.size());
+	for (std::size_t i = 0; i < field.size(); ++i) {
+		unescaped += field[i];
+		if (field[i] == '"') ++i;		//Skip the second quote of each pair.
+	}
+	return unescaped;
+}
+
+
+std::vector<std::string_view> splitCsvChunks(std::string_view inData, std::size_t inChunkSize) {
+	std::vector<std::string_view> chunks;
+	std::size_t chunkStart{ 0 };
+	std::size_t position{ 0 };
+	bool insideQuotes{ false };		//Whether an odd number of quotes have been seen so far.
+
+	while (position < inData.size()) {
+		//Count the quotes up to where we'd like the chunk to end. std::count on chars compiles to a vectorised loop, so this pass is cheap.
+		const std::size_t target{ std::min(inData.size(), chunkStart + std::max<std::size_t>(inChunkSize, 1)) };
+		if (position < target) {
+			insideQuotes ^= (std::count(inData.begin() + position, inData.begin() + target, '"') & 1) != 0;
+			position = target;
+		}
+
+		//Then carry on to the first line break that isn't inside quotes.
+		while (position < inData.size() && (insideQuotes || inData[position] != '\n')) {
+			if (inData[position] == '"') insideQuotes = !insideQuotes;
+			++position;
+		}
+		if (position < inData.size()) ++position;		//The line break belongs to the chunk it ends.
+
+		chunks.push_back(inData.substr(chunkStart, position - chunkStart));
+		chunkStart = position;
+	}
+	return chunks;
+}
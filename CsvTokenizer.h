@@ -0,0 +1,65 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <cstddef>
+#include <cstdint>
+
+
+//Splits CSV (or TSV) text into records and fields for bulk imports, without copying or allocating per field.
+//
+//Fields are returned as string_views into the input, with surrounding spaces (and tabs, for CSV) trimmed. Fields may be wrapped in double
+//quotes, in which case they can contain delimiters and newlines, and a quote is written as two quotes. Quoted fields are returned without their
+//quotes, and are not trimmed inside them. Only quoted fields containing doubled quotes need copying, and those are rare enough not to matter.
+//
+//To find the end of each field quickly, the tokenizer builds a bitmask of every delimiter, quote and line break in each 64 byte block of the
+//input using SSE2 where it's available (all x64 builds), and then just reads the positions out of the mask. Short fields - which most of ours
+//are - then cost a couple of instructions each rather than a loop over their characters.
+//
+//Blank lines are skipped. Records end with \n, \r\n or \r. Malformed quoting is reported by throwing std::runtime_error with the line number.
+class CsvTokenizer {
+public:
+	explicit CsvTokenizer(std::string_view inData, char inDelimiter = ',');
+
+	//Reads the next record into outFields, returning false at the end of the input. The views are valid until the next call,
+	//and for as long as the input data they point into.
+	bool nextRecord(std::vector<std::string_view>& outFields);
+
+	//The line on which the last record read began, counting from 1. For error messages.
+	std::size_t recordLine() const { return m_recordLine; }
+
+	//The line the tokenizer has reached, counting from 1. Once the input is exhausted, this is one more than the number of line breaks in it.
+	std::size_t line() const { return m_line; }
+
+	//How far through the input we are, in bytes.
+	std::size_t position() const { return m_position; }
+
+private:
+	std::size_t nextSpecial(std::size_t inFrom);
+	std::string_view readQuotedField();
+	std::string_view readUnquotedField();
+	bool isBlank(char c) const { return c == ' ' || (c == '\t' && m_delimiter != '\t'); }
+
+	std::string_view m_data;
+	char m_delimiter;
+	std::size_t m_position{ 0 };
+	std::size_t m_line{ 1 };
+	std::size_t m_recordLine{ 0 };
+
+	//The bitmask of special characters in the 64 bytes starting at m_blockStart. Bit n is set if m_data[m_blockStart + n] is special.
+	std::size_t m_blockStart{ 0 };
+	std::uint64_t m_blockMask{ 0 };
+	bool m_blockValid{ false };
+
+	//Unescaped copies of quoted fields which contained doubled quotes, for the current record. A deque so that adding one doesn't move the others.
+	std::deque<std::string> m_unescaped;
+};
+
+
+//Splits CSV text into chunks of roughly inChunkSize bytes, each ending at the end of a record, so that the chunks can be tokenized in parallel.
+//A line break only ends a record if it comes after an even number of quotes, so quoted fields containing line breaks are never split.
+//Returns the chunks in order. Together they cover the whole of inData.
+std::vector<std::string_view> splitCsvChunks(std::string_view inData, std::size_t inChunkSize);
@@ -0,0 +1,621 @@
+//Standard library includes
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "CustomerApi.h"
+#include "CustomerTracker.h"
+#include "Deduplication.h"
+#include "Json.h"
+#include "NameSearch.h"
+#include "Postcodes.h"
+#include "PreparedStatement.h"
+#include "Reports.h"
+
+namespace {
+
+	//Thrown by the routes below for anything which is the client's mistake, carrying the status to answer with.
+	class ApiError : public std::runtime_error {
+	public:
+		ApiError(int inStatus, const std::string& inMessage) : std::runtime_error{ inMessage }, m_status{ inStatus } {}
+		int status() const { return m_status; }
+	private:
+		int m_status;
+	};
+
+	//The most rows we'll put in one reply. Anything wanting more must page through them.
+	constexpr std::size_t maxListLimit{ 10000 };
+	constexpr std::size_t defaultListLimit{ 100 };
+	constexpr std::size_t expensiveListLimit{ 1000 };		//Listings longer than this are classed as Expensive.
+	constexpr std::size_t maxSqlRows{ 10000 };
+	constexpr std::size_t defaultSearchResults{ 20 };
+
+	//The columns a client may set, and whether each must be a number. Everything else (IDs, timestamps and the columns kept up to date by
+	//triggers) is ours to look after.
+	struct WritableField {
+		const char* name;
+		bool numeric;
+	};
+	constexpr std::array<WritableField, 5> customerFields{ {
+		{ "First_Name", false }, { "Last_Name", false }, { "Group_Name", false }, { "Credit_Limit", true }, { "Outstanding_Credit", true }
+	} };
+	constexpr std::array<WritableField, 7> addressFields{ {
+		{ "Address_Type", false }, { "Contact_Name", false }, { "Address_Line_1", false }, { "Address_Line_2", false },
+		{ "Address_Line_3", false }, { "Address_Line_4", false }, { "Address_Line_5", false }
+	} };
+
+	const char* currentTime{ "CAST(strftime('%s','now') AS INTEGER)" };
+
+
+	std::vector<std::string_view> pathSegments(std::string_view inPath) {
+		std::vector<std::string_view> segments;
+		while (!inPath.empty()) {
+			if (inPath.front() == '/') {
+				inPath.remove_prefix(1);
+				continue;
+			}
+			const std::size_t slash{ std::min(inPath.find('/'), inPath.size()) };
+			segments.push_back(inPath.substr(0, slash));
+			inPath.remove_prefix(slash);
+		}
+		return segments;
+	}
+
+	//A whole number from the query string, or inDefault if it isn't there.
+	std::size_t queryNumber(const HttpRequest& inRequest, const std::string& inName, std::size_t inDefault, std::size_t inMaximum) {
+		auto parameter{ inRequest.query.find(inName) };
+		if (parameter == inRequest.query.end()) return inDefault;
+		const std::string& text{ parameter->second };
+		if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) throw ApiError{ 400, "Bad value for " + inName + ": " + text };
+		const std::size_t value{ std::stoul(text) };
+		if (value == 0 || value > inMaximum) throw ApiError{ 400, inName + " should be between 1 and " + std::to_string(inMaximum) };
+		return value;
+	}
+
+	int parseID(std::string_view inText) {
+		if (inText.empty() || inText.size() > 9 || inText.find_first_not_of("0123456789") != std::string_view::npos) throw ApiError{ 404, "No such address: " + std::string{ inText } };
+		return std::stoi(std::string{ inText });
+	}
+
+	HttpResponse jsonResponse(int inStatus, JsonWriter& writer) {
+		return { inStatus, writer.take() };
+	}
+
+	HttpResponse errorResponse(int inStatus, const std::string& inMessage) {
+		JsonWriter writer;
+		writer.beginObject().key("error").value(inMessage).endObject();
+		return jsonResponse(inStatus, writer);
+	}
+
+	std::map<std::string, JsonValue> parseBody(const HttpRequest& inRequest) {
+		if (inRequest.body.empty()) throw ApiError{ 400, "This request needs a JSON object in its body" };
+		return parseFlatJsonObject(inRequest.body);
+	}
+
+	void requireWritable(const CustomerApiContext& inContext) {
+		if (inContext.readOnly) throw ApiError{ 403, "The database has been opened read-only, so it can't be changed" };
+	}
+
+	//Checks every field in the body is one the client may set, with a value of the right type.
+	void checkFields(const std::map<std::string, JsonValue>& inFields, const WritableField* inAllowed, std::size_t inAllowedCount, std::string_view inAlsoAllowed = {}) {
+		for (const auto& [name, value] : inFields) {
+			if (name == inAlsoAllowed) continue;
+			const WritableField* field{ std::find_if(inAllowed, inAllowed + inAllowedCount, [&](const WritableField& f) { return name == f.name; }) };
+			if (field == inAllowed + inAllowedCount) throw ApiError{ 400, "Unknown field, or one which can't be set: " + name };
+			if (value.type == JsonValue::Type::Boolean) throw ApiError{ 400, "Bad value for " + name };
+			if (field->numeric && value.type == JsonValue::Type::String) throw ApiError{ 400, name + " should be a number" };
+			if (!field->numeric && value.type == JsonValue::Type::Number) throw ApiError{ 400, name + " should be a string" };
+		}
+	}
+
+	void bindValue(sqlite3* db, sqlite3_stmt* inStatement, int inIndex, const JsonValue& inValue) {
+		int bindStatus;
+		if (inValue.type == JsonValue::Type::Null) bindStatus = sqlite3_bind_null(inStatement, inIndex);
+		else if (inValue.type == JsonValue::Type::String) bindStatus = sqlite3_bind_text(inStatement, inIndex, inValue.text.c_str(), -1, SQLITE_TRANSIENT);
+		else if (inValue.isInteger()) bindStatus = sqlite3_bind_int64(inStatement, inIndex, static_cast<sqlite3_int64>(inValue.number));
+		else bindStatus = sqlite3_bind_double(inStatement, inIndex, inValue.number);
+		if (bindStatus != SQLITE_OK) throw std::runtime_error{ "Error binding value: " + std::string{ sqlite3_errmsg(db) } };
+	}
+
+	void bindText(sqlite3* db, sqlite3_stmt* inStatement, int inIndex, const std::string& inText) {
+		if (sqlite3_bind_text(inStatement, inIndex, inText.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK) throw std::runtime_error{ "Error binding value: " + std::string{ sqlite3_errmsg(db) } };
+	}
+
+	void bindInt(sqlite3* db, sqlite3_stmt* inStatement, int inIndex, sqlite3_int64 inValue) {
+		if (sqlite3_bind_int64(inStatement, inIndex, inValue) != SQLITE_OK) throw std::runtime_error{ "Error binding value: " + std::string{ sqlite3_errmsg(db) } };
+	}
+
+	//Finds a customer by short name, ignoring case as the menus do. Throws a 404 if there's no such customer.
+	sqlite3_int64 findCustomerID(sqlite3* db, const std::string& inShortName) {
+		PreparedStatement selectID{ db, "SELECT Customer_ID FROM Customers WHERE Customer_Short_Name = ? COLLATE NOCASE;" };
+		bindText(db, selectID.get(), 1, inShortName);
+		if (!selectID.stepRow()) throw ApiError{ 404, "No such customer: " + inShortName };
+		return sqlite3_column_int64(selectID.get(), 0);
+	}
+
+	//Writes the current row of the statement as an object keyed on column names.
+	void writeRow(JsonWriter& writer, sqlite3_stmt* inStatement) {
+		writer.beginObject();
+		for (int i = 0; i < sqlite3_column_count(inStatement); ++i) writer.key(sqlite3_column_name(inStatement, i)).column(inStatement, i);
+		writer.endObject();
+	}
+
+	//A customer, with their addresses in an "Addresses" array.
+	void writeCustomer(JsonWriter& writer, sqlite3* db, sqlite3_int64 inCustomerID) {
+		PreparedStatement selectCustomer{ db, "SELECT * FROM Customers WHERE Customer_ID = ?;" };
+		bindInt(db, selectCustomer.get(), 1, inCustomerID);
+		if (!selectCustomer.stepRow()) throw ApiError{ 404, "No such customer" };
+		writer.beginObject();
+		for (int i = 0; i < sqlite3_column_count(selectCustomer.get()); ++i) writer.key(sqlite3_column_name(selectCustomer.get(), i)).column(selectCustomer.get(), i);
+
+		PreparedStatement selectAddresses{ db, "SELECT * FROM CustomerAddress WHERE Customer_ID = ?;" };
+		bindInt(db, selectAddresses.get(), 1, inCustomerID);
+		writer.key("Addresses");
+		writeRowsAsJson(writer, selectAddresses.get());
+		writer.endObject();
+	}
+
+	void writeAddress(JsonWriter& writer, sqlite3* db, sqlite3_int64 inAddressID) {
+		PreparedStatement selectAddress{ db, "SELECT * FROM CustomerAddress WHERE Address_ID = ?;" };
+		bindInt(db, selectAddress.get(), 1, inAddressID);
+		if (!selectAddress.stepRow()) throw ApiError{ 404, "No such address: " + std::to_string(inAddressID) };
+		writeRow(writer, selectAddress.get());
+	}
+
+	//Runs inStatement inside a write transaction, queued by priority as the menus' writes are, and commits it. Returns the number of rows changed.
+	int runWrite(const CustomerApiContext& inContext, sqlite3* db, PreparedStatement& statement) {
+		beginWrite(db, inContext.writePriority);
+		if (sqlite3_step(statement.get()) != SQLITE_DONE) throw std::runtime_error{ "Error executing statement: " + std::string{ sqlite3_errmsg(db) } };
+		const int changes{ sqlite3_changes(db) };
+		executeStatement("COMMIT TRANSACTION", db, false);
+		return changes;
+	}
+
+	//Builds "UPDATE <table> SET A = ?, B = ?, Updated_On = <now> WHERE <key> = ?" for the fields given, and binds them.
+	//Returns the number of rows changed.
+	int updateRow(const CustomerApiContext& inContext, sqlite3* db, const char* inTable, const char* inKeyColumn, sqlite3_int64 inKey, const std::map<std::string, JsonValue>& inFields) {
+		std::string updateStatement{ "UPDATE " + std::string{ inTable } + " SET " };
+		for (const auto& field : inFields) updateStatement += field.first + " = ?, ";
+		updateStatement += "Updated_On = " + std::string{ currentTime } + " WHERE " + inKeyColumn + " = ?;";
+
+		PreparedStatement update{ db, updateStatement };
+		int index{ 1 };
+		for (const auto& field : inFields) bindValue(db, update.get(), index++, field.second);
+		bindInt(db, update.get(), index, inKey);
+		return runWrite(inContext, db, update);
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//										Customers															//
+	//----------------------------------------------------------------------------------------------------------//
+
+	HttpResponse getCustomer(sqlite3* db, const std::string& inShortName) {
+		JsonWriter writer;
+		writeCustomer(writer, db, findCustomerID(db, inShortName));
+		return jsonResponse(200, writer);
+	}
+
+	HttpResponse addCustomer(const CustomerApiContext& inContext, sqlite3* db, const HttpRequest& inRequest) {
+		requireWritable(inContext);
+		auto fields{ parseBody(inRequest) };
+		checkFields(fields, customerFields.data(), customerFields.size(), "Customer_Short_Name");
+		auto shortName{ fields.find("Customer_Short_Name") };
+		if (shortName == fields.end() || shortName->second.type != JsonValue::Type::String) throw ApiError{ 400, "Customer_Short_Name is required" };
+		std::string insertShortName{ shortName->second.text };
+		normaliseShortName(insertShortName);
+		if (insertShortName.empty()) throw ApiError{ 400, "Customer_Short_Name can't be blank" };
+		fields.erase(shortName);
+		//The menu always asks for both credit figures, so the reports never meet a customer without them. We default them to nothing owed.
+		for (const char* creditField : { "Credit_Limit", "Outstanding_Credit" }) {
+			if (!fields.count(creditField)) fields[creditField].type = JsonValue::Type::Number;
+		}
+
+		std::string insertStatement{ "INSERT INTO Customers(Customer_Short_Name" };
+		for (const auto& field : fields) insertStatement += ", " + field.first;
+		insertStatement += ", Created_On, Updated_On) VALUES (?";
+		for (std::size_t i = 0; i < fields.size(); ++i) insertStatement += ",?";
+		insertStatement += "," + std::string{ currentTime } + "," + currentTime + ");";
+		PreparedStatement insert{ db, insertStatement };
+		bindText(db, insert.get(), 1, insertShortName);
+		int index{ 2 };
+		for (const auto& field : fields) bindValue(db, insert.get(), index++, field.second);
+
+		//Short names are unique whatever their case, which the UNIQUE constraint doesn't check, so we check it ourselves inside the
+		//transaction, where nobody can add the same name between our check and our insert.
+		beginWrite(db, inContext.writePriority);
+		if (!resolveShortName(db, insertShortName).empty()) throw ApiError{ 409, "There is already a customer with the short name " + insertShortName };
+		if (sqlite3_step(insert.get()) != SQLITE_DONE) throw std::runtime_error{ "Error executing statement: " + std::string{ sqlite3_errmsg(db) } };
+		const sqlite3_int64 customerID{ sqlite3_last_insert_rowid(db) };
+		executeStatement("COMMIT TRANSACTION", db, false);
+
+		JsonWriter writer;
+		writeCustomer(writer, db, customerID);
+		return jsonResponse(201, writer);
+	}
+
+	HttpResponse updateCustomer(const CustomerApiContext& inContext, sqlite3* db, const std::string& inShortName, const HttpRequest& inRequest) {
+		requireWritable(inContext);
+		const auto fields{ parseBody(inRequest) };
+		checkFields(fields, customerFields.data(), customerFields.size());
+		if (fields.empty()) throw ApiError{ 400, "Nothing to change" };
+		const sqlite3_int64 customerID{ findCustomerID(db, inShortName) };
+		if (updateRow(inContext, db, "Customers", "Customer_ID", customerID, fields) == 0) throw ApiError{ 404, "No such customer: " + inShortName };
+
+		JsonWriter writer;
+		writeCustomer(writer, db, customerID);
+		return jsonResponse(200, writer);
+	}
+
+	HttpResponse deleteCustomer(const CustomerApiContext& inContext, sqlite3* db, const std::string& inShortName) {
+		requireWritable(inContext);
+		const sqlite3_int64 customerID{ findCustomerID(db, inShortName) };
+		PreparedStatement deleteAddresses{ db, "DELETE FROM CustomerAddress WHERE Customer_ID = ?;" };
+		PreparedStatement deleteCustomer{ db, "DELETE FROM Customers WHERE Customer_ID = ?;" };
+		bindInt(db, deleteAddresses.get(), 1, customerID);
+		bindInt(db, deleteCustomer.get(), 1, customerID);
+
+		//The customer and their addresses go together, or not at all.
+		beginWrite(db, inContext.writePriority);
+		if (sqlite3_step(deleteAddresses.get()) != SQLITE_DONE) throw std::runtime_error{ "Error deleting addresses: " + std::string{ sqlite3_errmsg(db) } };
+		const int addressesDeleted{ sqlite3_changes(db) };
+		if (sqlite3_step(deleteCustomer.get()) != SQLITE_DONE) throw std::runtime_error{ "Error deleting customer: " + std::string{ sqlite3_errmsg(db) } };
+		if (sqlite3_changes(db) == 0) throw ApiError{ 404, "No such customer: " + inShortName };
+		executeStatement("COMMIT TRANSACTION", db, false);
+
+		JsonWriter writer;
+		writer.beginObject().key("deleted").value(inShortName).key("addressesDeleted").value(addressesDeleted).endObject();
+		return jsonResponse(200, writer);
+	}
+
+	//Keyset paging in short name order: each page ends with the name to pass as "after" for the next, so a page costs the same however far
+	//through the list it is.
+	HttpResponse listCustomers(sqlite3* db, const HttpRequest& inRequest) {
+		const std::size_t limit{ queryNumber(inRequest, "limit", defaultListLimit, maxListLimit) };
+		auto after{ inRequest.query.find("after") };
+		PreparedStatement selectCustomers{ db, "SELECT * FROM Customers WHERE Customer_Short_Name > ? ORDER BY Customer_Short_Name LIMIT ?;" };
+		bindText(db, selectCustomers.get(), 1, after == inRequest.query.end() ? std::string{} : after->second);
+		bindInt(db, selectCustomers.get(), 2, static_cast<sqlite3_int64>(limit));
+
+		JsonWriter writer;
+		writer.beginObject().key("customers").beginArray();
+		std::size_t rows{ 0 };
+		std::string lastName;
+		while (selectCustomers.stepRow()) {
+			writeRow(writer, selectCustomers.get());
+			lastName = selectCustomers.columnText(1);
+			++rows;
+		}
+		writer.endArray().key("next");
+		if (rows == limit) writer.value(lastName);
+		else writer.null();
+		writer.endObject();
+		return jsonResponse(200, writer);
+	}
+
+	HttpResponse searchCustomers(sqlite3* db, const HttpRequest& inRequest) {
+		const std::size_t limit{ queryNumber(inRequest, "limit", defaultSearchResults, 1000) };
+		auto search{ inRequest.query.find("search") };
+		const bool phonetic{ search == inRequest.query.end() };
+		const std::string& term{ phonetic ? inRequest.query.at("sounds-like") : search->second };
+		if (term.empty()) throw ApiError{ 400, "The search term can't be blank" };
+		const std::vector<NameSearchMatch> matches{ phonetic ? phoneticSearchCustomers(db, term, limit) : fuzzySearchCustomers(db, term, limit) };
+
+		JsonWriter writer;
+		writer.beginObject().key("matches").beginArray();
+		for (const auto& match : matches) {
+			writer.beginObject()
+				.key("Customer_ID").value(match.customerID)
+				.key("Customer_Short_Name").value(match.shortName)
+				.key("Matched_Name").value(match.matchedName)
+				.key("Similarity").value(match.similarity)
+				.endObject();
+		}
+		writer.endArray().endObject();
+		return jsonResponse(200, writer);
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//										Addresses															//
+	//----------------------------------------------------------------------------------------------------------//
+
+	HttpResponse getAddresses(sqlite3* db, const std::string& inShortName) {
+		const sqlite3_int64 customerID{ findCustomerID(db, inShortName) };
+		PreparedStatement selectAddresses{ db, "SELECT * FROM CustomerAddress WHERE Customer_ID = ?;" };
+		bindInt(db, selectAddresses.get(), 1, customerID);
+		JsonWriter writer;
+		writeRowsAsJson(writer, selectAddresses.get());
+		return jsonResponse(200, writer);
+	}
+
+	HttpResponse addAddress(const CustomerApiContext& inContext, sqlite3* db, const std::string& inShortName, const HttpRequest& inRequest) {
+		requireWritable(inContext);
+		const auto fields{ parseBody(inRequest) };
+		checkFields(fields, addressFields.data(), addressFields.size());
+		auto firstLine{ fields.find("Address_Line_1") };
+		if (firstLine == fields.end() || firstLine->second.type != JsonValue::Type::String || firstLine->second.text.empty()) throw ApiError{ 400, "Address_Line_1 is required" };
+		const sqlite3_int64 customerID{ findCustomerID(db, inShortName) };
+
+		std::string insertStatement{ "INSERT INTO CustomerAddress(Customer_ID" };
+		for (const auto& field : fields) insertStatement += ", " + field.first;
+		insertStatement += ", Created_On, Updated_On) VALUES (?";
+		for (std::size_t i = 0; i < fields.size(); ++i) insertStatement += ",?";
+		insertStatement += "," + std::string{ currentTime } + "," + currentTime + ");";
+		PreparedStatement insert{ db, insertStatement };
+		bindInt(db, insert.get(), 1, customerID);
+		int index{ 2 };
+		for (const auto& field : fields) bindValue(db, insert.get(), index++, field.second);
+		runWrite(inContext, db, insert);
+
+		JsonWriter writer;
+		writeAddress(writer, db, sqlite3_last_insert_rowid(db));
+		return jsonResponse(201, writer);
+	}
+
+	HttpResponse updateAddress(const CustomerApiContext& inContext, sqlite3* db, sqlite3_int64 inAddressID, const HttpRequest& inRequest) {
+		requireWritable(inContext);
+		const auto fields{ parseBody(inRequest) };
+		checkFields(fields, addressFields.data(), addressFields.size());
+		if (fields.empty()) throw ApiError{ 400, "Nothing to change" };
+		auto firstLine{ fields.find("Address_Line_1") };
+		if (firstLine != fields.end() && firstLine->second.type == JsonValue::Type::Null) throw ApiError{ 400, "Address_Line_1 can't be null" };
+		if (updateRow(inContext, db, "CustomerAddress", "Address_ID", inAddressID, fields) == 0) throw ApiError{ 404, "No such address: " + std::to_string(inAddressID) };
+
+		JsonWriter writer;
+		writeAddress(writer, db, inAddressID);
+		return jsonResponse(200, writer);
+	}
+
+	HttpResponse deleteAddress(const CustomerApiContext& inContext, sqlite3* db, sqlite3_int64 inAddressID) {
+		requireWritable(inContext);
+		PreparedStatement deleteStatement{ db, "DELETE FROM CustomerAddress WHERE Address_ID = ?;" };
+		bindInt(db, deleteStatement.get(), 1, inAddressID);
+		if (runWrite(inContext, db, deleteStatement) == 0) throw ApiError{ 404, "No such address: " + std::to_string(inAddressID) };
+
+		JsonWriter writer;
+		writer.beginObject().key("deleted").value(static_cast<std::int64_t>(inAddressID)).endObject();
+		return jsonResponse(200, writer);
+	}
+
+	HttpResponse findAddresses(sqlite3* db, const HttpRequest& inRequest) {
+		auto postcode{ inRequest.query.find("postcode") };
+		if (postcode == inRequest.query.end() || postcode->second.empty()) throw ApiError{ 400, "Please give a postcode, e.g. /addresses?postcode=W12" };
+		JsonWriter writer;
+		writer.beginArray();
+		for (const auto& match : findAddressesByPostcode(db, postcode->second)) {
+			writer.beginObject()
+				.key("Address_ID").value(match.addressID)
+				.key("Customer_Short_Name").value(match.shortName)
+				.key("Address_Line_1").value(match.addressLine1)
+				.key("Postcode").value(match.postcode)
+				.endObject();
+		}
+		writer.endArray();
+		return jsonResponse(200, writer);
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//										Reports and custom SQL												//
+	//----------------------------------------------------------------------------------------------------------//
+
+	HttpResponse runReport(sqlite3* db, std::string_view inReport) {
+		JsonWriter writer;
+		if (inReport == "credit-risk" || inReport == "group-credit") {
+			PreparedStatement report{ db, inReport == "credit-risk" ? creditRiskStatement : groupCreditStatement };
+			writeRowsAsJson(writer, report.get());
+		}
+		else if (inReport == "duplicates") {
+			const DeduplicationReport report{ findDuplicates(db) };
+			writer.beginObject()
+				.key("customersScanned").value(report.customersScanned)
+				.key("addressesScanned").value(report.addressesScanned)
+				.key("clusters").beginArray();
+			for (const auto& cluster : report.clusters) {
+				writer.beginObject()
+					.key("kind").value(cluster.kind == DuplicateCluster::Kind::Customer ? "customer" : "address")
+					.key("score").value(cluster.score)
+					.key("reason").value(cluster.reason)
+					.key("records").beginArray();
+				for (std::size_t i = 0; i < cluster.ids.size(); ++i) writer.beginObject().key("id").value(cluster.ids[i]).key("description").value(cluster.descriptions[i]).endObject();
+				writer.endArray().endObject();
+			}
+			writer.endArray().endObject();
+		}
+		else throw ApiError{ 404, "No such report: " + std::string{ inReport } };
+		return jsonResponse(200, writer);
+	}
+
+	//Custom SQL, as from the menu, but only one statement and only one which reads. Changes should go through the requests above, which
+	//check what they're given.
+	HttpResponse runSql(sqlite3* db, const HttpRequest& inRequest) {
+		const auto fields{ parseBody(inRequest) };
+		auto sql{ fields.find("sql") };
+		if (sql == fields.end() || sql->second.type != JsonValue::Type::String) throw ApiError{ 400, "Please give the statement as {\"sql\": \"...\"}" };
+
+		sqlite3_stmt* statementHandle{ nullptr };
+		const char* tail{ nullptr };
+		if (sqlite3_prepare_v2(db, sql->second.text.c_str(), -1, &statementHandle, &tail) != SQLITE_OK) {
+			std::string errorMessage{ sqlite3_errmsg(db) };
+			sqlite3_finalize(statementHandle);
+			throw ApiError{ 400, "Error preparing statement: " + errorMessage };
+		}
+		std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> statement{ statementHandle, &sqlite3_finalize };
+		if (!statementHandle) throw ApiError{ 400, "There's no statement to run" };
+		if (std::string_view{ tail }.find_first_not_of(" \t\r\n;") != std::string_view::npos) throw ApiError{ 400, "Only one statement can be run at a time" };
+		if (!sqlite3_stmt_readonly(statementHandle)) throw ApiError{ 403, "Only statements which read the database can be run this way" };
+
+		JsonWriter writer;
+		writer.beginObject().key("rows").beginArray();
+		std::size_t rows{ 0 };
+		int stepStatus;
+		while (rows < maxSqlRows && (stepStatus = sqlite3_step(statementHandle)) == SQLITE_ROW) {
+			writeRow(writer, statementHandle);
+			++rows;
+		}
+		const bool truncated{ rows == maxSqlRows && sqlite3_step(statementHandle) == SQLITE_ROW };
+		if (rows < maxSqlRows && stepStatus != SQLITE_DONE) throw std::runtime_error{ "Error running statement: " + std::string{ sqlite3_errmsg(db) } };
+		writer.endArray().key("truncated").value(truncated).endObject();
+		return jsonResponse(200, writer);
+	}
+
+	void writeDelays(JsonWriter& writer, std::chrono::microseconds inTotal, std::size_t inCount, std::chrono::microseconds inMax) {
+		writer.key("meanWaitMs").value(inCount ? inTotal.count() / 1000.0 / inCount : 0.0).key("maxWaitMs").value(inMax.count() / 1000.0);
+	}
+
+	HttpResponse getStats(const CustomerApiContext& inContext) {
+		JsonWriter writer;
+		writer.beginObject();
+		if (inContext.server) {
+			const HttpServer::Stats server{ inContext.server->stats() };
+			writer.key("server").beginObject()
+				.key("connectionsAccepted").value(server.connectionsAccepted)
+				.key("connectionsOpen").value(server.connectionsOpen)
+				.key("connectionsRefused").value(server.connectionsRefused)
+				.key("requests").value(server.requests)
+				.key("requestsRejected").value(server.requestsRejected)
+				.key("badRequests").value(server.badRequests)
+				.endObject();
+
+			writer.key("admission").beginObject();
+			const std::array<std::pair<const char*, RequestCost>, requestCostClasses> costs{ { { "cheap", RequestCost::Cheap }, { "moderate", RequestCost::Moderate }, { "expensive", RequestCost::Expensive } } };
+			for (const auto& [name, cost] : costs) {
+				const AdmissionController::ClassStats stats{ inContext.server->admission().stats(cost) };
+				writer.key(name).beginObject()
+					.key("admitted").value(stats.admitted)
+					.key("rejected").value(stats.rejected)
+					.key("completed").value(stats.completed)
+					.key("running").value(static_cast<std::size_t>(stats.running))
+					.key("queued").value(stats.queued)
+					.key("peakQueued").value(stats.peakQueued);
+				writeDelays(writer, stats.totalQueueWait, stats.completed + stats.running, stats.maxQueueWait);
+				writer.endObject();
+			}
+			writer.endObject();
+		}
+
+		writer.key("writes").beginObject();
+		for (const auto& [name, priority] : { std::pair{ "interactive", WritePriority::Interactive }, std::pair{ "batch", WritePriority::Batch } }) {
+			const WriteQueueStats stats{ writeQueueStats(priority) };
+			writer.key(name).beginObject().key("writes").value(stats.writes);
+			writeDelays(writer, stats.totalDelay, stats.writes, stats.maxDelay);
+			writer.key("p99WaitMs").value(stats.p99Delay.count() / 1000.0).endObject();
+		}
+		writer.endObject();
+		writer.key("connectionsOpened").value(inContext.pool.opened());
+		writer.endObject();
+		return jsonResponse(200, writer);
+	}
+
+	HttpResponse methodNotAllowed(const HttpRequest& inRequest) {
+		return errorResponse(405, inRequest.method + " isn't supported for " + inRequest.path);
+	}
+
+	HttpResponse route(const CustomerApiContext& inContext, sqlite3* db, const HttpRequest& inRequest) {
+		const std::vector<std::string_view> path{ pathSegments(inRequest.path) };
+		const std::string& method{ inRequest.method };
+		const bool isGet{ method == "GET" };
+
+		if (path.size() == 1 && path[0] == "customers") {
+			if (method == "POST") return addCustomer(inContext, db, inRequest);
+			if (!isGet) return methodNotAllowed(inRequest);
+			if (inRequest.query.count("search") || inRequest.query.count("sounds-like")) return searchCustomers(db, inRequest);
+			return listCustomers(db, inRequest);
+		}
+		if (path.size() == 2 && path[0] == "customers") {
+			const std::string shortName{ path[1] };
+			if (isGet) return getCustomer(db, shortName);
+			if (method == "PATCH" || method == "PUT") return updateCustomer(inContext, db, shortName, inRequest);
+			if (method == "DELETE") return deleteCustomer(inContext, db, shortName);
+			return methodNotAllowed(inRequest);
+		}
+		if (path.size() == 3 && path[0] == "customers" && path[2] == "addresses") {
+			const std::string shortName{ path[1] };
+			if (isGet) return getAddresses(db, shortName);
+			if (method == "POST") return addAddress(inContext, db, shortName, inRequest);
+			return methodNotAllowed(inRequest);
+		}
+		if (path.size() == 1 && path[0] == "addresses") {
+			if (isGet) return findAddresses(db, inRequest);
+			return methodNotAllowed(inRequest);
+		}
+		if (path.size() == 2 && path[0] == "addresses") {
+			const sqlite3_int64 addressID{ parseID(path[1]) };
+			if (isGet) {
+				JsonWriter writer;
+				writeAddress(writer, db, addressID);
+				return jsonResponse(200, writer);
+			}
+			if (method == "PATCH" || method == "PUT") return updateAddress(inContext, db, addressID, inRequest);
+			if (method == "DELETE") return deleteAddress(inContext, db, addressID);
+			return methodNotAllowed(inRequest);
+		}
+		if (path.size() == 2 && path[0] == "reports") {
+			if (isGet) return runReport(db, path[1]);
+			return methodNotAllowed(inRequest);
+		}
+		if (path.size() == 1 && path[0] == "sql") {
+			if (method == "POST") return runSql(db, inRequest);
+			return methodNotAllowed(inRequest);
+		}
+		return errorResponse(404, "No such resource: " + inRequest.path);
+	}
+
+}
+
+
+RequestCost classifyCustomerApiRequest(const HttpRequest& inRequest) {
+	const std::vector<std::string_view> path{ pathSegments(inRequest.path) };
+	if (path.empty()) return RequestCost::Cheap;
+	if (path[0] == "reports" || path[0] == "sql") return RequestCost::Expensive;
+	if (path.size() == 1 && path[0] == "customers" && inRequest.method != "POST") {
+		if (inRequest.query.count("search") || inRequest.query.count("sounds-like")) return RequestCost::Moderate;
+		//A bad limit is classed as cheap, as it'll only be turned away.
+		auto limit{ inRequest.query.find("limit") };
+		if (limit == inRequest.query.end()) return RequestCost::Moderate;
+		return std::strtoul(limit->second.c_str(), nullptr, 10) > expensiveListLimit ? RequestCost::Expensive : RequestCost::Moderate;
+	}
+	if (path.size() == 1 && path[0] == "addresses") {
+		//A whole postcode area (just letters, e.g. "W") can cover a large part of the database. A district or full postcode can't.
+		auto postcode{ inRequest.query.find("postcode") };
+		if (postcode != inRequest.query.end() && postcode->second.find_first_of("0123456789") == std::string::npos) return RequestCost::Expensive;
+		return RequestCost::Moderate;
+	}
+	return RequestCost::Cheap;
+}
+
+
+HttpResponse handleCustomerApiRequest(const CustomerApiContext& inContext, const HttpRequest& inRequest) {
+	const std::vector<std::string_view> path{ pathSegments(inRequest.path) };
+	if (path.size() == 1 && path[0] == "stats") return inRequest.method == "GET" ? getStats(inContext) : methodNotAllowed(inRequest);
+
+	ConnectionPool::Lease connection{ inContext.pool.acquire() };
+	sqlite3* db{ connection.get() };
+	try {
+		return route(inContext, db, inRequest);
+	}
+	catch (ApiError& e) {
+		return errorResponse(e.status(), e.what());
+	}
+	catch (std::invalid_argument& e) {
+		return errorResponse(400, e.what());
+	}
+	catch (std::exception& e) {
+		//Our errors are all std::runtime_errors with SQLite's message, so the connection's error code says what went wrong.
+		const int errorCode{ sqlite3_errcode(db) };
+		if (errorCode == SQLITE_BUSY || errorCode == SQLITE_LOCKED) return errorResponse(503, std::string{ "The database is busy. Please try again shortly: " } + e.what());
+		if (errorCode == SQLITE_CONSTRAINT) return errorResponse(409, e.what());
+		return errorResponse(500, e.what());
+	}
+}
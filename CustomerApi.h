@@ -0,0 +1,28 @@
+#pragma once
+
+//Project includes
+#include "ConnectionPool.h"
+#include "HttpServer.h"
+#include "WriteScheduler.h"
+
+
+//The JSON interface served by --serve-http: customers and addresses to read, add, change and delete, plus the searches and reports from
+//the menus. Fields are named after the database columns, e.g. {"First_Name": "John", "Credit_Limit": 500}. See the README for the list of
+//requests.
+//
+//Each request runs on one of the server's worker threads, with a connection leased from the pool for as long as it takes. Writes go
+//through beginWrite() like the menus' do, so they queue as interactive or batch writes in the same way.
+
+struct CustomerApiContext {
+	ConnectionPool& pool;
+	bool readOnly{ false };								//Requests which would change anything get a 403.
+	WritePriority writePriority{ WritePriority::Interactive };
+	const HttpServer* server{ nullptr };					//For the server's own figures in /stats, if wanted.
+};
+
+//How costly a request is likely to be, so the server can give it to the right threads. Anything which could read a whole table, such
+//as the reports, custom SQL or a long listing, is Expensive; searches are Moderate; and anything touching one customer is Cheap.
+RequestCost classifyCustomerApiRequest(const HttpRequest& inRequest);
+
+//Answers a request. Errors come back as {"error": "..."} with a suitable status, rather than being thrown.
+HttpResponse handleCustomerApiRequest(const CustomerApiContext& inContext, const HttpRequest& inRequest);
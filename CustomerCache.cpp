@@ -0,0 +1,303 @@
+//Standard library includes
+#include <cctype>
+#include <stdexcept>
+
+//Project includes
+#include "CustomerCache.h"
+#include "PreparedStatement.h"
+
+namespace {
+
+	//Short names are looked up without regard to ASCII case, as with the Customers_Short_Name_NoCase index.
+	std::string foldShortName(std::string_view inShortName) {
+		std::string folded{ inShortName };
+		for (char& c : folded) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		return folded;
+	}
+
+	std::string selectColumnsStatement() {
+		std::string statement{ "SELECT " };
+		for (int i = 0; i < CustomerCache::columnCount; ++i) statement += (i == 0 ? "" : ", ") + std::string{ CustomerCache::columnNames[i] };
+		return statement + " FROM Customers";
+	}
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//										The customer_cache virtual table									//
+	//----------------------------------------------------------------------------------------------------------//
+	//See https://sqlite.org/vtab.html for what each of these callbacks is for. The table is read-only, so only the reading half is implemented.
+
+	//The ways xBestIndex can tell xFilter to find rows.
+	enum CachePlan { fullScan = 0, lookupByID = 1, lookupByShortName = 2 };
+
+	struct CacheTable {
+		sqlite3_vtab base;	//Must come first, as SQLite only knows about this part.
+		sqlite3* db;
+		CustomerCache* cache;
+		int openCursors{ 0 };
+	};
+
+	struct CacheCursor {
+		sqlite3_vtab_cursor base;	//Must come first, as SQLite only knows about this part.
+		std::vector<const CustomerCache::Row*> rows;	//The rows matched by the last call to xFilter.
+		std::size_t position{ 0 };
+	};
+
+
+	int cacheConnect(sqlite3* db, void* pAux, int /*argc*/, const char* const* /*argv*/, sqlite3_vtab** ppVtab, char** /*pzErr*/) {
+		//Short names are declared NOCASE so that comparisons on them behave the same as on the real table's index.
+		int declareStatus{ sqlite3_declare_vtab(db, "CREATE TABLE x(Customer_ID INTEGER, Customer_Short_Name TEXT COLLATE NOCASE, First_Name TEXT, Last_Name TEXT, "
+			"Group_Name TEXT, Credit_Limit NUMERIC, Outstanding_Credit NUMERIC, Created_On, Updated_On)") };
+		if (declareStatus != SQLITE_OK) return declareStatus;
+
+		CacheTable* table{ new CacheTable{} };
+		table->db = db;
+		table->cache = static_cast<CustomerCache*>(pAux);
+		*ppVtab = &table->base;
+		return SQLITE_OK;
+	}
+
+	int cacheDisconnect(sqlite3_vtab* pVtab) {
+		delete reinterpret_cast<CacheTable*>(pVtab);
+		return SQLITE_OK;
+	}
+
+	int cacheBestIndex(sqlite3_vtab* pVtab, sqlite3_index_info* pIdxInfo) {
+		CacheTable* table{ reinterpret_cast<CacheTable*>(pVtab) };
+		int idConstraint{ -1 };
+		int shortNameConstraint{ -1 };
+		for (int i = 0; i < pIdxInfo->nConstraint; ++i) {
+			const auto& constraint{ pIdxInfo->aConstraint[i] };
+			if (!constraint.usable || constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+			if (constraint.iColumn == 0) idConstraint = i;
+			else if (constraint.iColumn == 1) shortNameConstraint = i;
+		}
+
+		//We leave omit unset, so SQLite still checks each row we return against the constraint. That way type and collation quirks are always handled the same as for a real table.
+		if (idConstraint >= 0) {
+			pIdxInfo->idxNum = lookupByID;
+			pIdxInfo->aConstraintUsage[idConstraint].argvIndex = 1;
+			pIdxInfo->estimatedCost = 1.0;
+			pIdxInfo->estimatedRows = 1;
+			pIdxInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+		}
+		else if (shortNameConstraint >= 0) {
+			pIdxInfo->idxNum = lookupByShortName;
+			pIdxInfo->aConstraintUsage[shortNameConstraint].argvIndex = 1;
+			pIdxInfo->estimatedCost = 2.0;
+			pIdxInfo->estimatedRows = 1;
+			pIdxInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+		}
+		else {
+			pIdxInfo->idxNum = fullScan;
+			std::size_t rowCount{ table->cache->rows().empty() ? 1000 : table->cache->rows().size() };	//Before it's loaded we don't know, so we guess.
+			pIdxInfo->estimatedCost = static_cast<double>(rowCount);
+			pIdxInfo->estimatedRows = static_cast<sqlite3_int64>(rowCount);
+			//A full scan walks the cache in Customer_ID order, so we can save SQLite sorting by it.
+			if (pIdxInfo->nOrderBy == 1 && pIdxInfo->aOrderBy[0].iColumn == 0 && !pIdxInfo->aOrderBy[0].desc) pIdxInfo->orderByConsumed = 1;
+		}
+		return SQLITE_OK;
+	}
+
+	int cacheOpen(sqlite3_vtab* pVtab, sqlite3_vtab_cursor** ppCursor) {
+		CacheCursor* cursor{ new CacheCursor{} };
+		*ppCursor = &cursor->base;
+		++reinterpret_cast<CacheTable*>(pVtab)->openCursors;
+		return SQLITE_OK;
+	}
+
+	int cacheClose(sqlite3_vtab_cursor* pCursor) {
+		--reinterpret_cast<CacheTable*>(pCursor->pVtab)->openCursors;
+		delete reinterpret_cast<CacheCursor*>(pCursor);
+		return SQLITE_OK;
+	}
+
+	int cacheFilter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* /*idxStr*/, int /*argc*/, sqlite3_value** argv) {
+		CacheCursor* cursor{ reinterpret_cast<CacheCursor*>(pCursor) };
+		CacheTable* table{ reinterpret_cast<CacheTable*>(pCursor->pVtab) };
+		cursor->rows.clear();
+		cursor->position = 0;
+
+		//Other cursors (e.g. the other side of a self-join) may be holding on to rows, so we only bring the cache up to date when we're the only one.
+		try {
+			if (table->openCursors == 1) table->cache->refresh(table->db);
+		}
+		catch (std::exception& e) {
+			sqlite3_free(table->base.zErrMsg);
+			table->base.zErrMsg = sqlite3_mprintf("%s", e.what());
+			return SQLITE_ERROR;
+		}
+
+		if (idxNum == lookupByID) {
+			//A value which isn't a whole number can't match an integer ID.
+			if (sqlite3_value_numeric_type(argv[0]) == SQLITE_INTEGER) {
+				const CustomerCache::Row* row{ table->cache->findByID(sqlite3_value_int64(argv[0])) };
+				if (row) cursor->rows.push_back(row);
+			}
+		}
+		else if (idxNum == lookupByShortName) {
+			const unsigned char* shortName{ sqlite3_value_text(argv[0]) };
+			const CustomerCache::Row* row{ shortName ? table->cache->findByShortName(reinterpret_cast<const char*>(shortName)) : nullptr };
+			if (row) cursor->rows.push_back(row);
+		}
+		else {
+			cursor->rows.reserve(table->cache->rows().size());
+			for (const auto& [customerID, row] : table->cache->rows()) cursor->rows.push_back(&row);
+		}
+		return SQLITE_OK;
+	}
+
+	int cacheNext(sqlite3_vtab_cursor* pCursor) {
+		++reinterpret_cast<CacheCursor*>(pCursor)->position;
+		return SQLITE_OK;
+	}
+
+	int cacheEof(sqlite3_vtab_cursor* pCursor) {
+		CacheCursor* cursor{ reinterpret_cast<CacheCursor*>(pCursor) };
+		return cursor->position >= cursor->rows.size();
+	}
+
+	int cacheColumn(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int column) {
+		CacheCursor* cursor{ reinterpret_cast<CacheCursor*>(pCursor) };
+		const CustomerCache::Value& value{ (*cursor->rows[cursor->position])[column] };
+		switch (value.type) {
+		case SQLITE_INTEGER:
+			sqlite3_result_int64(context, value.integer);
+			break;
+		case SQLITE_FLOAT:
+			sqlite3_result_double(context, value.real);
+			break;
+		case SQLITE_TEXT:
+			sqlite3_result_text(context, value.text.c_str(), static_cast<int>(value.text.size()), SQLITE_TRANSIENT);
+			break;
+		default:
+			sqlite3_result_null(context);
+		}
+		return SQLITE_OK;
+	}
+
+	int cacheRowid(sqlite3_vtab_cursor* pCursor, sqlite3_int64* pRowid) {
+		CacheCursor* cursor{ reinterpret_cast<CacheCursor*>(pCursor) };
+		*pRowid = (*cursor->rows[cursor->position])[0].integer;
+		return SQLITE_OK;
+	}
+
+	sqlite3_module makeCacheModule() {
+		sqlite3_module module{};
+		module.iVersion = 1;
+		module.xCreate = cacheConnect;		//The table keeps no data in the database file, so creating it is no different to connecting to it.
+		module.xConnect = cacheConnect;
+		module.xBestIndex = cacheBestIndex;
+		module.xDisconnect = cacheDisconnect;
+		module.xDestroy = cacheDisconnect;
+		module.xOpen = cacheOpen;
+		module.xClose = cacheClose;
+		module.xFilter = cacheFilter;
+		module.xNext = cacheNext;
+		module.xEof = cacheEof;
+		module.xColumn = cacheColumn;
+		module.xRowid = cacheRowid;
+		return module;
+	}
+	const sqlite3_module cacheModule{ makeCacheModule() };
+
+
+	//Goes up whenever another connection commits a change to the database, but not for changes made by this one.
+	sqlite3_int64 selectDataVersion(sqlite3* db) {
+		PreparedStatement selectVersion{ db, "PRAGMA data_version;" };
+		return selectVersion.stepRow() ? sqlite3_column_int64(selectVersion.get(), 0) : 0;
+	}
+
+
+	//Called by SQLite for every row this connection inserts, updates or deletes. We can't query the database from in here, so we just note the change.
+	void customerUpdateHook(void* pArg, int /*operation*/, const char* /*databaseName*/, const char* tableName, sqlite3_int64 rowid) {
+		if (std::string_view{ tableName } == "Customers") static_cast<CustomerCache*>(pArg)->markChanged(rowid);
+	}
+
+}
+
+
+void CustomerCache::load(sqlite3* db) {
+	PreparedStatement selectCustomers{ db, selectColumnsStatement() + ";" };
+	m_rows.clear();
+	m_idsByShortName.clear();
+	m_changedIDs.clear();
+	m_dataVersion = selectDataVersion(db);
+	while (selectCustomers.stepRow()) loadRow(selectCustomers.get());
+	m_loaded = true;
+}
+
+
+void CustomerCache::refresh(sqlite3* db) {
+	//The update hook only sees our own changes. If another process (a batch import, or a server) has written since we loaded, we can't
+	//tell which customers it touched, so everything is read again.
+	if (!m_loaded || selectDataVersion(db) != m_dataVersion) {
+		load(db);
+		return;
+	}
+	if (m_changedIDs.empty()) return;
+
+	PreparedStatement selectCustomer{ db, selectColumnsStatement() + " WHERE Customer_ID = ?;" };
+	for (sqlite3_int64 customerID : m_changedIDs) {
+		//Whatever happened to the customer, we drop what we had. If they still exist, we then read them back in as they are now.
+		eraseRow(customerID);
+		sqlite3_reset(selectCustomer.get());
+		sqlite3_bind_int64(selectCustomer.get(), 1, customerID);
+		if (selectCustomer.stepRow()) loadRow(selectCustomer.get());
+	}
+	m_changedIDs.clear();
+}
+
+
+const CustomerCache::Row* CustomerCache::findByID(sqlite3_int64 customerID) const {
+	auto row{ m_rows.find(customerID) };
+	return row != m_rows.end() ? &row->second : nullptr;
+}
+
+
+const CustomerCache::Row* CustomerCache::findByShortName(std::string_view inShortName) const {
+	auto id{ m_idsByShortName.find(foldShortName(inShortName)) };
+	return id != m_idsByShortName.end() ? findByID(id->second) : nullptr;
+}
+
+
+void CustomerCache::loadRow(sqlite3_stmt* statementHandle) {
+	Row row(columnCount);
+	for (int i = 0; i < columnCount; ++i) {
+		Value& value{ row[i] };
+		value.type = sqlite3_column_type(statementHandle, i);
+		if (value.type == SQLITE_INTEGER) value.integer = sqlite3_column_int64(statementHandle, i);
+		else if (value.type == SQLITE_FLOAT) value.real = sqlite3_column_double(statementHandle, i);
+		else if (value.type != SQLITE_NULL) {
+			value.type = SQLITE_TEXT;	//There shouldn't be any blobs in this table, but if there are we treat them as text.
+			value.text = reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, i));
+		}
+	}
+	sqlite3_int64 customerID{ row[0].integer };
+	m_idsByShortName[foldShortName(row[1].text)] = customerID;
+	m_rows[customerID] = std::move(row);
+}
+
+
+void CustomerCache::eraseRow(sqlite3_int64 customerID) {
+	auto row{ m_rows.find(customerID) };
+	if (row == m_rows.end()) return;
+	m_idsByShortName.erase(foldShortName(row->second[1].text));
+	m_rows.erase(row);
+}
+
+
+void registerCustomerCache(sqlite3* db, CustomerCache& cache) {
+	int moduleStatus{ sqlite3_create_module_v2(db, "customer_cache", &cacheModule, &cache, NULL) };
+	if (moduleStatus != SQLITE_OK) throw std::runtime_error{ "Error registering customer_cache module: " + std::string{sqlite3_errmsg(db)} };
+
+	//The table goes in the temp schema so that it only exists for this connection, and nothing about it is written to the database file.
+	char* zErrorMsg{ nullptr };
+	if (sqlite3_exec(db, "CREATE VIRTUAL TABLE IF NOT EXISTS temp.CachedCustomers USING customer_cache;", NULL, NULL, &zErrorMsg) != SQLITE_OK) {
+		std::string errorMessage{ "Error creating CachedCustomers table: " + std::string{zErrorMsg ? zErrorMsg : sqlite3_errmsg(db)} };
+		sqlite3_free(zErrorMsg);
+		throw std::runtime_error{ errorMessage };
+	}
+
+	sqlite3_update_hook(db, customerUpdateHook, &cache);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <cstdint>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//An in-memory copy of the Customers table, which is exposed back to SQL as the virtual table temp.CachedCustomers.
+//Custom SQL can then query, join and filter customers without going to disk. Equality constraints on Customer_ID and Customer_Short_Name are
+//pushed down to the cache's own indexes, so e.g. "SELECT * FROM CachedCustomers WHERE Customer_Short_Name = 'JSMITH'" is a map lookup.
+//The cache is filled the first time it's needed. After that, an update hook on the connection notes every customer row this program changes,
+//and those customers are re-read from the database the next time refresh() is called. Changes made through other connections (another copy
+//of the program, or the servers' pooled connections) don't reach the hook, so refresh() also checks PRAGMA data_version, and reloads the
+//whole table if anyone else has committed since it was loaded.
+class CustomerCache {
+public:
+	//A single value from a row of the Customers table, keeping whichever type SQLite gave it to us as.
+	struct Value {
+		int type{ SQLITE_NULL };
+		sqlite3_int64 integer{ 0 };
+		double real{ 0.0 };
+		std::string text;
+	};
+
+	//The columns of the Customers table which are cached, in the order they appear in CachedCustomers.
+	static constexpr const char* columnNames[]{ "Customer_ID", "Customer_Short_Name", "First_Name", "Last_Name", "Group_Name", "Credit_Limit", "Outstanding_Credit", "Created_On", "Updated_On" };
+	static constexpr int columnCount{ static_cast<int>(sizeof(columnNames) / sizeof(columnNames[0])) };
+	using Row = std::vector<Value>;
+
+	//Loads the whole table into memory, replacing anything cached.
+	void load(sqlite3* db);
+
+	//Loads the table if it hasn't been yet or another connection has written to the database since, otherwise re-reads any customers this
+	//connection has changed since the last refresh.
+	void refresh(sqlite3* db);
+
+	//Forgets everything cached, so that the next refresh reloads the whole table. For when the table has been replaced wholesale, which the update hook doesn't see.
+	void reset() {
+		m_loaded = false;
+		m_changedIDs.clear();
+	}
+
+	//Notes that a customer has changed and will need re-reading. Called by the update hook.
+	void markChanged(sqlite3_int64 customerID) { m_changedIDs.insert(customerID); }
+
+	//Lookups used by the virtual table. These return nullptr if there is no such customer.
+	const Row* findByID(sqlite3_int64 customerID) const;
+	const Row* findByShortName(std::string_view inShortName) const;
+	const std::map<sqlite3_int64, Row>& rows() const { return m_rows; }
+
+private:
+	void loadRow(sqlite3_stmt* statementHandle);
+	void eraseRow(sqlite3_int64 customerID);
+
+	bool m_loaded{ false };
+	sqlite3_int64 m_dataVersion{ 0 };						//PRAGMA data_version when the table was loaded.
+	std::map<sqlite3_int64, Row> m_rows;					//Keyed (and so ordered) by Customer_ID.
+	std::map<std::string, sqlite3_int64> m_idsByShortName;	//Short names are unique, so this points straight at one row.
+	std::unordered_set<sqlite3_int64> m_changedIDs;
+};
+
+
+//Registers the customer_cache virtual table module with the connection, creates temp.CachedCustomers over the cache, and installs
+//the update hook which keeps track of changed customers. The cache must outlive the connection.
+void registerCustomerCache(sqlite3* db, CustomerCache& cache);
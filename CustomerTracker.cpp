@@ -7,10 +7,47 @@
 #include <limits> //To ignore bad input through the console
 #include <vector> //To store IDs in certain circumstances.
 #include <array>
+#include <cctype> //For classifying characters when normalising short names
+#include <fstream> //For exporting changes to file
+#include <chrono> //For timing startup
+#include <cmath>
 
 //Third party includes
 #include<sqlite3.h>
 
+//Project includes
+#include "CustomerTracker.h"
+#include "SchemaMigrations.h"
+#include "ShortNameIndex.h"
+#include "NameSearch.h"
+#include "SqlFunctions.h"
+#include "Postcodes.h"
+#include "Deduplication.h"
+#include "CustomerCache.h"
+#include "Reports.h"
+#include "ChangeExport.h"
+#include "BulkLoader.h"
+#include "Maintenance.h"
+#include "ConnectionStatus.h"
+#include "StartupOptions.h"
+#include "MemoryDatabase.h"
+#include "BusyHandler.h"
+#include "WriteScheduler.h"
+#include "ConnectionPool.h"
+#include "HttpServer.h"
+#include "CustomerApi.h"
+#include "LookupServer.h"
+
+
+
+//Turns a value from the database into the text we show the user. NULLs are shown as "NULL" (passing a null pointer to cout will throw an exception),
+//and timestamps, which are stored as seconds since 1970, are shown as dates.
+std::string displayValue(const char* inColumnName, const char* inValue) {
+	if (!inValue) return "NULL";
+	std::string value{ inValue };
+	if (isTimestampColumn(inColumnName) && !value.empty() && value.find_first_not_of("-0123456789") == std::string::npos) return formatTimestamp(std::stoll(value));
+	return value;
+}
 
 
 // Here we create a callback function to handle our sql commands. Parameters are as follows:
@@ -22,7 +59,7 @@ int callback(void* NotUsed, int argc, char** argv, char** azColName) {
 
 	//Print out the values called (e.g. in a SELECT statement)
 	for (int i = 0; i < argc; ++i) {
-		std::cout << azColName[i] << " : " << std::string(argv[i] ? argv[i] : "NULL") << '\n';	//?: used as a NULL value will throw an exception if unchecked.
+		std::cout << azColName[i] << " : " << displayValue(azColName[i], argv[i]) << '\n';
 	}
 	std::cout << '\n';
 
@@ -33,7 +70,7 @@ int callback(void* NotUsed, int argc, char** argv, char** azColName) {
 
 //This function wraps around executing pre-made SQL statements, while also providing confirmation printed to the console that they executed properly, or an error message if they did not.
 //NB: As this does not use prepared statements, it should only be used for SQL statements with no user input, to prevent injection.
-void executeStatement(const std::string& inStmt, sqlite3* inDB, bool showMessages = true) {
+void executeStatement(const std::string& inStmt, sqlite3* inDB, bool showMessages) {
 	char* zErrorMsg;
 	int status{ sqlite3_exec(inDB, inStmt.c_str(), callback, 0, &zErrorMsg) };
 	if (status!=SQLITE_OK) {		
@@ -110,6 +147,23 @@ void trimWhiteSpace(std::string& inString) {
 	else std::cerr << "Error: Trimming of whitespace failed.\n";
 }
 
+//This function normalises a customer short name entered by the user: leading and trailing whitespace is removed, and any run of whitespace inside the name is collapsed to a single space.
+//Combined with the case-insensitive index on Customer_Short_Name, this means that " jsmith " and "JSMITH" are treated as the same customer.
+void normaliseShortName(std::string& inString) {
+	std::string normalised;
+	normalised.reserve(inString.size());
+	bool pendingSpace{ false };
+	for (char c : inString) {
+		if (std::isspace(static_cast<unsigned char>(c))) pendingSpace = true;
+		else {
+			if (pendingSpace && !normalised.empty()) normalised += ' ';	//Only put a space back in if it sits between two parts of the name.
+			pendingSpace = false;
+			normalised += c;
+		}
+	}
+	inString = std::move(normalised);
+}
+
 
 //A function to run a SELECT COUNT statement on the db and return the result. If an error occurs, it returns -1.
 //NB: This function does not protect from injection. DO NOT CALL IT with user-entered data. This is due to limitations in binding column names to a statement
@@ -189,19 +243,120 @@ void bindValueOrNull(sqlite3* inDB, sqlite3_stmt* inStmt, int bindNumber, const
 	if (bindStatus != SQLITE_OK)throw std::runtime_error{ "Error binding " + std::string{inLabel} + " to statement : " + sqlite3_errmsg(inDB) };
 }
 
+//This function looks up a (normalised) customer short name without regard to case, and returns the short name exactly as it is stored in the database.
+//If there is no such customer, it returns an empty string.
+//The COLLATE NOCASE on the comparison matches the collation of the Customers_Short_Name_NoCase index, so this is a single index seek rather than a scan of the table.
+std::string resolveShortName(sqlite3* db, const std::string& inShortName) {
+	std::string storedName;
+	sqlite3_stmt* statementHandle;
+
+	std::string selectName{ "SELECT Customer_Short_Name FROM Customers WHERE Customer_Short_Name = ? COLLATE NOCASE;" };
+	int prepStatus{ sqlite3_prepare_v2(db, selectName.c_str(), -1, &statementHandle, NULL) };
+	if (prepStatus != SQLITE_OK) {
+		sqlite3_finalize(statementHandle);
+		throw std::runtime_error{ "Error preparing SELECT short name statement: " + std::string{sqlite3_errmsg(db)} };
+	}
+	int bindStatus{ sqlite3_bind_text(statementHandle,1,inShortName.c_str(),-1,SQLITE_TRANSIENT) };
+	if (bindStatus != SQLITE_OK) {
+		sqlite3_finalize(statementHandle);
+		throw std::runtime_error{ "Error binding to SELECT short name statement: " + std::string{sqlite3_errmsg(db)} };
+	}
+
+	int stepStatus{ sqlite3_step(statementHandle) };
+	if (stepStatus == SQLITE_ROW) storedName = reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, 0));
+	else if (stepStatus != SQLITE_DONE) {		//SQLITE_DONE just means there was no match, anything else is a genuine error.
+		sqlite3_finalize(statementHandle);
+		throw std::runtime_error{ "Error stepping into SELECT short name table: " + std::string{sqlite3_errmsg(db)} };
+	}
+
+	sqlite3_finalize(statementHandle);
+	return storedName;
+}
+
+//The number of completions offered when the operator enters a short name we don't recognise.
+constexpr std::size_t maxShortNameSuggestions{ 10 };
+
 //This function reads in a customer short name identifier entered by the user, and checks if it is in the database.
-std::string getShortName(sqlite3* db){
+//The lookup ignores case and excess whitespace, and the name returned is the one stored in the database, so it can be safely used in exact comparisons afterwards.
+//The database has the final say on whether a name exists, as the in-memory index can be out of date (another copy of the program may have added a
+//customer) or missing altogether if it failed to load. The index is used to offer the closest completions when the name isn't found, and is corrected
+//as we go. Ending the input with a * lists the names starting with what was typed, so the operator can complete a name without knowing all of it.
+std::string getShortName(sqlite3* db, ShortNameIndex& shortNames){
+	if (!shortNames.loaded()) {
+		try {
+			shortNames.load(db);
+		}
+		catch (std::exception& e) {
+			std::cerr << "Error loading customer short names: " << e.what() << "\nShort name completion will not be available.\n";
+		}
+	}
+
 	std::string shortName;
 	while (true) {						
 		std::getline(std::cin >> std::ws, shortName);		//Read in our short name
-		trimWhiteSpace(shortName);						//And trim off any trailing whitespace.
+		bool listCompletions{ !shortName.empty() && shortName.back() == '*' };
+		if (listCompletions) shortName.pop_back();
+		normaliseShortName(shortName);						//And tidy up any stray whitespace.
 
-		int shortNameCount{ selectCount(db,"*","Customers","Customer_Short_Name",shortName) };
-		if (shortNameCount == 0)std::cout << "Error: Customer short name not found in the database.\nPlease try again\n";
-		else if (shortNameCount == -1)std::cout << "An error occurred searching for that name in the database.\nPlease try again.\n";
+		if (!listCompletions) {
+			//Whatever the index thinks, we check the database, and fetch the name as it is stored there.
+			try {
+				std::string storedName{ resolveShortName(db, shortName) };
+				if (!storedName.empty()) {
+					if (shortNames.find(storedName).empty()) shortNames.insert(storedName);		//Added since the index was loaded.
+					shortName = std::move(storedName);
+					std::cout << "Customer identified. Proceeding.\n";
+					break;
+				}
+				if (!shortNames.find(shortName).empty()) shortNames.erase(shortName);		//It's gone from the database, so our index is out of date.
+			}
+			catch (std::exception& e) {
+				std::cout << "An error occurred searching for that name in the database: " << e.what() << "\nPlease try again.\n";
+				continue;
+			}
+		}
+
+		std::vector<std::string> completions{ shortNames.complete(shortName, maxShortNameSuggestions) };
+		if (completions.empty()) {
+			std::cout << "Error: Customer short name not found in the database.\n";
+			//Nothing starts with what they typed, so it may well be misspelled. See if any customer has a name which is close to it.
+			try {
+				std::vector<NameSearchMatch> closeMatches{ fuzzySearchCustomers(db, shortName, maxShortNameSuggestions) };
+				if (!closeMatches.empty()) {
+					std::cout << "Customers with similar names:\n";
+					for (const auto& match : closeMatches) std::cout << "  " << match.shortName << " (" << match.matchedName << ")\n";
+				}
+			}
+			catch (std::exception& e) {
+				std::cerr << "Error searching for similar names: " << e.what() << '\n';
+			}
+			std::cout << "Please try again, or enter the start of a name followed by * to list matching names.\n";
+		}
+		else if (completions.size() == 1) {
+			//If there is only one possibility, save the operator some typing.
+			std::cout << "Did you mean " << completions.front() << "? [y/n]\n";
+			if (getYesNo()) {
+				//The index may be out of date, so the database has to agree before we go ahead.
+				try {
+					std::string storedName{ resolveShortName(db, completions.front()) };
+					if (!storedName.empty()) {
+						shortName = std::move(storedName);
+						std::cout << "Customer identified. Proceeding.\n";
+						break;
+					}
+					shortNames.erase(completions.front());
+					std::cout << "Sorry, " << completions.front() << " is no longer in the database.\n";
+				}
+				catch (std::exception& e) {
+					std::cout << "An error occurred searching for that name in the database: " << e.what() << '\n';
+				}
+			}
+			std::cout << "Please try again.\n";
+		}
 		else {
-			std::cout << "Customer identified. Proceeding.\n";
-			break;
+			std::cout << (listCompletions ? "Matching customer short names" : "Customer short name not found. Did you mean") << (completions.size() == maxShortNameSuggestions ? " (first " + std::to_string(maxShortNameSuggestions) + " shown)" : "") << ":\n";
+			for (const auto& completion : completions) std::cout << "  " << completion << '\n';
+			std::cout << "Please enter the full short name, or a longer prefix followed by *\n";
 		}
 	}
 	return shortName;
@@ -286,8 +441,8 @@ int getAddressID(sqlite3* inDB, const std::string& inShortName) {
 
 	while (sqlite3_step(statementHandle) == SQLITE_ROW) {													//Iterate over every row in the result set.
 		for (int i = 0; i < columnHeaders.size(); ++i) {													//Iterate over all 11 columns in the table.
-			std::cout << columnHeaders[i] << " : " << (sqlite3_column_text(statementHandle, i) ? reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, i)) : "NULL") << '\n';	//And print the result to the console.
-																//We need the above ?: statement as if the value coming out is NULL, cout will throw an access violation exception. We also need to cast the result to match types.
+			std::cout << columnHeaders[i] << " : " << displayValue(columnHeaders[i], reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, i))) << '\n';	//And print the result to the console.
+																//We need to cast the result to match types.
 		}
 		addressIDs.push_back(sqlite3_column_int(statementHandle, 0));		//Store the address ID in the vector.
 		std::cout << '\n';				//And put out a newline for nice formatting.
@@ -321,65 +476,62 @@ int getAddressID(sqlite3* inDB, const std::string& inShortName) {
 // While technically the INSERT OR IGNORE status means we could run this function at every program startup, I figure it's best to only run it when necessary.
 void insertSampleData(sqlite3* inDB) {
 	std::string stmt;
-	stmt = "INSERT OR IGNORE INTO Customers (Customer_ID, Customer_Short_Name, First_Name, Last_Name,  Group_Name, Credit_Limit,  Outstanding_Credit, Created_On, Updated_On) VALUES( 1, 'JSMITH', 'John', 'Smith',  'SMITH FAMILY', ' 10000', ' 0', DATE('now'), DATE('now')); "
+	stmt = "INSERT OR IGNORE INTO Customers (Customer_ID, Customer_Short_Name, First_Name, Last_Name,  Group_Name, Credit_Limit,  Outstanding_Credit, Created_On, Updated_On) VALUES( 1, 'JSMITH', 'John', 'Smith',  'SMITH FAMILY', ' 10000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 
-	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(2,'MSMITH', 'Mary', 'Smith', 'SMITH FAMILY', ' 10000', ' 0', DATE('now'), DATE('now')); "
+	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(2,'MSMITH', 'Mary', 'Smith', 'SMITH FAMILY', ' 10000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 
-	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(3,'BSMITH','Bob', 'Smith', 'SMITH FAMILY', ' 5000', ' 0', DATE('now'), DATE('now')); "
+	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(3,'BSMITH','Bob', 'Smith', 'SMITH FAMILY', ' 5000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 
-	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(4,'BJONES', 'Brian', 'Jones', 'JONES FAMILY', ' 5000', ' 0', DATE('now'), DATE('now')); "
+	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(4,'BJONES', 'Brian', 'Jones', 'JONES FAMILY', ' 5000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 
-	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(5,'DTRACEY', 'Donald', 'Tracey', 'TRACEY FAMILY', ' 3000', ' 0', DATE('now'), DATE('now')); "
+	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(5,'DTRACEY', 'Donald', 'Tracey', 'TRACEY FAMILY', ' 3000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 
-	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(6, 'ABAKER', 'Anthony', 'Baker', 'BAKER FAMILY', ' 5000', ' 0', DATE('now'), DATE('now')); "
+	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(6, 'ABAKER', 'Anthony', 'Baker', 'BAKER FAMILY', ' 5000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 
-	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(7, 'AMCKECHNIE','Alastair', 'McKechnie', 'MCKECHNIE FAMILY', ' 7000', ' 0', DATE('now'), DATE('now')); "
+	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(7, 'AMCKECHNIE','Alastair', 'McKechnie', 'MCKECHNIE FAMILY', ' 7000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 
-	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(8, 'RGOULDING', 'Robert', 'Goulding', 'GOULDING', ' 5000', ' 0', DATE('now'), DATE('now')); ";
+	"INSERT OR IGNORE INTO Customers(Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES(8, 'RGOULDING', 'Robert', 'Goulding', 'GOULDING', ' 5000', ' 0', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); ";
 
 	std::cout << "Adding sample Customer data:\n";
 	executeStatement(stmt, inDB);
 
-	stmt = "INSERT OR IGNORE INTO  CustomerAddress (Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(1,(select Customer_id from Customers where Customer_Short_Name = 'JSMITH'), 'HOME', '', '1 Regent Road', 'London', 'W12 5GG', '', '', DATE('now'), DATE('now')); "
+	stmt = "INSERT OR IGNORE INTO  CustomerAddress (Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(1,(select Customer_id from Customers where Customer_Short_Name = 'JSMITH'), 'HOME', '', '1 Regent Road', 'London', 'W12 5GG', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 		
-		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(2,(select Customer_ID from Customers where Customer_Short_Name = 'MSMITH'), 'HOME', '', '1 Regent Road', 'London', 'W12 5GG', '', '', DATE('now'), DATE('now')); "
+		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(2,(select Customer_ID from Customers where Customer_Short_Name = 'MSMITH'), 'HOME', '', '1 Regent Road', 'London', 'W12 5GG', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 	
-		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(3,(select Customer_ID from Customers where Customer_Short_Name = 'BSMITH'), 'HOME', '', '1 Regent Road', 'London', 'W12 5GG', '', '', DATE('now'), DATE('now')); "
+		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(3,(select Customer_ID from Customers where Customer_Short_Name = 'BSMITH'), 'HOME', '', '1 Regent Road', 'London', 'W12 5GG', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 	
-		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(4,(select Customer_ID from Customers where Customer_Short_Name = 'JSMITH'), 'WORK', '', '26 Lombard Street', 'London', 'EC4', '', '', DATE('now'), DATE('now')); "
+		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(4,(select Customer_ID from Customers where Customer_Short_Name = 'JSMITH'), 'WORK', '', '26 Lombard Street', 'London', 'EC4', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 	
-		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(5,(select Customer_ID from Customers where Customer_Short_Name = 'DTRACEY'), 'HOME', '', '5 Bright Street', 'Dorking', 'Surrey', '', '', DATE('now'), DATE('now')); "
+		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(5,(select Customer_ID from Customers where Customer_Short_Name = 'DTRACEY'), 'HOME', '', '5 Bright Street', 'Dorking', 'Surrey', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 	
-		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(6,(select Customer_ID from Customers where Customer_Short_Name = 'ABAKER'), 'HOME', '', '21 Hope Street', 'Barnet', 'Middlesex', '', '', DATE('now'), DATE('now')); "
+		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(6,(select Customer_ID from Customers where Customer_Short_Name = 'ABAKER'), 'HOME', '', '21 Hope Street', 'Barnet', 'Middlesex', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 	
-		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(7,(select Customer_ID from Customers where Customer_Short_Name = 'ABAKER'), 'WORK', '', '1 Canada Square', 'Canary Wharf', 'London', '', '', DATE('now'), DATE('now')); "
+		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(7,(select Customer_ID from Customers where Customer_Short_Name = 'ABAKER'), 'WORK', '', '1 Canada Square', 'Canary Wharf', 'London', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER)); "
 	
-		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(8,(select Customer_ID from Customers where Customer_Short_Name = 'ABAKER'), 'UNKNOWN', '', '17 Broad Street', 'London', 'EC3', '', '', DATE('now'), DATE('now'));";
+		"INSERT OR IGNORE INTO  CustomerAddress(Address_ID, Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES(8,(select Customer_ID from Customers where Customer_Short_Name = 'ABAKER'), 'UNKNOWN', '', '17 Broad Street', 'London', 'EC3', '', '', CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER));";
 
 	std::cout << "Adding sample Address data: \n";
 	executeStatement(stmt, inDB);
 }
 
 
-int main(){
-	//Declare our db
-	sqlite3* db;
-	
-	//Declare the varables we're going to use as we go along.
-	std::string stmt;							//Our (non-prepared) sql statement. For hard-coded SQL statements (e.g. opening the db, setting up tables, etc) we don't need to worry about injection.
-	sqlite3_stmt* preparedStatement;			//Our prepared statement handle used for when we need to go through the sqlite_prepare_v2() process. 
-	std::string inputLine{ "DEFAULT VALUE SHOULD NEVER BE USED" };	//An all-purpose string to store input from the user.
-
-	//Use an int to ensure we could make the connection properly
-	auto openStatus = sqlite3_open("Customers.db", &db);
+//Everything which makes sure the database is fit to use before we start: creating the tables if they aren't there, applying any schema migrations,
+//and adding the sample data to an empty database. Returns false if the program can't continue.
+//This all writes to the database, so it's skipped when the database is opened read-only.
+bool prepareDatabase(sqlite3* db) {
+	using namespace std::literals::string_literals;
 
-	//If there was an error.
-	if (openStatus != SQLITE_OK) {
-		std::cerr << "Error opening DB: " << sqlite3_errmsg(db) << '\n';
-		sqlite3_close(db);
-		return -1;			//If we can't open the DB then we can't do anything remotely useful with it
+	//The fast path. A database already at the latest schema version was set up by an earlier run - its tables were created, and every migration
+	//applied, before user_version could reach that number - so there's nothing here left to check, and a single PRAGMA read is all startup costs.
+	//Anything else (a new database, or one from an older version of the program) goes through the full set of checks below, once.
+	try {
+		if (readUserVersion(db) == latestSchemaVersion()) return true;
 	}
-	else std::cout << "Database opened successfully." << '\n';
+	catch (std::exception&) {}			//If we can't even read the version, the checks below will say why.
+
+	std::string stmt;
+	sqlite3_stmt* preparedStatement;
 
 	//Debug lines
 	//stmt = "DROP TABLE Customers; DROP TABLE CustomerAddress;";
@@ -423,8 +575,8 @@ int main(){
 	executeStatement(stmt, db);
 	std::cout << '\n';
 
-	//To prevent needing to manually call the std::constructor when concatenating const chars, we use the std::string literal operator for our main processing.
-	using namespace std::literals::string_literals;
+	//Bring any existing database up to date with the indexes and other schema changes made since the tables were first designed.
+	applySchemaMigrations(db);
 
 	//Now to see if the table is empty, and populate it with sample data if so.
 	int customerCount{ -1 };	//Initialise to -1 as it will never be given as an answer for the number of rows in a table.
@@ -454,32 +606,226 @@ int main(){
 	catch (std::exception& e) {
 		std::cerr << "An error occurred during startup: " << e.what();
 		std::cerr << "\n The program cannot continue. Terminating.";
-		return -1;
+		return false;
 	}
 
 	if (customerCount == -1)std::cerr << "Error adding sample data to table.\n";
 	std::cout << '\n';
+
+	return true;
+}
+
+
+int main(int argc, char* argv[]){
+	//We report how long startup took, as this program is often run from scripts where it adds up.
+	const auto startupBegan{ std::chrono::steady_clock::now() };
+
+	//Read any startup options first, as the SQLite settings among them have to be made before the database is opened.
+	StartupOptions startupOptions;
+	try {
+		startupOptions = parseStartupOptions(argc, argv);
+		configureSqlite(startupOptions.sqlite);
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << "\n\n";
+		printStartupUsage(std::cerr);
+		return -1;
+	}
+	if (startupOptions.showUsage) {
+		printStartupUsage(std::cout);
+		return 0;
+	}
+	if (startupOptions.benchmarkSqliteConfig) {
+		try {
+			runSqliteConfigBenchmark("Customers.db", std::cout);
+		}
+		catch (std::exception& e) {
+			std::cerr << "Error running benchmark: " << e.what() << '\n';
+			return -1;
+		}
+		return 0;
+	}
+	//In single-thread mode SQLite does no locking at all, so nothing else may touch it while the main thread is.
+	const bool singleThreaded{ startupOptions.sqlite.threading == ThreadingMode::SingleThread };
+
+	//A copy of the program started for a batch job lets people making changes by hand go first. See WriteScheduler.h.
+	const WritePriority writePriority{ startupOptions.batch ? WritePriority::Batch : WritePriority::Interactive };
+
+	//Declare our db, and its busy handler, which has to outlive it.
+	BusyHandler busyHandler{ startupOptions.busy };
+	sqlite3* db;
+	
+	//Declare the varables we're going to use as we go along.
+	std::string stmt;							//Our (non-prepared) sql statement. For hard-coded SQL statements (e.g. opening the db, setting up tables, etc) we don't need to worry about injection.
+	sqlite3_stmt* preparedStatement;			//Our prepared statement handle used for when we need to go through the sqlite_prepare_v2() process. 
+	std::string inputLine{ "DEFAULT VALUE SHOULD NEVER BE USED" };	//An all-purpose string to store input from the user.
+
+	//Use an int to ensure we could make the connection properly
+	//In in-memory mode the file is copied into a private in-memory database by the MemoryDatabaseSaver below, which saves it back later on.
+	//In read-only mode the file is opened through a URI, so we can ask for immutable=1 where wanted. The URI form also stops SQLite creating an
+	//empty database if the file isn't there.
+	int openStatus;
+	if (startupOptions.readOnly) openStatus = sqlite3_open_v2(startupOptions.immutable ? "file:Customers.db?immutable=1" : "file:Customers.db?mode=ro", &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, NULL);
+	else openStatus = sqlite3_open(startupOptions.inMemory ? ":memory:" : "Customers.db", &db);
+	//If there was an error.
+	if (openStatus != SQLITE_OK) {
+		std::cerr << "Error opening DB: " << sqlite3_errmsg(db) << '\n';
+		sqlite3_close(db);
+		return -1;			//If we can't open the DB then we can't do anything remotely useful with it
+	}
+	else std::cout << "Database opened successfully." << '\n';
+	if (describeSqliteConfig(startupOptions.sqlite) != describeSqliteConfig({})) std::cout << "SQLite settings: " << describeSqliteConfig(startupOptions.sqlite) << '\n';
+
+	//The background maintenance scheduler (or another copy of the program) may hold a lock when we want one, so rather than fail straight away
+	//we back off and retry for a while. The time spent waiting shows up in the SQLite statistics report.
+	busyHandler.install(db);
+	registerConnection(db, startupOptions.inMemory ? "Main (in memory)" : startupOptions.readOnly ? "Main (read-only)" : "Main", &busyHandler);
+
+	//Our own SQL functions need to be in place before anything touches the tables, as some of the triggers rely on them.
+	//The customer cache is also set up here, so that its update hook sees every change we make from now on.
+	CustomerCache customerCache;
+	try {
+		registerSqlFunctions(db);
+		registerCustomerCache(db, customerCache);
+	}
+	catch (std::exception& e) {
+		std::cerr << "An error occurred during startup: " << e.what();
+		std::cerr << "\n The program cannot continue. Terminating.";
+		sqlite3_close(db);
+		return -1;
+	}
+
+	//Loads the in-memory database and keeps the file up to date with it. If we can't lock the file, there's no point doing any work which can't be kept.
+	MemoryDatabaseSaver memorySaver{ db, "Customers.db", std::chrono::seconds{ startupOptions.saveIntervalSeconds } };
+	if (startupOptions.inMemory) {
+		try {
+			memorySaver.start();
+			if (memorySaver.timed()) std::cout << "Working in memory. Changes are saved to Customers.db every " << startupOptions.saveIntervalSeconds << " seconds, and on exit.\n";
+			else std::cout << "Working in memory. Changes are saved to Customers.db on exit.\n";
+		}
+		catch (std::exception& e) {
+			std::cerr << "Error starting in-memory mode: " << e.what() << '\n';
+			unregisterConnection(db);
+			sqlite3_close(db);
+			return -1;
+		}
+	}
+
+	if (startupOptions.readOnly) {
+		//We can't bring an older database up to date without writing to it, so all we can do is warn that some features may not work.
+		try {
+			const int version{ readUserVersion(db) };
+			if (version != latestSchemaVersion()) {
+				std::cerr << "Warning: The database is at schema version " << version << ", but this program expects version " << latestSchemaVersion()
+					<< ". Open it read-write once to update it, or some searches and reports may not work.\n";
+			}
+		}
+		catch (std::exception& e) {
+			std::cerr << "Error reading the schema version: " << e.what() << '\n';
+		}
+	}
+	else if (!prepareDatabase(db)) return -1;
+
+	//To prevent needing to manually call the std::constructor when concatenating const chars, we use the std::string literal operator for our main processing.
+	using namespace std::literals::string_literals;
+
+
+	//Every short name is held in memory, so the prompts which ask for a customer can offer completions without querying the database on every attempt.
+	//They're loaded the first time a prompt needs them, rather than here, so that runs which never ask for a customer don't pay for it.
+	ShortNameIndex shortNames;
 	
+	//Tidy the database up in the background whenever the program is left idle. This is a nice-to-have, so the program carries on without it if need be.
+	MaintenanceScheduler maintenance{ sqlite3_db_filename(db, "main") };
+	try {
+		if (singleThreaded) std::cout << "Background maintenance is off, as SQLite is running single-threaded.\n";
+		else if (startupOptions.inMemory) std::cout << "Background maintenance is off while working in memory.\n";
+		else if (startupOptions.readOnly) std::cout << "Read-only mode. Changes can't be made, and background maintenance is off.\n";
+		else maintenance.start();
+	}
+	catch (std::exception& e) {
+		std::cerr << "Error starting background maintenance: " << e.what() << "\nThe database will not be maintained while the program is idle.\n";
+	}
+
+	//Writes SQLite's memory and cache counters to a log file every so often, when switched on from the reports menu.
+	StatusLogger statusLogger;
+
 	//And now that setup is out of the way, we can get on to our main user input.
-	std::cout << "Welcome to the Customer Manager. ";
+	const double startupMilliseconds{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegan).count() };
+	std::cout << "Started in " << std::round(startupMilliseconds * 10) / 10 << " ms.\n";
 	bool exitProgram{ false };	//This bool is used to keep track of whether to exit the main loop.
 
+	//Serving the JSON interface or binary lookups takes the place of the menus. The requests are answered on worker connections of their own,
+	//opened the same way as ours, while ours stays open for the maintenance scheduler's sake and is closed as normal once the server stops.
+	if (startupOptions.serveHttp || startupOptions.serveLookups) {
+		exitProgram = true;
+		try {
+			ConnectionPool::Settings poolSettings;
+			poolSettings.path = startupOptions.readOnly ? (startupOptions.immutable ? "file:Customers.db?immutable=1" : "file:Customers.db?mode=ro") : "Customers.db";
+			poolSettings.readOnly = poolSettings.uri = startupOptions.readOnly;
+			poolSettings.busy = startupOptions.busy;
+			ConnectionPool pool{ poolSettings };
+
+			if (startupOptions.serveHttp) {
+				HttpServerOptions serverOptions;
+				serverOptions.port = startupOptions.httpPort;
+				HttpServer* runningServer{ nullptr };
+				const CustomerApiContext apiContext{ pool, startupOptions.readOnly, writePriority, nullptr };
+				HttpServer server{ serverOptions, classifyCustomerApiRequest, [&](const HttpRequest& inRequest) {
+					maintenance.noteActivity();
+					CustomerApiContext context{ apiContext };
+					context.server = runningServer;
+					return handleCustomerApiRequest(context, inRequest);
+				} };
+				runningServer = &server;
+				server.listen();
+				std::cout << "Serving customers on http://127.0.0.1:" << server.port() << "/ - press Ctrl+C to stop.\n";
+				server.run();
+				const HttpServer::Stats stats{ server.stats() };
+				std::cout << "Stopped serving after " << stats.requests << " requests (" << stats.requestsRejected << " turned away as too busy).\n";
+			}
+			else {
+				LookupServerOptions serverOptions;
+				serverOptions.socketPath = startupOptions.lookupSocket;
+				serverOptions.onBatch = [&] { maintenance.noteActivity(); };
+				LookupServer server{ serverOptions, pool };
+				server.listen();
+				std::cout << "Serving customer lookups on " << server.socketPath() << " - press Ctrl+C to stop.\n";
+				server.run();
+				const LookupServer::Stats stats{ server.stats() };
+				std::cout << "Stopped serving after " << stats.lookups << " lookups in " << stats.frames << " frames (" << stats.framesRejected << " frames turned away as too busy).\n";
+			}
+		}
+		catch (std::exception& e) {
+			std::cerr << "Error serving: " << e.what() << '\n';
+		}
+	}
+	else std::cout << "Welcome to the Customer Manager. ";
+
 
 
 	//A big loop which allows us to perform however many operations we like as the program is run.
 	while (!exitProgram) {
 
 		//First we need to display options and ask for input.
+		const char* readOnlyNote{ startupOptions.readOnly ? "(not available read-only) " : "" };
 		std::cout << "Please select your option by entering the correct number : \n" 
 		"1. View data in the database. \n"
-		"2. Add new data to the database. \n"
-		"3. Update existing data in the database. \n"
-		"4. Remove customer(s) from the database. \n"
+		"2. Add new data to the database. " << readOnlyNote << "\n"
+		"3. Update existing data in the database. " << readOnlyNote << "\n"
+		"4. Remove customer(s) from the database. " << readOnlyNote << "\n"
 		"5. Run custom SQL on the database. \n"
+		"6. Reports and database diagnostics. \n"
 		"0. Exit \n";
 
 		std::cout << "\n";
-		int selection{ getIntBetween(0,5) };
+		maintenance.noteActivity();
+		int selection{ getIntBetween(0,6) };
+		maintenance.noteActivity();		//Again, as the user may have been away from the menu for some time before choosing.
+
+		if (startupOptions.readOnly && selection >= 2 && selection <= 4) {
+			std::cout << "Sorry, the database has been opened read-only, so it can't be changed.\n\n";
+			continue;
+		}
 		
 
 		//Now to go over the input.
@@ -515,8 +861,12 @@ int main(){
 						"2: View all Address data.\n"
 						"3: View all Customer and Address joint data.\n"
 						"4: Search for data on a specific customer.\n"
+						"5: Search for customers by approximate name.\n"
+						"6: Search for customers whose name sounds like another.\n"
+						"7: View addresses in a postcode area or district.\n"
+						"8: Find likely duplicate customers and addresses.\n"
 						"0: Exit.\n";
-					int userSelection{ getIntBetween(0,4) };
+					int userSelection{ getIntBetween(0,8) };
 
 					switch (userSelection) {
 					case 0:
@@ -531,9 +881,9 @@ int main(){
 					case 3:
 						executeStatement("SELECT * FROM Customers INNER JOIN CustomerAddress WHERE Customers.Customer_ID = CustomerAddress.Customer_ID ORDER BY Customers.Customer_ID;", db);
 						break;
-					case 4:
+					case 4: {
 						std::cout << "Please enter the short name identifier of the customer you would like to search.\n";
-						inputLine = getShortName(db);
+						inputLine = getShortName(db, shortNames);
 
 
 						//We want to print customer data and then address data.
@@ -549,7 +899,7 @@ int main(){
 						else { //Otherwise...
 							//We print customer data first.
 							std::cout << "Customer Data:\n";
-							std::string selectStatement{ "SELECT * FROM Customers WHERE Customer_ID = '" + std::to_string(customerID) + "';" };				//As customer ID is an internal (integer) variable and never entered by the user, we don't need to prepare
+							std::string selectStatement{ "SELECT *, CREDIT_UTILISATION(Credit_Limit, Outstanding_Credit) AS Credit_Utilisation FROM Customers WHERE Customer_ID = '" + std::to_string(customerID) + "';" };				//As customer ID is an internal (integer) variable and never entered by the user, we don't need to prepare
 							executeStatement(selectStatement, db, false);
 							//Then count how many addresses the Customer has.
 							int numberOfAddresses{ selectCount(db,"*","CustomerAddress","Customer_ID",std::to_string(customerID)) };
@@ -558,6 +908,72 @@ int main(){
 							selectStatement = "SELECT * FROM CustomerAddress WHERE Customer_ID = '" + std::to_string(customerID) + "';";
 							executeStatement(selectStatement, db, false);
 						}
+						break;
+					}
+					case 5: {
+						//Here the operator doesn't need to know exactly how the name is spelled. We match against first, last, short and contact names.
+						std::cout << "Please enter the name to search for:\n";
+						std::getline(std::cin >> std::ws, inputLine);
+						trimWhiteSpace(inputLine);
+
+						std::vector<NameSearchMatch> matches{ fuzzySearchCustomers(db, inputLine, maxShortNameSuggestions) };
+						if (matches.empty()) std::cout << "No customers found with a name similar to " << inputLine << ".\n";
+						else {
+							std::cout << "Closest matches for " << inputLine << ":\n";
+							for (const auto& match : matches) {
+								std::cout << "  " << match.shortName << " - matched on " << match.matchedName << " (" << static_cast<int>(match.similarity * 100 + 0.5) << "% similar)\n";
+							}
+						}
+						std::cout << '\n';
+						break;
+					}
+					case 6: {
+						std::cout << "Please enter the name to search for:\n";
+						std::getline(std::cin >> std::ws, inputLine);
+						trimWhiteSpace(inputLine);
+
+						std::vector<NameSearchMatch> matches{ phoneticSearchCustomers(db, inputLine, maxShortNameSuggestions) };
+						if (matches.empty()) std::cout << "No customers found with a name which sounds like " << inputLine << ".\n";
+						else {
+							std::cout << "Customers with a name which sounds like " << inputLine << ":\n";
+							for (const auto& match : matches) std::cout << "  " << match.shortName << " - " << match.matchedName << '\n';
+						}
+						std::cout << '\n';
+						break;
+					}
+					case 7: {
+						std::cout << "Please enter a postcode area (e.g. W), district (e.g. W12) or full postcode (e.g. W12 5GG):\n";
+						std::getline(std::cin >> std::ws, inputLine);
+						trimWhiteSpace(inputLine);
+
+						std::vector<PostcodeMatch> matches{ findAddressesByPostcode(db, inputLine) };
+						std::cout << "Found " << matches.size() << " addresses in " << inputLine << (matches.empty() ? ".\n" : ":\n");
+						for (const auto& match : matches) {
+							std::cout << "  " << match.postcode << " - Address " << match.addressID << " (" << match.shortName << "): " << match.addressLine1 << '\n';
+						}
+						std::cout << '\n';
+						break;
+					}
+					case 8: {
+						std::cout << "Searching for duplicates. This may take a while on a large database...\n";
+						DeduplicationReport report{ findDuplicates(db) };
+						std::cout << "Scanned " << report.customersScanned << " customers and " << report.addressesScanned << " addresses with " << report.comparisonsMade << " comparisons.\n";
+						if (report.oversizedBlocksSkipped > 0) std::cout << report.oversizedBlocksSkipped << " groups were too large to compare and were skipped.\n";
+
+						if (report.clusters.empty()) std::cout << "No likely duplicates found.\n";
+						else {
+							//Print the clusters we're most sure of. There could be thousands, and the operator can only act on so many at once.
+							constexpr std::size_t maxClustersShown{ 20 };
+							std::cout << "Found " << report.clusters.size() << " groups of likely duplicates" << (report.clusters.size() > maxClustersShown ? ", most likely first:\n" : ":\n");
+							for (std::size_t i = 0; i < report.clusters.size() && i < maxClustersShown; ++i) {
+								const DuplicateCluster& cluster{ report.clusters[i] };
+								std::cout << (cluster.kind == DuplicateCluster::Kind::Customer ? "Customers" : "Addresses") << " (" << static_cast<int>(cluster.score * 100 + 0.5) << "% - " << cluster.reason << "):\n";
+								for (std::size_t j = 0; j < cluster.ids.size(); ++j) std::cout << "  " << cluster.ids[j] << ": " << cluster.descriptions[j] << '\n';
+							}
+						}
+						std::cout << '\n';
+						break;
+					}
 					}
 				}
 				break;
@@ -576,8 +992,9 @@ int main(){
 				std::cout << "Would you like to add a new customer or new address to the database?\n"
 					"1: Customer\n"
 					"2: Address\n"
+					"3: Import customers or addresses from a CSV file\n"
 					"0: Exit\n";
-				int addDataSelection{ getIntBetween(0,2) };
+				int addDataSelection{ getIntBetween(0,3) };
 
 				//A note on the code. I'm aware that some might consider it best practice to switch-case over our user selection rather than use an if-else block.
 				//Ordinarily I would do this, however we are already inside a switch-case block and I figure nesting switch-cases would cause more problems for readability than it would solve.
@@ -592,12 +1009,13 @@ int main(){
 						while (true) {
 							std::cout << "Please enter a unique customer short name, which can be used as an identifier. Typical format: John Smith -> JSMITH \n";
 							std::getline(std::cin >> std::ws, insertShortName);
+							normaliseShortName(insertShortName);
 
+							//Uniqueness is checked on the normalised form without regard to case, the same way the Customers_Short_Name_NoCase index enforces it.
+							std::string existingName{ resolveShortName(db, insertShortName) };
 
-							int shortNameCount{ selectCount(db,"Customer_Short_Name","Customers","Customer_Short_Name",insertShortName) };
-
-							if (shortNameCount == 0)break;
-							else std::cout << "Error: Short name already in table. Please use new name or amend existing record.\n \n";
+							if (existingName.empty())break;
+							else std::cout << "Error: Short name already in table as " << existingName << ". Please use new name or amend existing record.\n \n";
 
 						}
 					}
@@ -613,10 +1031,8 @@ int main(){
 					// Input should be fairly foolproof, and errors should only come up from non-user issues.
 					// 
 					try {
-						executeStatement("BEGIN TRANSACTION", db, false);
-
 						//First we prep our statement. String stored separately for easier reading.
-						std::string insertStatement{ "INSERT INTO Customers(Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES (?,?,?,?,?,?,DATE('now'),DATE('now'));" };
+						std::string insertStatement{ "INSERT INTO Customers(Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) VALUES (?,?,?,?,?,?,CAST(strftime('%s','now') AS INTEGER),CAST(strftime('%s','now') AS INTEGER));" };
 						auto prepStatus = sqlite3_prepare_v2(db, insertStatement.c_str(), -1, &preparedStatement, NULL);
 						if (prepStatus != SQLITE_OK)throw std::runtime_error{ "Error preparing INSERT statement:"s + sqlite3_errmsg(db) };
 
@@ -650,33 +1066,36 @@ int main(){
 						if (bindStatus != SQLITE_OK)throw std::runtime_error{ "Error binding outstanding balance to statement: "s + sqlite3_errmsg(db) };
 
 
-						//We can now try to evaluate the prepared statement.
+						//We can now try to evaluate the prepared statement. The transaction only starts here, once we have everything, as it holds the
+						//write lock - nobody else could write while we waited for the user to type.
+						beginWrite(db, writePriority);
 						auto stepStatus = sqlite3_step(preparedStatement);
 						if (stepStatus == SQLITE_DONE)std::cout << "Record added successfully.\n \n";
 						else throw std::runtime_error{ "Error executing statement:"s + sqlite3_errmsg(db) };
 
 						executeStatement("COMMIT TRANSACTION", db, false);
+						shortNames.insert(insertShortName);	//Only once the customer is definitely in the database.
 					}
 					catch (std::exception& e) {
-						executeStatement("ROLLBACK TRANSACTION", db, false);
+						//The error may have come before the transaction began, so there may be nothing to roll back.
+						if (!sqlite3_get_autocommit(db)) executeStatement("ROLLBACK TRANSACTION", db, false);
 						std::cerr << "An error occurred: " << e.what() << '\n' << "The new customer was NOT added.\n";
 					}
 					//Whatever happens, we should destruct our statement object.
 					sqlite3_finalize(preparedStatement);
 
 				}
-				else {
+				else if (addDataSelection == 2) {
 					std::cout << "To add a new address, the corresponding customer must first be specified. Please enter the Customer's Short Name identifier:\n";
 
 					std::cout << "Please enter Customer Short Name:\n";
-					std::string inputShortName{ getShortName(db) };
+					std::string inputShortName{ getShortName(db, shortNames) };
 
 					try {
-						executeStatement("BEGIN TRANSCATION", db, false);
 						//So we set up our INSERT statement.
 						//As with inserting new customers, the cleanest approach is nested if-else statements which effectively stop all execution if a single operation fails.
 						//I have made the decision to forgo that for the sake of easy-to-read code, particularly during the writing/debugging stage.
-						std::string insertStatement{ "INSERT INTO CustomerAddress(Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES ((SELECT Customer_ID FROM Customers WHERE Customer_Short_Name = ?),?,?,?,?,?,?,?,DATE('now'),DATE('now'));" };
+						std::string insertStatement{ "INSERT INTO CustomerAddress(Customer_ID, Address_Type, Contact_Name, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5, Created_On, Updated_On) VALUES ((SELECT Customer_ID FROM Customers WHERE Customer_Short_Name = ?),?,?,?,?,?,?,?,CAST(strftime('%s','now') AS INTEGER),CAST(strftime('%s','now') AS INTEGER));" };
 						auto prepStatus = sqlite3_prepare_v2(db, insertStatement.c_str(), -1, &preparedStatement, NULL);
 						if (prepStatus != SQLITE_OK)throw std::runtime_error{ "Error preparing statement: "s + sqlite3_errmsg(db) };
 
@@ -716,14 +1135,15 @@ int main(){
 						std::cout << "Please enter the fifth line of the new address:\nLeave blank for NULL.\n";
 						bindValueOrNull(db, preparedStatement, 8, "Address Line 5");
 
-						//Execute the statement.
+						//Execute the statement, taking the write lock only now that the user has finished typing, as with adding customers.
+						beginWrite(db, writePriority);
 						auto stepStatus = sqlite3_step(preparedStatement);
 						if (stepStatus == SQLITE_DONE)std::cout << "Record added successfully.\n";
 						else throw std::runtime_error{ "Error adding record: "s + sqlite3_errmsg(db) };
-						executeStatement("COMMIT TRANSCATION", db, false);
+						executeStatement("COMMIT TRANSACTION", db, false);
 					}
 					catch (std::exception& e) {
-						executeStatement("ROLLBACK TRANSCATION", db, false);
+						if (!sqlite3_get_autocommit(db)) executeStatement("ROLLBACK TRANSACTION", db, false);
 						std::cerr << "An error occurred: " << e.what() << '\n' << "The new address was NOT added\n";
 					}
 
@@ -731,6 +1151,50 @@ int main(){
 					sqlite3_finalize(preparedStatement);
 
 				}
+				else {
+					std::cout << "Would you like to import customers or addresses?\n"
+						"1: Customers\n"
+						"2: Addresses\n";
+					BulkLoadKind importKind{ getIntBetween(1,2) == 1 ? BulkLoadKind::Customers : BulkLoadKind::Addresses };
+
+					std::cout << "Please enter the path of the file to import. The first line must name the columns. Files ending .tsv are read as tab separated:\n";
+					std::getline(std::cin >> std::ws, inputLine);
+					trimWhiteSpace(inputLine);
+
+					BulkLoadOptions importOptions;
+					if (inputLine.size() >= 4 && inputLine.compare(inputLine.size() - 4, 4, ".tsv") == 0) importOptions.delimiter = '\t';
+
+					std::cout << "Is this a very large file? If so, the indexes will be dropped while it loads and rebuilt afterwards, which is much faster for big imports "
+						"but needs enough disk space for a second copy of the database. [y/n]\n";
+					importOptions.rebuildIndexes = getYesNo();
+					//A batch job commits as it goes, so as not to hold everyone else up. Rebuild mode loads into a copy of its own, so doesn't need to.
+					const bool chunkedImport{ startupOptions.batch && !importOptions.rebuildIndexes };
+					if (chunkedImport) importOptions.transactionLimits = startupOptions.batchLimits;
+					//Maintenance writing to the database would make a rebuild-mode load give up at the end, so we keep it at bay while the load runs.
+					importOptions.onProgress = [&maintenance] { maintenance.noteActivity(); };
+
+					try {
+						auto imported{ bulkLoad(db, inputLine, importKind, importOptions) };
+						std::cout << "Imported " << imported.rowsInserted << " of " << imported.rowsRead << " rows in " << imported.seconds << " seconds, using "
+							<< imported.workerThreads << " parsing threads.\n";
+						if (imported.transactions > 1) std::cout << "The rows were committed in " << imported.transactions << " transactions, with "
+							<< imported.secondsYielded << " seconds between them spent letting other writers go first.\n";
+
+						//We don't want to flood the console if a whole file was wrong, so only the first few rejections are shown.
+						constexpr std::size_t maxRejectionsShown{ 20 };
+						for (std::size_t i = 0; i < imported.rejections.size() && i < maxRejectionsShown; ++i) {
+							std::cout << "Line " << imported.rejections[i].line << " was not imported: " << imported.rejections[i].reason << '\n';
+						}
+						if (imported.rejections.size() > maxRejectionsShown) std::cout << "...and " << imported.rejections.size() - maxRejectionsShown << " more.\n";
+
+						if (importKind == BulkLoadKind::Customers && imported.rowsInserted > 0) shortNames.reset();
+						if (importOptions.rebuildIndexes) customerCache.reset();		//The database was replaced behind the update hook's back.
+					}
+					catch (std::exception& e) {
+						std::cerr << "An error occurred: " << e.what() << '\n' << (chunkedImport ? "Rows after the last commit were not imported.\n" : "Nothing was imported.\n");
+					}
+					std::cout << '\n';
+				}
 
 			}
 			break;
@@ -751,7 +1215,7 @@ int main(){
 
 				//Whether updating a customer or an address, we need to know which customer's data we are updating. To prevent repeating ourselves, we put the code up here.
 				std::cout << "Please enter the Short Name identifier of the customer you would like to update:\n";
-				std::string updateShortName{ getShortName(db) };
+				std::string updateShortName{ getShortName(db, shortNames) };
 
 				//Next, we want to show the data for that customer. But we don't want to run a non-prepared select statement for a user entered value.
 				//Instead we swap the short name out for the customer ID. As this value is never entered by the user (and is an integer), we can safely use it for non-prepared statements.
@@ -777,7 +1241,7 @@ int main(){
 					switch (updateSelection) {
 					case 1: {						//-------UPDATE NAME------//
 						try {
-							updateStatement = "UPDATE Customers SET First_Name = ?,Last_Name = ?, Group_Name = ?, Updated_On = DATE('now') WHERE Customer_ID = ?;";
+							updateStatement = "UPDATE Customers SET First_Name = ?,Last_Name = ?, Group_Name = ?, Updated_On = CAST(strftime('%s','now') AS INTEGER) WHERE Customer_ID = ?;";
 							//Prepare our statement
 							auto prepStatus = sqlite3_prepare_v2(db, updateStatement.c_str(), -1, &preparedStatement, NULL);
 							if (prepStatus != SQLITE_OK)throw std::runtime_error{ "Error preparing update statement: "s + sqlite3_errmsg(db) };
@@ -796,14 +1260,16 @@ int main(){
 							auto bindStatus = sqlite3_bind_int(preparedStatement, 4, customerID);
 							if (bindStatus != SQLITE_OK)throw std::runtime_error{ "Error binding customer ID to statement: "s + sqlite3_errmsg(db) };
 
-							//Now we have our bindings, we execute the statement.
+							//Now we have our bindings, we execute the statement. As with adding a customer, the transaction only starts once we have
+							//everything, so the write lock isn't held while the user types.
+							beginWrite(db, writePriority);
 							auto stepStatus = sqlite3_step(preparedStatement);
 							if (stepStatus != SQLITE_DONE)throw std::runtime_error{ "Error executing UPDATE statement: "s + sqlite3_errmsg(db) };	//As this is an insert of one line, we expect a result of SQLITE_OK
-							else {
-								std::cout << "Record updated successfully.\n";
-							}
+							executeStatement("COMMIT TRANSACTION", db, false);
+							std::cout << "Record updated successfully.\n";
 						}
 						catch (std::exception& e) {
+							if (!sqlite3_get_autocommit(db)) executeStatement("ROLLBACK TRANSACTION", db, false);
 							std::cout << "An error occurred: " << e.what() << '\n';
 						}
 
@@ -815,7 +1281,7 @@ int main(){
 
 					case 2: {					//---------UPDATE CREDIT--------//
 						try {
-							updateStatement = "UPDATE Customers SET Credit_Limit = ?, Outstanding_Credit = ?,Updated_On = DATE('now') WHERE Customer_ID = ?;";
+							updateStatement = "UPDATE Customers SET Credit_Limit = ?, Outstanding_Credit = ?,Updated_On = CAST(strftime('%s','now') AS INTEGER) WHERE Customer_ID = ?;";
 							//Prepare our statement
 							auto prepStatus = sqlite3_prepare_v2(db, updateStatement.c_str(), -1, &preparedStatement, NULL);
 							if (prepStatus != SQLITE_OK)throw std::runtime_error{ "Error preparing update statement: "s + sqlite3_errmsg(db) };
@@ -835,13 +1301,14 @@ int main(){
 							if (bindStatus != SQLITE_OK)throw std::runtime_error{ "Error binding customer ID to INSERT statement: "s + sqlite3_errmsg(db) };
 
 							//Execute our statement
+							beginWrite(db, writePriority);
 							auto stepStatus = sqlite3_step(preparedStatement);
 							if (stepStatus != SQLITE_DONE)throw std::runtime_error{ "Error executing UPDATE statement: "s + sqlite3_errmsg(db) };	//As this is an insert of one line, we expect a result of SQLITE_OK
-							else {
-								std::cout << "Record updated successfully.\n";
-							}
+							executeStatement("COMMIT TRANSACTION", db, false);
+							std::cout << "Record updated successfully.\n";
 						}
 						catch (std::exception& e) {
+							if (!sqlite3_get_autocommit(db)) executeStatement("ROLLBACK TRANSACTION", db, false);
 							std::cout << "An error occurred: " << e.what() << '\n';
 						}
 
@@ -867,7 +1334,7 @@ int main(){
 						//Then proceed as planned
 						else {
 							try {
-								std::string updateStatement{ "UPDATE CustomerAddress SET Address_Type = ?,Contact_Name = ?,Address_Line_1 = ?,Address_Line_2 = ?,Address_Line_3 = ?, Address_Line_4 = ?,Address_Line_5 = ?,Updated_On = DATE('now') WHERE Address_ID = ?;" };
+								std::string updateStatement{ "UPDATE CustomerAddress SET Address_Type = ?,Contact_Name = ?,Address_Line_1 = ?,Address_Line_2 = ?,Address_Line_3 = ?, Address_Line_4 = ?,Address_Line_5 = ?,Updated_On = CAST(strftime('%s','now') AS INTEGER) WHERE Address_ID = ?;" };
 								auto prepStatus = sqlite3_prepare_v2(db, updateStatement.c_str(), -1, &preparedStatement, NULL);
 								if (prepStatus != SQLITE_OK)throw std::runtime_error{ "Error preparing UPDATE statement: "s + sqlite3_errmsg(db) };
 
@@ -901,11 +1368,14 @@ int main(){
 								if (bindStatus != SQLITE_OK)throw std::runtime_error{ "Error binding address ID to statement:"s + sqlite3_errmsg(db) };
 
 								//Now we've bound our values, we need to execute our statement
+								beginWrite(db, writePriority);
 								auto stepStatus = sqlite3_step(preparedStatement);
 								if (stepStatus != SQLITE_DONE)throw std::runtime_error{ "Error executing UPDATE statement: "s + sqlite3_errmsg(db) };
-								else std::cout << "Address updated successfully.\n \n";
+								executeStatement("COMMIT TRANSACTION", db, false);
+								std::cout << "Address updated successfully.\n \n";
 							}
 							catch (std::exception& e) {
+								if (!sqlite3_get_autocommit(db)) executeStatement("ROLLBACK TRANSACTION", db, false);
 								std::cout << "An error occurrred: " << e.what() << '\n';
 							}
 
@@ -935,7 +1405,7 @@ int main(){
 				
 				//In either case we need to know which customer we are dealing with.
 				std::cout << "Please enter the short name identifier of the customer:\n";
-				std::string deleteShortName{ getShortName(db) };
+				std::string deleteShortName{ getShortName(db, shortNames) };
 
 				
 				//Since the customer_ID is shared between both tables, we grab that now.
@@ -953,7 +1423,7 @@ int main(){
 						bool proceedWithDelete{ getYesNo() };
 						if (proceedWithDelete) {
 							try {
-								executeStatement("BEGIN TRANSACTION", db, false);
+								beginWrite(db, writePriority);
 								//First we delete from the address table.
 								std::string deleteAddress{ "DELETE FROM CustomerAddress WHERE Customer_ID = ?;" };
 								auto prepStatus = sqlite3_prepare_v2(db, deleteAddress.c_str(), -1, &preparedStatement, NULL);
@@ -985,9 +1455,10 @@ int main(){
 								if (stepStatus != SQLITE_DONE)throw std::runtime_error{ "Error executing DELETE statement: "s + sqlite3_errmsg(db) };
 								else std::cout << "Customer data for " << deleteShortName << " deleted successfully.\n";								
 								executeStatement("COMMIT TRANSACTION", db, false);
+								shortNames.erase(deleteShortName);
 							}
 							catch (std::exception& e) {
-								executeStatement("ROLLBACK TRANSACTION", db, false);
+								if (!sqlite3_get_autocommit(db)) executeStatement("ROLLBACK TRANSACTION", db, false);
 								std::cout << "An error occurred: " << e.what() << "\nThe data was NOT deleted\n";
 							}
 							//Whether the above statement executed properly or not, we want to finalise and destruct its DB connection.
@@ -1017,12 +1488,15 @@ int main(){
 									auto bindStatus = sqlite3_bind_int(preparedStatement, 1, addressID);
 									if (bindStatus != SQLITE_OK)throw std::runtime_error{ "Error binding Customer ID to statement: "s + sqlite3_errmsg(db) };
 									//Execute the statement
+									beginWrite(db, writePriority);
 									auto stepStatus = sqlite3_step(preparedStatement);
 									if (stepStatus != SQLITE_DONE)throw std::runtime_error{ "Error executing DELETE statement: "s + sqlite3_errmsg(db) };
-									else std::cout << "Address " << addressID << " deleted successfully.\n";								
+									executeStatement("COMMIT TRANSACTION", db, false);
+									std::cout << "Address " << addressID << " deleted successfully.\n";
 									
 								}
 								catch (std::exception& e) {
+									if (!sqlite3_get_autocommit(db)) executeStatement("ROLLBACK TRANSACTION", db, false);
 									std::cout << "An error occurred: " << e.what() << '\n';
 								}
 								//Whether the above statement executed properly or not, we want to finalise and destruct its DB connection.
@@ -1045,7 +1519,8 @@ int main(){
 			//Here we allow the user to enter as many custom SQL statements as they like. These statements can be destructive to the database.
 			//I realise that in a real-world example of business code we would not want to do this under any circumstances as it is a huge, gaping security flaw.
 			//But this is a personal project, and I want to keep that option in for my own debugging if nothing else.
-			std::cout << "Enter custom SQL statement: \nWarning: This statement will be executed regardless of how destructive to the database it may be. \nRun command EXIT to exit.\n";
+			std::cout << "Enter custom SQL statement: \nWarning: This statement will be executed regardless of how destructive to the database it may be. \nRun command EXIT to exit.\n"
+				"Tip: Query CachedCustomers in place of Customers to read customers from memory rather than disk.\n";
 			while (true) {				
 				std::string inputStatement{};
 				std::getline(std::cin >> std::ws, inputStatement);
@@ -1054,8 +1529,103 @@ int main(){
 
 
 				std::cout << "Executing statement " << inputStatement << '\n';
-				executeStatement(inputStatement, db);
-				
+				int changesBefore{ sqlite3_total_changes(db) };
+				try {
+					executeStatement(inputStatement, db);
+				}
+				catch (std::exception&) {		//executeStatement has already shown the error, e.g. from trying to write to a read-only database.
+					std::cout << '\n';
+					continue;
+				}
+
+				//Custom SQL can add, rename or remove customers without us knowing which, so if it changed anything we rebuild the short name index.
+				if (sqlite3_total_changes(db) != changesBefore) shortNames.reset();
+			}
+			break;
+
+
+		case 6:				//-------REPORTS AND DIAGNOSTICS-------//
+			while (true) {
+				std::cout << "Please select report:\n"
+					"1. Customers with outstanding credit, by utilisation.\n"
+					"2. Credit totals by customer group.\n"
+					"3. Query plans for the built-in queries.\n"
+					"4. Export changes since a given date.\n"
+					"5. Background maintenance status.\n"
+					"6. Storage used by each table and index.\n"
+					"7. SQLite memory and cache statistics for each connection.\n"
+					"8. " << (statusLogger.running() ? "Stop logging statistics to " + statusLogger.path() : std::string{ "Start logging statistics to a file" }) << ".\n"
+					"0. Exit\n";
+				int userSelection{ getIntBetween(0,8) };
+				if (userSelection == 0)break;
+
+				try {
+					switch (userSelection) {
+					case 1:
+						printCreditRiskReport(db);
+						break;
+					case 2:
+						printGroupCreditReport(db);
+						break;
+					case 3:
+						printQueryPlanReport(db);
+						break;
+					case 4: {
+						std::cout << "Please enter the date to export changes from, as YYYY-MM-DD or YYYY-MM-DD HH:MM (UTC):\n";
+						std::getline(std::cin >> std::ws, inputLine);
+						trimWhiteSpace(inputLine);
+						std::optional<sqlite3_int64> since{ parseTimestamp(db, inputLine) };
+						if (!since) {
+							std::cout << "Sorry, that isn't a date I recognise.\n";
+							break;
+						}
+
+						std::cout << "Please enter a name for the export. Changed customers and addresses will be written to <name>_Customers.csv and <name>_Addresses.csv:\n";
+						std::string exportName;
+						std::getline(std::cin >> std::ws, exportName);
+						trimWhiteSpace(exportName);
+						std::ofstream customersFile{ exportName + "_Customers.csv" };
+						std::ofstream addressesFile{ exportName + "_Addresses.csv" };
+						if (!customersFile || !addressesFile) throw std::runtime_error{ "Could not create the export files for " + exportName };
+
+						auto exported{ exportChangesSince(db, *since, customersFile, addressesFile) };
+						std::cout << "Exported " << exported.customers << " customers and " << exported.addresses << " addresses changed since " << formatTimestamp(*since) << ".\n";
+						break;
+					}
+					case 5:
+						printMaintenanceReport(db, maintenance);
+						break;
+					case 6:
+						printStorageReport(db);
+						break;
+					case 7:
+						printSqliteStatus(std::cout);
+						break;
+					case 8: {
+						if (statusLogger.running()) {
+							statusLogger.stop();
+							std::cout << "Stopped logging statistics.\n";
+							break;
+						}
+						if (singleThreaded) {
+							std::cout << "Sorry, the statistics can't be logged in the background while SQLite is running single-threaded.\n";
+							break;
+						}
+						std::cout << "Please enter the file to append the statistics to:\n";
+						std::string logPath;
+						std::getline(std::cin >> std::ws, logPath);
+						trimWhiteSpace(logPath);
+						std::cout << "And how often to log them, in seconds (1-3600):\n";
+						statusLogger.start(logPath, std::chrono::seconds{ getIntBetween(1,3600) });
+						std::cout << "Logging statistics to " << logPath << ".\n";
+						break;
+					}
+					}
+				}
+				catch (std::exception& e) {
+					std::cerr << "An error occurred: " << e.what() << '\n';
+				}
+				std::cout << '\n';
 			}
 			break;
 		}
@@ -1066,6 +1636,20 @@ int main(){
 
 
 	//And now that we have done what we set out to do, we need to close our DB connection before exiting.
+	//The status log gets its last entry while the connection is still open to report on.
+	statusLogger.stop();
+	if (startupOptions.inMemory) {
+		try {
+			const std::size_t savesBefore{ memorySaver.stats().saves };
+			memorySaver.stop();
+			if (memorySaver.stats().saves > savesBefore) std::cout << "Saved the in-memory database to Customers.db.\n";
+			else std::cout << "Nothing has changed since the in-memory database was last saved.\n";
+		}
+		catch (std::exception& e) {
+			std::cerr << "Error saving the in-memory database: " << e.what() << "\nChanges made since the last save have been lost.\n";
+		}
+	}
+	unregisterConnection(db);
 	auto closeStatus = sqlite3_close(db);
 	if (closeStatus!=SQLITE_OK) {
 		std::cerr << "Error closing DB: " << sqlite3_errmsg(db) << '\n';
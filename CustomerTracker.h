@@ -0,0 +1,27 @@
+#pragma once
+
+//This header exposes the general-purpose helpers defined in CustomerTracker.cpp so that the other source files in the project can make use of them.
+//For documentation on each function, see its definition.
+
+//Standard library includes
+#include <string>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+std::string displayValue(const char* inColumnName, const char* inValue);
+int callback(void* NotUsed, int argc, char** argv, char** azColName);
+void executeStatement(const std::string& inStmt, sqlite3* inDB, bool showMessages = true);
+
+int getInt();
+int getIntBetween(int inMin, int inMax);
+bool getYesNo();
+
+void trimWhiteSpace(std::string& inString);
+void normaliseShortName(std::string& inString);
+
+int selectCount(sqlite3* db, const std::string& colName, const std::string& tableName);
+int selectCount(sqlite3* db, const std::string& colName, const std::string& tableName, const std::string& conditionColName, const std::string& conditionValue);
+
+std::string resolveShortName(sqlite3* db, const std::string& inShortName);
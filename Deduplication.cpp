@@ -0,0 +1,280 @@
+//Standard library includes
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+//Project includes
+#include "Deduplication.h"
+#include "PreparedStatement.h"
+#include "NameSearch.h"
+#include "SqlFunctions.h"
+#include "Postcodes.h"
+
+namespace {
+
+	//Blocks with more records than this are skipped rather than compared pairwise, so one pathological key can't make the job quadratic again.
+	constexpr std::size_t maxBlockSize{ 50 };
+
+
+	struct CustomerRecord {
+		int customerID;
+		std::string shortName;
+		std::string firstName;	//Normalised by normaliseWords().
+		std::string lastName;	//Normalised by normaliseWords().
+		std::vector<std::size_t> addresses;	//Indices into the address records.
+	};
+
+	struct AddressRecord {
+		int addressID;
+		std::size_t customer;	//Index into the customer records.
+		std::string postcode;
+		std::string lines;		//All five lines, normalised by normaliseWords() and joined.
+	};
+
+
+	//Upper-cases a string and reduces it to its letters and digits, with a single space between words. e.g. " 1, Regent  Road" -> "1 REGENT ROAD"
+	std::string normaliseWords(const std::string& inText) {
+		std::string normalised;
+		bool pendingSpace{ false };
+		for (char c : inText) {
+			if (std::isalnum(static_cast<unsigned char>(c))) {
+				if (pendingSpace && !normalised.empty()) normalised += ' ';
+				pendingSpace = false;
+				normalised += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+			}
+			else pendingSpace = true;
+		}
+		return normalised;
+	}
+
+
+	//A minimal union-find, used to merge matched pairs into clusters.
+	class DisjointSets {
+	public:
+		explicit DisjointSets(std::size_t size) : m_parents(size) {
+			std::iota(m_parents.begin(), m_parents.end(), std::size_t{ 0 });
+		}
+		std::size_t find(std::size_t element) {
+			while (m_parents[element] != element) {
+				m_parents[element] = m_parents[m_parents[element]];	//Path halving, to keep the trees flat.
+				element = m_parents[element];
+			}
+			return element;
+		}
+		void merge(std::size_t lhs, std::size_t rhs) { m_parents[find(lhs)] = find(rhs); }
+	private:
+		std::vector<std::size_t> m_parents;
+	};
+
+
+	//A pair of records we believe to be duplicates.
+	struct MatchedPair {
+		std::size_t first;
+		std::size_t second;
+		double score;
+		std::string reason;
+	};
+
+
+	//How alike two first names are. An exact match scores 1, sounding alike 0.8, and an initial against a name which starts with it 0.6.
+	//Otherwise we fall back on the trigram similarity, which catches typos.
+	double firstNameScore(const std::string& lhs, const std::string& rhs) {
+		if (lhs.empty() || rhs.empty()) return 0.0;
+		if (lhs == rhs) return 1.0;
+		if (phoneticKey(lhs) == phoneticKey(rhs)) return 0.8;
+		if ((lhs.size() == 1 || rhs.size() == 1) && lhs[0] == rhs[0]) return 0.6;
+		return nameSimilarity(lhs, rhs);
+	}
+
+
+	//Scores two customers who share a blocking key. Sharing a surname is a given by this point, so the first name and address decide it.
+	MatchedPair compareCustomers(const std::vector<CustomerRecord>& customers, const std::vector<AddressRecord>& addresses, std::size_t first, std::size_t second) {
+		const CustomerRecord& lhs{ customers[first] };
+		const CustomerRecord& rhs{ customers[second] };
+
+		double nameScore{ firstNameScore(lhs.firstName, rhs.firstName) };
+		bool sharedAddress{ false };
+		bool sharedPostcode{ false };
+		for (std::size_t lhsAddress : lhs.addresses) {
+			for (std::size_t rhsAddress : rhs.addresses) {
+				if (addresses[lhsAddress].lines == addresses[rhsAddress].lines) sharedAddress = true;
+				if (!addresses[lhsAddress].postcode.empty() && addresses[lhsAddress].postcode == addresses[rhsAddress].postcode) sharedPostcode = true;
+			}
+		}
+
+		double score{ 0.5 * nameScore + 0.3 + (sharedAddress ? 0.2 : (sharedPostcode ? 0.15 : 0.0)) };
+		std::string reason{ "same surname" };
+		if (nameScore == 1.0) reason = "same name";
+		else if (nameScore > 0.0) reason += ", similar first name";
+		if (sharedAddress) reason += ", same address";
+		else if (sharedPostcode) reason += ", same postcode";
+		return { first, second, score, std::move(reason) };
+	}
+
+
+	//Loads every customer, normalising their names as we go.
+	std::vector<CustomerRecord> loadCustomers(sqlite3* db, std::unordered_map<int, std::size_t>& outIndexByID) {
+		std::vector<CustomerRecord> customers;
+		PreparedStatement selectCustomers{ db, "SELECT Customer_ID, Customer_Short_Name, First_Name, Last_Name FROM Customers;" };
+		while (selectCustomers.stepRow()) {
+			int customerID{ sqlite3_column_int(selectCustomers.get(), 0) };
+			outIndexByID.emplace(customerID, customers.size());
+			customers.push_back({ customerID, selectCustomers.columnText(1), normaliseWords(selectCustomers.columnText(2)), normaliseWords(selectCustomers.columnText(3)), {} });
+		}
+		return customers;
+	}
+
+
+	//Loads every address, and links each one to its customer.
+	std::vector<AddressRecord> loadAddresses(sqlite3* db, std::vector<CustomerRecord>& customers, const std::unordered_map<int, std::size_t>& customerIndexByID) {
+		std::vector<AddressRecord> addresses;
+		PreparedStatement selectAddresses{ db, "SELECT Address_ID, Customer_ID, Postcode, Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5 FROM CustomerAddress;" };
+		while (selectAddresses.stepRow()) {
+			auto customer{ customerIndexByID.find(sqlite3_column_int(selectAddresses.get(), 1)) };
+			if (customer == customerIndexByID.end()) continue;		//An orphaned address can't be a duplicate of anything we care about.
+
+			std::string lines;
+			for (int column = 3; column <= 7; ++column) {
+				std::string line{ normaliseWords(selectAddresses.columnText(column)) };
+				if (!line.empty()) lines += (lines.empty() ? "" : "|") + line;
+			}
+			customers[customer->second].addresses.push_back(addresses.size());
+			addresses.push_back({ sqlite3_column_int(selectAddresses.get(), 0), customer->second, selectAddresses.columnText(2), std::move(lines) });
+		}
+		return addresses;
+	}
+
+
+	//Merges the matched pairs into clusters, and turns each cluster into a DuplicateCluster for the report.
+	template <typename DescribeFunction>
+	void addClusters(DeduplicationReport& report, DuplicateCluster::Kind kind, std::size_t recordCount, const std::vector<MatchedPair>& pairs, DescribeFunction describe) {
+		DisjointSets sets{ recordCount };
+		for (const auto& pair : pairs) sets.merge(pair.first, pair.second);
+
+		//Gather up the members of each cluster, along with its strongest pair.
+		std::unordered_map<std::size_t, std::vector<std::size_t>> members;
+		std::unordered_map<std::size_t, const MatchedPair*> strongestPair;
+		for (const auto& pair : pairs) {
+			std::size_t root{ sets.find(pair.first) };
+			auto& strongest{ strongestPair[root] };
+			if (!strongest || pair.score > strongest->score) strongest = &pair;
+		}
+		for (const auto& [root, pair] : strongestPair) members[root];
+		for (std::size_t record = 0; record < recordCount; ++record) {
+			auto cluster{ members.find(sets.find(record)) };
+			if (cluster != members.end()) cluster->second.push_back(record);
+		}
+
+		for (auto& [root, records] : members) {
+			DuplicateCluster cluster{ kind, {}, {}, strongestPair[root]->score, strongestPair[root]->reason };
+			for (std::size_t record : records) {
+				auto [id, description] { describe(record) };
+				cluster.ids.push_back(id);
+				cluster.descriptions.push_back(std::move(description));
+			}
+			report.clusters.push_back(std::move(cluster));
+		}
+	}
+
+}
+
+
+DeduplicationReport findDuplicates(sqlite3* db, double minimumScore) {
+	DeduplicationReport report;
+	backfillPostcodes(db);			//Addresses are blocked by postcode, so any not yet extracted would never be compared.
+
+	//Read everything in with one pass over each table.
+	std::unordered_map<int, std::size_t> customerIndexByID;
+	std::vector<CustomerRecord> customers{ loadCustomers(db, customerIndexByID) };
+	std::vector<AddressRecord> addresses{ loadAddresses(db, customers, customerIndexByID) };
+	report.customersScanned = customers.size();
+	report.addressesScanned = addresses.size();
+
+
+	//----CUSTOMERS----//
+	//A customer goes in one block for their full name, and one for their surname at each postcode they have an address in.
+	//So two John Smiths are always compared, as are a J Smith and a Jon Smith at the same postcode, but the Smiths of the rest of the country are not.
+	std::unordered_map<std::string, std::vector<std::size_t>> customerBlocks;
+	for (std::size_t i = 0; i < customers.size(); ++i) {
+		const CustomerRecord& customer{ customers[i] };
+		if (customer.lastName.empty()) continue;
+		if (!customer.firstName.empty()) customerBlocks["N|" + customer.firstName + "|" + customer.lastName].push_back(i);
+
+		std::vector<std::string> postcodes;
+		for (std::size_t address : customer.addresses) {
+			const std::string& postcode{ addresses[address].postcode };
+			if (!postcode.empty() && std::find(postcodes.begin(), postcodes.end(), postcode) == postcodes.end()) postcodes.push_back(postcode);
+		}
+		for (const auto& postcode : postcodes) customerBlocks["P|" + customer.lastName + "|" + postcode].push_back(i);
+	}
+
+	//Two customers can share several blocks, so we remember which pairs we've already compared.
+	std::unordered_map<std::size_t, std::vector<std::size_t>> comparedCustomers;
+	std::vector<MatchedPair> customerPairs;
+	for (const auto& [key, block] : customerBlocks) {
+		if (block.size() > maxBlockSize) {
+			++report.oversizedBlocksSkipped;
+			continue;
+		}
+		for (std::size_t i = 0; i < block.size(); ++i) {
+			for (std::size_t j = i + 1; j < block.size(); ++j) {
+				auto& compared{ comparedCustomers[block[i]] };
+				if (std::find(compared.begin(), compared.end(), block[j]) != compared.end()) continue;
+				compared.push_back(block[j]);
+
+				++report.comparisonsMade;
+				MatchedPair pair{ compareCustomers(customers, addresses, block[i], block[j]) };
+				if (pair.score >= minimumScore) customerPairs.push_back(std::move(pair));
+			}
+		}
+	}
+
+
+	//----ADDRESSES----//
+	//Addresses are blocked on their customer and a hash of their normalised lines. An address only counts as a duplicate if it's entered twice
+	//for the same customer - different customers at one address (e.g. a family) are normal, and are picked up above if they look like the
+	//same person. Blocking on the lines alone would put everyone at a head office or depot in one block, which would be skipped as oversized
+	//along with any real duplicates in it.
+	std::map<std::pair<std::size_t, std::size_t>, std::vector<std::size_t>> addressBlocks;
+	for (std::size_t i = 0; i < addresses.size(); ++i) {
+		if (!addresses[i].lines.empty()) addressBlocks[{ addresses[i].customer, std::hash<std::string>{}(addresses[i].lines) }].push_back(i);
+	}
+
+	std::vector<MatchedPair> addressPairs;
+	for (const auto& [key, block] : addressBlocks) {
+		if (block.size() > maxBlockSize) {
+			++report.oversizedBlocksSkipped;
+			continue;
+		}
+		for (std::size_t i = 0; i < block.size(); ++i) {
+			for (std::size_t j = i + 1; j < block.size(); ++j) {
+				++report.comparisonsMade;
+				const AddressRecord& lhs{ addresses[block[i]] };
+				const AddressRecord& rhs{ addresses[block[j]] };
+				//The hashes matching doesn't guarantee the lines do, so check the real thing.
+				if (lhs.lines == rhs.lines) addressPairs.push_back({ block[i], block[j], 1.0, "same address entered twice" });
+			}
+		}
+	}
+
+
+	addClusters(report, DuplicateCluster::Kind::Customer, customers.size(), customerPairs, [&customers](std::size_t record) {
+		const CustomerRecord& customer{ customers[record] };
+		return std::pair{ customer.customerID, customer.shortName + " (" + customer.firstName + " " + customer.lastName + ")" };
+	});
+	addClusters(report, DuplicateCluster::Kind::Address, addresses.size(), addressPairs, [&addresses, &customers](std::size_t record) {
+		const AddressRecord& address{ addresses[record] };
+		return std::pair{ address.addressID, customers[address.customer].shortName + ": " + address.lines };
+	});
+
+	//Rank the clusters so the most certain (and then the biggest) come first.
+	std::sort(report.clusters.begin(), report.clusters.end(), [](const DuplicateCluster& lhs, const DuplicateCluster& rhs) {
+		if (lhs.score != rhs.score) return lhs.score > rhs.score;
+		return lhs.ids.size() > rhs.ids.size();
+	});
+	return report;
+}
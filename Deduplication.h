@@ -0,0 +1,36 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <vector>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Finds customers and addresses which look like they have been entered more than once - the same person under two short names, or the
+//same address entered twice for one customer.
+//Comparing every record with every other would be O(n^2), which is hopeless with millions of rows. Instead, each record is given one or more
+//blocking keys (e.g. normalised surname + postcode, or the customer and a hash of their normalised address lines) in a single pass, and records are only compared
+//against others sharing a key. Blocks are small for real data, so the whole job runs in close to linear time.
+
+struct DuplicateCluster {
+	enum class Kind { Customer, Address };
+	Kind kind;
+	std::vector<int> ids;					//Customer_IDs or Address_IDs, depending on kind.
+	std::vector<std::string> descriptions;	//A short description of each record, in the same order as ids.
+	double score;							//How confident we are these are duplicates, between 0 and 1.
+	std::string reason;						//Why the records were matched, from the strongest pair in the cluster.
+};
+
+struct DeduplicationReport {
+	std::vector<DuplicateCluster> clusters;	//Most likely duplicates first.
+	std::size_t customersScanned{ 0 };
+	std::size_t addressesScanned{ 0 };
+	std::size_t comparisonsMade{ 0 };
+	std::size_t oversizedBlocksSkipped{ 0 };	//Blocks too big to compare pairwise, e.g. a very common surname at one postcode.
+};
+
+//Scans the whole database and returns the duplicate clusters found. Pairs scoring below minimumScore are not reported.
+DeduplicationReport findDuplicates(sqlite3* db, double minimumScore = 0.75);
@@ -0,0 +1,507 @@
+//Standard library includes
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+//Project includes
+#include "HttpServer.h"
+#include "StopSignals.h"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	const char* reasonPhrase(int status) {
+		switch (status) {
+		case 100: return "Continue";
+		case 200: return "OK";
+		case 201: return "Created";
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 409: return "Conflict";
+		case 411: return "Length Required";
+		case 413: return "Payload Too Large";
+		case 431: return "Request Header Fields Too Large";
+		case 500: return "Internal Server Error";
+		case 501: return "Not Implemented";
+		case 503: return "Service Unavailable";
+		default: return "Unknown";
+		}
+	}
+
+	HttpResponse errorResponse(int status, std::string_view inMessage) {
+		//The message is always one of ours, but it's escaped all the same in case one ever quotes the request back.
+		std::string body{ "{\"error\":\"" };
+		for (char c : inMessage) {
+			if (c == '"' || c == '\\') body += '\\';
+			if (static_cast<unsigned char>(c) >= 0x20) body += c;
+		}
+		body += "\"}";
+		return { status, std::move(body) };
+	}
+
+	std::string serialise(const HttpResponse& inResponse, bool keepAlive) {
+		std::string text{ "HTTP/1.1 " + std::to_string(inResponse.status) + ' ' + reasonPhrase(inResponse.status) + "\r\n"
+			"Content-Type: " + inResponse.contentType + "\r\n"
+			"Content-Length: " + std::to_string(inResponse.body.size()) + "\r\n" };
+		if (inResponse.status == 503) text += "Retry-After: 1\r\n";
+		text += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+		text += inResponse.body;
+		return text;
+	}
+
+	std::string lowerCase(std::string_view inText) {
+		std::string lower{ inText };
+		for (char& c : lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		return lower;
+	}
+
+	std::string_view trim(std::string_view inText) {
+		while (!inText.empty() && (inText.front() == ' ' || inText.front() == '\t')) inText.remove_prefix(1);
+		while (!inText.empty() && (inText.back() == ' ' || inText.back() == '\t')) inText.remove_suffix(1);
+		return inText;
+	}
+
+	//Decodes %XX escapes, and in query strings '+' as a space. Returns false for a malformed escape.
+	bool percentDecode(std::string_view inText, bool inQuery, std::string& out) {
+		out.clear();
+		for (std::size_t i = 0; i < inText.size(); ++i) {
+			if (inText[i] == '+' && inQuery) out += ' ';
+			else if (inText[i] != '%') out += inText[i];
+			else {
+				unsigned value{ 0 };
+				if (i + 2 >= inText.size()) return false;
+				auto [end, error] { std::from_chars(inText.data() + i + 1, inText.data() + i + 3, value, 16) };
+				if (error != std::errc{} || end != inText.data() + i + 3) return false;
+				out += static_cast<char>(value);
+				i += 2;
+			}
+		}
+		return true;
+	}
+
+	enum class ParseResult { Incomplete, Complete, Bad };
+
+	struct ParsedRequest {
+		HttpRequest request;
+		bool keepAlive{ true };
+		std::size_t length{ 0 };				//Bytes of input the request took up.
+		bool expectsContinue{ false };
+		int errorStatus{ 400 };
+		std::string error;
+	};
+
+	//Parses the request at the start of inInput, if it has all arrived. Bad requests say why in parsed.error, with the status to send back.
+	ParseResult parseRequest(std::string_view inInput, const HttpServerOptions& inOptions, ParsedRequest& parsed) {
+		auto bad{ [&](int status, std::string message) {
+			parsed.errorStatus = status;
+			parsed.error = std::move(message);
+			return ParseResult::Bad;
+		} };
+
+		const std::size_t headerEnd{ inInput.find("\r\n\r\n") };
+		if (headerEnd == std::string_view::npos) {
+			if (inInput.size() > inOptions.maxHeaderBytes) return bad(431, "The request headers are too long");
+			return ParseResult::Incomplete;
+		}
+		if (headerEnd > inOptions.maxHeaderBytes) return bad(431, "The request headers are too long");
+
+		std::string_view head{ inInput.substr(0, headerEnd) };
+		const std::size_t requestLineEnd{ std::min(head.find("\r\n"), head.size()) };
+		const std::string_view requestLine{ head.substr(0, requestLineEnd) };
+		const std::size_t firstSpace{ requestLine.find(' ') };
+		const std::size_t lastSpace{ requestLine.rfind(' ') };
+		if (firstSpace == std::string_view::npos || firstSpace == lastSpace) return bad(400, "Malformed request line");
+		const std::string_view version{ requestLine.substr(lastSpace + 1) };
+		if (version.substr(0, 7) != "HTTP/1.") return bad(400, "Unsupported HTTP version");
+
+		HttpRequest& request{ parsed.request };
+		request.method = std::string{ requestLine.substr(0, firstSpace) };
+		const std::string_view target{ requestLine.substr(firstSpace + 1, lastSpace - firstSpace - 1) };
+		const std::size_t questionMark{ target.find('?') };
+		if (!percentDecode(target.substr(0, questionMark), false, request.path)) return bad(400, "Malformed path");
+		if (questionMark != std::string_view::npos) {
+			std::string_view queryString{ target.substr(questionMark + 1) };
+			while (!queryString.empty()) {
+				const std::size_t ampersand{ std::min(queryString.find('&'), queryString.size()) };
+				const std::string_view pair{ queryString.substr(0, ampersand) };
+				const std::size_t equals{ std::min(pair.find('='), pair.size()) };
+				std::string name, value;
+				if (!percentDecode(pair.substr(0, equals), true, name) || !percentDecode(pair.substr(std::min(equals + 1, pair.size())), true, value)) return bad(400, "Malformed query string");
+				if (!name.empty()) request.query[std::move(name)] = std::move(value);
+				queryString.remove_prefix(std::min(ampersand + 1, queryString.size()));
+			}
+		}
+
+		std::string_view headerLines{ head.substr(std::min(requestLineEnd + 2, head.size())) };
+		while (!headerLines.empty()) {
+			const std::size_t lineEnd{ std::min(headerLines.find("\r\n"), headerLines.size()) };
+			const std::string_view line{ headerLines.substr(0, lineEnd) };
+			const std::size_t colon{ line.find(':') };
+			if (colon == std::string_view::npos) return bad(400, "Malformed header");
+			request.headers[lowerCase(trim(line.substr(0, colon)))] = std::string{ trim(line.substr(colon + 1)) };
+			headerLines.remove_prefix(std::min(lineEnd + 2, headerLines.size()));
+		}
+
+		if (request.headers.count("transfer-encoding")) return bad(411, "Chunked requests aren't supported. Please send a Content-Length");
+		std::size_t bodyLength{ 0 };
+		if (auto contentLength{ request.headers.find("content-length") }; contentLength != request.headers.end()) {
+			const std::string& text{ contentLength->second };
+			auto [end, error] { std::from_chars(text.data(), text.data() + text.size(), bodyLength) };
+			if (error != std::errc{} || end != text.data() + text.size()) return bad(400, "Malformed Content-Length");
+			if (bodyLength > inOptions.maxBodyBytes) return bad(413, "The request body is too big");
+		}
+
+		const std::string connection{ request.headers.count("connection") ? lowerCase(request.headers["connection"]) : "" };
+		parsed.keepAlive = version == "HTTP/1.0" ? connection == "keep-alive" : connection != "close";
+		parsed.expectsContinue = request.headers.count("expect") && lowerCase(request.headers["expect"]) == "100-continue";
+
+		const std::size_t bodyStart{ headerEnd + 4 };
+		if (inInput.size() < bodyStart + bodyLength) return ParseResult::Incomplete;
+		request.body = std::string{ inInput.substr(bodyStart, bodyLength) };
+		parsed.length = bodyStart + bodyLength;
+		return ParseResult::Complete;
+	}
+
+
+}
+
+
+HttpServer::HttpServer(HttpServerOptions inOptions, Classifier inClassifier, Handler inHandler)
+	: m_options{ std::move(inOptions) }, m_classifier{ std::move(inClassifier) }, m_handler{ std::move(inHandler) }, m_admission{ m_options.admission } {}
+
+
+HttpServer::Stats HttpServer::stats() const {
+	std::lock_guard lock{ m_statsMutex };
+	return m_stats;
+}
+
+
+#ifndef __linux__
+
+HttpServer::~HttpServer() {}
+void HttpServer::listen() { throw std::runtime_error{ "The HTTP server is only available on Linux" }; }
+void HttpServer::run() { throw std::runtime_error{ "The HTTP server is only available on Linux" }; }
+void HttpServer::stop() {}
+
+#else
+
+HttpServer::~HttpServer() {
+	m_admission.stop();
+	for (auto& [fd, connection] : m_connections) ::close(fd);
+	if (m_listenFd >= 0) ::close(m_listenFd);
+	if (m_wakeFd >= 0) ::close(m_wakeFd);
+	if (m_epollFd >= 0) ::close(m_epollFd);
+}
+
+
+void HttpServer::listen() {
+	auto fail{ [&](const std::string& inWhat) { throw std::runtime_error{ inWhat + ": " + std::strerror(errno) }; } };
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(static_cast<std::uint16_t>(m_options.port));
+	if (::inet_pton(AF_INET, m_options.address.c_str(), &address.sin_addr) != 1) throw std::runtime_error{ "Not an IPv4 address: " + m_options.address };
+
+	m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_listenFd < 0) fail("Error creating socket");
+	const int on{ 1 };
+	::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (::bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) fail("Error binding to " + m_options.address + ':' + std::to_string(m_options.port));
+	if (::listen(m_listenFd, SOMAXCONN) < 0) fail("Error listening");
+
+	socklen_t length{ sizeof(address) };
+	::getsockname(m_listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+	m_port = ntohs(address.sin_port);
+
+	m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+	m_wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_epollFd < 0 || m_wakeFd < 0) fail("Error setting up the event loop");
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.fd = m_listenFd;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+	event.data.fd = m_wakeFd;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+}
+
+
+void HttpServer::run() {
+	if (m_listenFd < 0) listen();
+
+	//Ctrl+C stops the server cleanly, rather than killing the process with connections still open.
+	StopSignalScope stopSignals{ m_wakeFd };
+	constexpr int maxEvents{ 64 };
+	epoll_event events[maxEvents];
+	auto lastSweep{ std::chrono::steady_clock::now() };
+	while (!m_stopping && !stopSignals.signalled()) {
+		const int ready{ ::epoll_wait(m_epollFd, events, maxEvents, 1000) };
+		if (ready < 0 && errno != EINTR) break;
+
+		for (int i = 0; i < ready; ++i) {
+			const int fd{ events[i].data.fd };
+			if (fd == m_listenFd) acceptConnections();
+			else if (fd == m_wakeFd) {
+				std::uint64_t count;
+				while (::read(m_wakeFd, &count, sizeof(count)) > 0) {}
+				takeCompletions();
+			}
+			else {
+				auto connection{ m_connections.find(fd) };
+				if (connection == m_connections.end()) continue;
+				if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+					closeConnection(fd);
+					continue;
+				}
+				if (events[i].events & EPOLLOUT) flush(fd, connection->second);
+				//flush() may have closed it.
+				connection = m_connections.find(fd);
+				if (connection != m_connections.end() && (events[i].events & EPOLLIN)) readFrom(fd, connection->second);
+			}
+		}
+
+		if (std::chrono::steady_clock::now() - lastSweep >= std::chrono::seconds{ 1 }) {
+			closeIdleConnections();
+			lastSweep = std::chrono::steady_clock::now();
+		}
+	}
+
+	//Let the workers finish what they're doing, as they may be part way through writing to the database, then drop the connections.
+	m_admission.stop();
+	while (!m_connections.empty()) closeConnection(m_connections.begin()->first);
+}
+
+
+void HttpServer::stop() {
+	m_stopping = true;
+	wake();
+}
+
+
+void HttpServer::wake() {
+	const std::uint64_t one{ 1 };
+	[[maybe_unused]] auto written{ ::write(m_wakeFd, &one, sizeof(one)) };
+}
+
+
+void HttpServer::acceptConnections() {
+	while (true) {
+		const int fd{ ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) };
+		if (fd < 0) return;			//EAGAIN once the backlog is empty. Anything else will show up again next time round.
+
+		std::lock_guard lock{ m_statsMutex };
+		if (m_connections.size() >= m_options.maxConnections) {
+			::close(fd);
+			++m_stats.connectionsRefused;
+			continue;
+		}
+		//Responses are written in one go, so there's nothing to gain from Nagle's algorithm holding the end of one back.
+		const int on{ 1 };
+		::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+		Connection& connection{ m_connections[fd] };
+		connection.id = m_nextConnectionID++;
+		connection.lastActivity = std::chrono::steady_clock::now();
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = fd;
+		::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event);
+		++m_stats.connectionsAccepted;
+		m_stats.connectionsOpen = m_connections.size();
+	}
+}
+
+
+void HttpServer::readFrom(int fd, Connection& connection) {
+	//The biggest request we'd accept. With more than this buffered, the first request is either complete or too big, so processInput() can
+	//always do something with it, and we needn't read any further until it has. Anything more waits in the socket, held back by TCP.
+	const std::size_t maxRequestBytes{ m_options.maxHeaderBytes + 4 + m_options.maxBodyBytes };
+	char buffer[16384];
+	while (connection.input.size() <= maxRequestBytes) {
+		const ssize_t received{ ::recv(fd, buffer, sizeof(buffer), 0) };
+		if (received > 0) {
+			connection.input.append(buffer, static_cast<std::size_t>(received));
+			connection.lastActivity = std::chrono::steady_clock::now();
+			continue;
+		}
+		if (received < 0 && errno == EINTR) continue;
+		if (received == 0) {
+			//The client has finished sending, but may still be waiting for the answers to what it sent (e.g. an HTTP/1.0 tool which
+			//shuts down its side after the request). Those are answered before we close.
+			connection.inputClosed = true;
+			break;
+		}
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			//The connection has failed. Nothing we could send would be read.
+			closeConnection(fd);
+			return;
+		}
+		break;
+	}
+	processInput(fd, connection);
+}
+
+
+void HttpServer::processInput(int fd, Connection& connection) {
+	if (connection.busy || connection.outputSent < connection.output.size()) return;
+
+	ParsedRequest parsed;
+	const ParseResult result{ parseRequest(connection.input, m_options, parsed) };
+	if (result == ParseResult::Incomplete && connection.inputClosed) {
+		//Everything the client sent has been answered, bar perhaps part of a request which can now never be finished.
+		closeConnection(fd);
+		return;
+	}
+	if (result == ParseResult::Incomplete) {
+		//A client which sent "Expect: 100-continue" is waiting for us to say we want the body before it sends it.
+		if (parsed.expectsContinue && !connection.continueSent) {
+			connection.continueSent = true;
+			connection.output += "HTTP/1.1 100 Continue\r\n\r\n";
+			flush(fd, connection);
+		}
+		return;
+	}
+	if (result == ParseResult::Bad) {
+		{
+			std::lock_guard lock{ m_statsMutex };
+			++m_stats.badRequests;
+		}
+		//We can't tell where the next request would start, so this is the last on the connection.
+		connection.input.clear();
+		queueResponse(fd, connection, errorResponse(parsed.errorStatus, parsed.error), false);
+		return;
+	}
+
+	connection.input.erase(0, parsed.length);
+	connection.continueSent = false;
+	connection.busy = true;
+	updateInterest(fd, connection);
+	{
+		std::lock_guard lock{ m_statsMutex };
+		++m_stats.requests;
+	}
+
+	const RequestCost cost{ m_classifier(parsed.request) };
+	const bool keepAlive{ parsed.keepAlive };
+	const std::uint64_t connectionID{ connection.id };
+	const bool admitted{ m_admission.submit(cost, [this, fd, connectionID, keepAlive, request{ std::move(parsed.request) }] {
+		HttpResponse response;
+		try {
+			response = m_handler(request);
+		}
+		catch (std::exception& e) {
+			response = errorResponse(500, e.what());
+		}
+		{
+			std::lock_guard lock{ m_completionsMutex };
+			m_completions.push_back({ fd, connectionID, serialise(response, keepAlive), !keepAlive });
+		}
+		wake();
+	}) };
+
+	if (!admitted) {
+		{
+			std::lock_guard lock{ m_statsMutex };
+			++m_stats.requestsRejected;
+		}
+		connection.busy = false;
+		queueResponse(fd, connection, errorResponse(503, "The server is too busy for this request. Please try again shortly"), keepAlive);
+	}
+}
+
+
+void HttpServer::queueResponse(int fd, Connection& connection, const HttpResponse& inResponse, bool keepAlive) {
+	connection.output += serialise(inResponse, keepAlive);
+	connection.closeAfterWrite = connection.closeAfterWrite || !keepAlive;
+	flush(fd, connection);
+}
+
+
+void HttpServer::flush(int fd, Connection& connection) {
+	while (connection.outputSent < connection.output.size()) {
+		const ssize_t sent{ ::send(fd, connection.output.data() + connection.outputSent, connection.output.size() - connection.outputSent, MSG_NOSIGNAL) };
+		if (sent > 0) {
+			connection.outputSent += static_cast<std::size_t>(sent);
+			continue;
+		}
+		if (errno == EINTR) continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			updateInterest(fd, connection);
+			return;
+		}
+		closeConnection(fd);
+		return;
+	}
+
+	connection.output.clear();
+	connection.outputSent = 0;
+	connection.lastActivity = std::chrono::steady_clock::now();
+	if (connection.closeAfterWrite) {
+		closeConnection(fd);
+		return;
+	}
+	updateInterest(fd, connection);
+	//A pipelining client may already have sent its next request, or have finished sending, in which case we're done.
+	if (!connection.input.empty() || connection.inputClosed) processInput(fd, connection);
+}
+
+
+void HttpServer::updateInterest(int fd, const Connection& connection) {
+	epoll_event event{};
+	event.data.fd = fd;
+	if (connection.outputSent < connection.output.size()) event.events = EPOLLOUT;
+	else if (!connection.busy && !connection.inputClosed) event.events = EPOLLIN;		//A closed input would be reported as readable forever.
+	::epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+
+void HttpServer::closeConnection(int fd) {
+	::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	::close(fd);
+	m_connections.erase(fd);
+	std::lock_guard lock{ m_statsMutex };
+	m_stats.connectionsOpen = m_connections.size();
+}
+
+
+void HttpServer::takeCompletions() {
+	std::vector<Completion> completions;
+	{
+		std::lock_guard lock{ m_completionsMutex };
+		completions.swap(m_completions);
+	}
+	for (auto& completion : completions) {
+		auto connection{ m_connections.find(completion.fd) };
+		if (connection == m_connections.end() || connection->second.id != completion.connectionID) continue;		//The client gave up on it.
+		connection->second.busy = false;
+		connection->second.output += completion.response;
+		connection->second.closeAfterWrite = connection->second.closeAfterWrite || completion.close;
+		flush(completion.fd, connection->second);
+	}
+}
+
+
+void HttpServer::closeIdleConnections() {
+	const auto now{ std::chrono::steady_clock::now() };
+	std::vector<int> idle;
+	for (const auto& [fd, connection] : m_connections) {
+		if (!connection.busy && now - connection.lastActivity >= m_options.idleTimeout) idle.push_back(fd);
+	}
+	for (int fd : idle) closeConnection(fd);
+}
+
+#endif
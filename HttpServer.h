@@ -0,0 +1,142 @@
+#pragma once
+
+//Standard library includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//Project includes
+#include "AdmissionControl.h"
+
+
+//A small HTTP/1.1 server for the JSON interface, so that other programs can use the database without driving the console menus.
+//
+//One thread runs an event loop over non-blocking sockets with epoll: it accepts connections, reads and parses requests, and writes responses,
+//but never touches the database. Each parsed request is handed to an AdmissionController (see AdmissionControl.h), whose worker threads run
+//the handler, so a slow query holds up one worker, never the loop, and a flood of expensive requests is turned away with a 503 rather than
+//allowed to pile up. Finished responses are passed back to the loop through a queue, and the loop is woken with an eventfd to send them.
+//
+//Connections are kept alive between requests (HTTP/1.1's default), and clients may pipeline requests. Each connection has at most one
+//request in progress, and responses go back in the order the requests came, as HTTP requires. While a request is in progress, or once
+//a connection has a whole request's worth of input waiting, we stop reading from it, so a client that sends faster than we answer is held
+//back by TCP rather than by our memory. A client which shuts down its sending side still gets answers to the requests it sent.
+//Bodies must come with a Content-Length, and chunked requests are refused.
+//
+//This uses epoll, so the server is only available on Linux. Elsewhere run() throws.
+
+struct HttpRequest {
+	std::string method;
+	std::string path;										//Percent-decoded, without the query string.
+	std::map<std::string, std::string> query;				//Decoded query string parameters.
+	std::map<std::string, std::string> headers;				//Names lower-cased.
+	std::string body;
+};
+
+struct HttpResponse {
+	int status{ 200 };
+	std::string body;
+	std::string contentType{ "application/json" };
+};
+
+struct HttpServerOptions {
+	std::string address{ "127.0.0.1" };					//Loopback only by default. The interface has no authentication of its own.
+	int port{ 8080 };										//0 to have the system choose one. See HttpServer::port().
+	AdmissionController::Limits admission;
+	std::size_t maxConnections{ 1024 };
+	std::size_t maxHeaderBytes{ 16 << 10 };
+	std::size_t maxBodyBytes{ 1 << 20 };
+	std::chrono::seconds idleTimeout{ 60 };					//Keep-alive connections with nothing in progress are closed after this long.
+};
+
+class HttpServer {
+public:
+	using Classifier = std::function<RequestCost(const HttpRequest&)>;
+	//Called on a worker thread. Anything it throws becomes a 500 response.
+	using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+	struct Stats {
+		std::size_t connectionsAccepted{ 0 };
+		std::size_t connectionsOpen{ 0 };
+		std::size_t connectionsRefused{ 0 };				//Accepted and closed straight away, as maxConnections were already open.
+		std::size_t requests{ 0 };
+		std::size_t requestsRejected{ 0 };					//Turned away with a 503 by admission control.
+		std::size_t badRequests{ 0 };						//Which couldn't be parsed, or were too big.
+	};
+
+	HttpServer(HttpServerOptions inOptions, Classifier inClassifier, Handler inHandler);
+	~HttpServer();
+	HttpServer(const HttpServer&) = delete;
+	HttpServer& operator=(const HttpServer&) = delete;
+
+	//Binds the listening socket. Throws std::runtime_error if it can't, e.g. because the port is in use.
+	void listen();
+	//The port we're listening on, which is the one the system chose if the options asked for port 0.
+	int port() const { return m_port; }
+
+	//Runs the event loop on the calling thread until stop() is called, or the process is sent SIGINT or SIGTERM. Requests in progress
+	//are finished before it returns, but their responses aren't sent.
+	void run();
+	//Asks run() to return. Safe to call from any thread.
+	void stop();
+
+	Stats stats() const;
+	const AdmissionController& admission() const { return m_admission; }
+
+private:
+	struct Connection {
+		std::uint64_t id;
+		std::string input;
+		std::string output;
+		std::size_t outputSent{ 0 };
+		bool busy{ false };									//A request from this connection is queued or running.
+		bool continueSent{ false };							//We've answered this request's "Expect: 100-continue".
+		bool closeAfterWrite{ false };
+		bool inputClosed{ false };							//The client has shut down its side, so nothing more will arrive.
+		std::chrono::steady_clock::time_point lastActivity;
+	};
+
+	struct Completion {
+		int fd;
+		std::uint64_t connectionID;
+		std::string response;
+		bool close;
+	};
+
+	void acceptConnections();
+	void readFrom(int fd, Connection& connection);
+	void processInput(int fd, Connection& connection);
+	void queueResponse(int fd, Connection& connection, const HttpResponse& inResponse, bool keepAlive);
+	void flush(int fd, Connection& connection);
+	void updateInterest(int fd, const Connection& connection);
+	void closeConnection(int fd);
+	void takeCompletions();
+	void closeIdleConnections();
+	void wake();
+
+	HttpServerOptions m_options;
+	Classifier m_classifier;
+	Handler m_handler;
+	AdmissionController m_admission;
+
+	int m_listenFd{ -1 };
+	int m_epollFd{ -1 };
+	int m_wakeFd{ -1 };
+	int m_port{ 0 };
+	std::atomic<bool> m_stopping{ false };
+
+	std::unordered_map<int, Connection> m_connections;		//Keyed on socket. Only touched by the loop thread.
+	std::uint64_t m_nextConnectionID{ 1 };					//So a completion for a closed connection isn't sent to a new one which reused its socket.
+
+	std::mutex m_completionsMutex;
+	std::vector<Completion> m_completions;
+
+	mutable std::mutex m_statsMutex;
+	Stats m_stats;
+};
@@ -0,0 +1,326 @@
+//Standard library includes
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+//Project includes
+#include "Json.h"
+
+namespace {
+
+	void appendEscaped(std::string& out, std::string_view inText) {
+		out += '"';
+		for (char c : inText) {
+			switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+					out += escaped;
+				}
+				else out += c;		//Anything from 0x80 up is part of a UTF-8 sequence, which JSON allows as it is.
+			}
+		}
+		out += '"';
+	}
+
+	//A cursor over request text. Every method throws std::invalid_argument at the first thing it doesn't expect.
+	class JsonReader {
+	public:
+		explicit JsonReader(std::string_view inText) : m_text{ inText } {}
+
+		void skipSpace() {
+			while (m_position < m_text.size() && (m_text[m_position] == ' ' || m_text[m_position] == '\t' || m_text[m_position] == '\n' || m_text[m_position] == '\r')) ++m_position;
+		}
+
+		bool atEnd() {
+			skipSpace();
+			return m_position == m_text.size();
+		}
+
+		//Consumes the character if it's next, ignoring whitespace.
+		bool accept(char c) {
+			skipSpace();
+			if (m_position < m_text.size() && m_text[m_position] == c) {
+				++m_position;
+				return true;
+			}
+			return false;
+		}
+
+		void expect(char c) {
+			if (!accept(c)) fail(std::string{ "expected '" } + c + "'");
+		}
+
+		std::string readString() {
+			expect('"');
+			std::string text;
+			while (true) {
+				if (m_position >= m_text.size()) fail("unterminated string");
+				const char c{ m_text[m_position++] };
+				if (c == '"') return text;
+				if (static_cast<unsigned char>(c) < 0x20) fail("control character in string");
+				if (c != '\\') {
+					text += c;
+					continue;
+				}
+				if (m_position >= m_text.size()) fail("unterminated string");
+				switch (m_text[m_position++]) {
+				case '"': text += '"'; break;
+				case '\\': text += '\\'; break;
+				case '/': text += '/'; break;
+				case 'b': text += '\b'; break;
+				case 'f': text += '\f'; break;
+				case 'n': text += '\n'; break;
+				case 'r': text += '\r'; break;
+				case 't': text += '\t'; break;
+				case 'u': appendCodePoint(text, readCodePoint()); break;
+				default: fail("bad escape in string");
+				}
+			}
+		}
+
+		JsonValue readValue() {
+			skipSpace();
+			if (m_position >= m_text.size()) fail("expected a value");
+			JsonValue value;
+			const char c{ m_text[m_position] };
+			if (c == '"') {
+				value.type = JsonValue::Type::String;
+				value.text = readString();
+			}
+			else if (readWord("true")) {
+				value.type = JsonValue::Type::Boolean;
+				value.boolean = true;
+			}
+			else if (readWord("false")) value.type = JsonValue::Type::Boolean;
+			else if (readWord("null")) value.type = JsonValue::Type::Null;
+			else if (c == '-' || (c >= '0' && c <= '9')) {
+				const std::size_t start{ m_position };
+				while (m_position < m_text.size() && std::string_view{ "+-.eE0123456789" }.find(m_text[m_position]) != std::string_view::npos) ++m_position;
+				const std::string number{ m_text.substr(start, m_position - start) };
+				char* end{ nullptr };
+				value.number = std::strtod(number.c_str(), &end);
+				if (end != number.c_str() + number.size() || !std::isfinite(value.number)) fail("bad number");
+				value.type = JsonValue::Type::Number;
+			}
+			else if (c == '{' || c == '[') fail("nested objects and arrays aren't accepted");
+			else fail("expected a value");
+			return value;
+		}
+
+		[[noreturn]] void fail(const std::string& inProblem) const {
+			throw std::invalid_argument{ "Bad JSON at character " + std::to_string(m_position + 1) + ": " + inProblem };
+		}
+
+	private:
+		bool readWord(std::string_view inWord) {
+			if (m_text.substr(m_position, inWord.size()) != inWord) return false;
+			m_position += inWord.size();
+			return true;
+		}
+
+		unsigned readHex4() {
+			if (m_position + 4 > m_text.size()) fail("bad \\u escape");
+			unsigned value{ 0 };
+			for (int i = 0; i < 4; ++i) {
+				const char c{ m_text[m_position++] };
+				value <<= 4;
+				if (c >= '0' && c <= '9') value |= c - '0';
+				else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+				else fail("bad \\u escape");
+			}
+			return value;
+		}
+
+		//A \u escape, joining a surrogate pair into the one code point it stands for.
+		unsigned readCodePoint() {
+			unsigned codePoint{ readHex4() };
+			if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+				if (m_text.substr(m_position, 2) != "\\u") fail("unpaired surrogate");
+				m_position += 2;
+				const unsigned low{ readHex4() };
+				if (low < 0xDC00 || low >= 0xE000) fail("unpaired surrogate");
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+			}
+			else if (codePoint >= 0xDC00 && codePoint < 0xE000) fail("unpaired surrogate");
+			return codePoint;
+		}
+
+		static void appendCodePoint(std::string& out, unsigned codePoint) {
+			if (codePoint < 0x80) out += static_cast<char>(codePoint);
+			else if (codePoint < 0x800) {
+				out += static_cast<char>(0xC0 | (codePoint >> 6));
+				out += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else if (codePoint < 0x10000) {
+				out += static_cast<char>(0xE0 | (codePoint >> 12));
+				out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else {
+				out += static_cast<char>(0xF0 | (codePoint >> 18));
+				out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+				out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+		}
+
+		std::string_view m_text;
+		std::size_t m_position{ 0 };
+	};
+
+}
+
+
+void JsonWriter::separate() {
+	if (m_afterKey) {
+		m_afterKey = false;
+		return;
+	}
+	if (!m_firstInScope.empty()) {
+		if (!m_firstInScope.back()) m_output += ',';
+		m_firstInScope.back() = false;
+	}
+}
+
+
+JsonWriter& JsonWriter::beginObject() {
+	separate();
+	m_output += '{';
+	m_firstInScope.push_back(true);
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::endObject() {
+	m_output += '}';
+	m_firstInScope.pop_back();
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::beginArray() {
+	separate();
+	m_output += '[';
+	m_firstInScope.push_back(true);
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::endArray() {
+	m_output += ']';
+	m_firstInScope.pop_back();
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::key(std::string_view inKey) {
+	separate();
+	appendEscaped(m_output, inKey);
+	m_output += ':';
+	m_afterKey = true;
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::value(std::string_view inValue) {
+	separate();
+	appendEscaped(m_output, inValue);
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::value(std::int64_t inValue) {
+	separate();
+	m_output += std::to_string(inValue);
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::value(double inValue) {
+	separate();
+	//JSON has no infinity or NaN, so those go out as null.
+	if (!std::isfinite(inValue)) m_output += "null";
+	else {
+		char number[32];
+		std::snprintf(number, sizeof(number), "%.17g", inValue);
+		m_output += number;
+	}
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::value(bool inValue) {
+	separate();
+	m_output += inValue ? "true" : "false";
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::null() {
+	separate();
+	m_output += "null";
+	return *this;
+}
+
+
+JsonWriter& JsonWriter::column(sqlite3_stmt* inStatement, int inColumn) {
+	switch (sqlite3_column_type(inStatement, inColumn)) {
+	case SQLITE_INTEGER: return value(static_cast<std::int64_t>(sqlite3_column_int64(inStatement, inColumn)));
+	case SQLITE_FLOAT: return value(sqlite3_column_double(inStatement, inColumn));
+	case SQLITE_NULL: return null();
+	case SQLITE_BLOB: return value(std::string_view{ "(blob)" });
+	default: {
+		const auto text{ reinterpret_cast<const char*>(sqlite3_column_text(inStatement, inColumn)) };
+		return value(std::string_view{ text, static_cast<std::size_t>(sqlite3_column_bytes(inStatement, inColumn)) });
+	}
+	}
+}
+
+
+std::size_t writeRowsAsJson(JsonWriter& writer, sqlite3_stmt* inStatement) {
+	std::size_t rows{ 0 };
+	const int columns{ sqlite3_column_count(inStatement) };
+	writer.beginArray();
+	int stepStatus;
+	while ((stepStatus = sqlite3_step(inStatement)) == SQLITE_ROW) {
+		writer.beginObject();
+		for (int i = 0; i < columns; ++i) writer.key(sqlite3_column_name(inStatement, i)).column(inStatement, i);
+		writer.endObject();
+		++rows;
+	}
+	writer.endArray();
+	if (stepStatus != SQLITE_DONE) throw std::runtime_error{ "Error stepping statement: " + std::string{ sqlite3_errmsg(sqlite3_db_handle(inStatement)) } };
+	return rows;
+}
+
+
+bool JsonValue::isInteger() const {
+	return type == Type::Number && std::floor(number) == number && std::fabs(number) < 9.0e15;
+}
+
+
+std::map<std::string, JsonValue> parseFlatJsonObject(std::string_view inText) {
+	JsonReader reader{ inText };
+	std::map<std::string, JsonValue> object;
+	reader.expect('{');
+	if (!reader.accept('}')) {
+		do {
+			reader.skipSpace();
+			std::string key{ reader.readString() };
+			reader.expect(':');
+			object[std::move(key)] = reader.readValue();
+		} while (reader.accept(','));
+		reader.expect('}');
+	}
+	if (!reader.atEnd()) reader.fail("unexpected text after the object");
+	return object;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Just enough JSON for the HTTP server: a writer which builds a document straight into a string, and a reader for the flat objects
+//clients send us (e.g. {"First_Name": "John", "Credit_Limit": 500}). Nested objects and arrays aren't needed in requests, so they're refused.
+
+class JsonWriter {
+public:
+	JsonWriter& beginObject();
+	JsonWriter& endObject();
+	JsonWriter& beginArray();
+	JsonWriter& endArray();
+	//Inside an object, every value must be preceded by its key.
+	JsonWriter& key(std::string_view inKey);
+
+	JsonWriter& value(std::string_view inValue);
+	JsonWriter& value(const char* inValue) { return value(std::string_view{ inValue }); }
+	JsonWriter& value(std::int64_t inValue);
+	JsonWriter& value(int inValue) { return value(static_cast<std::int64_t>(inValue)); }
+	JsonWriter& value(std::size_t inValue) { return value(static_cast<std::int64_t>(inValue)); }
+	JsonWriter& value(double inValue);
+	JsonWriter& value(bool inValue);
+	JsonWriter& null();
+	//Writes column inColumn of the statement's current row as whichever JSON type matches its SQLite type.
+	JsonWriter& column(sqlite3_stmt* inStatement, int inColumn);
+
+	const std::string& str() const { return m_output; }
+	std::string take() { return std::move(m_output); }
+
+private:
+	void separate();
+
+	std::string m_output;
+	std::vector<bool> m_firstInScope;		//One entry per open object or array: whether nothing has been written in it yet.
+	bool m_afterKey{ false };
+};
+
+//Writes every row the statement gives as an array of objects keyed on the column names. Returns the number of rows written.
+std::size_t writeRowsAsJson(JsonWriter& writer, sqlite3_stmt* inStatement);
+
+
+//A value from a request body.
+struct JsonValue {
+	enum class Type { Null, Boolean, Number, String };
+	Type type{ Type::Null };
+	bool boolean{ false };
+	double number{ 0 };
+	std::string text;
+	bool isInteger() const;
+};
+
+//Reads a JSON object whose values are all strings, numbers, booleans or null. Throws std::invalid_argument describing the problem if the
+//text isn't one. Duplicate keys keep the last value, as most parsers do.
+std::map<std::string, JsonValue> parseFlatJsonObject(std::string_view inText);
@@ -0,0 +1,161 @@
+//Standard library includes
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+//Project includes
+#include "LookupClient.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	//Writes are held back until there's about this much to send, so that many small frames go in one system call.
+	constexpr std::size_t outputFlushBytes{ 64 << 10 };
+
+	std::size_t keyBytes(const LookupKey& inKey) {
+		return 1 + (inKey.kind == LookupKeyKind::ShortName ? 2 + std::min<std::size_t>(inKey.shortName.size(), 0xFFFF) : 8);
+	}
+
+}
+
+
+#ifndef __linux__
+
+LookupClient::LookupClient(const std::string&) { throw std::runtime_error{ "The lookup client is only available on Linux" }; }
+LookupClient::~LookupClient() {}
+void LookupClient::flush() {}
+std::vector<LookupResult> LookupClient::receive(std::uint32_t*) { throw std::runtime_error{ "The lookup client is only available on Linux" }; }
+
+#else
+
+LookupClient::LookupClient(const std::string& inSocketPath) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (inSocketPath.empty() || inSocketPath.size() >= sizeof(address.sun_path)) throw std::runtime_error{ "Socket path is empty or too long: " + inSocketPath };
+	std::memcpy(address.sun_path, inSocketPath.c_str(), inSocketPath.size() + 1);
+
+	m_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_fd < 0 || ::connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+		const std::string errorMessage{ "Error connecting to " + inSocketPath + ": " + std::strerror(errno) };
+		if (m_fd >= 0) ::close(m_fd);
+		throw std::runtime_error{ errorMessage };
+	}
+}
+
+
+LookupClient::~LookupClient() {
+	if (m_fd >= 0) ::close(m_fd);
+}
+
+
+void LookupClient::flush() {
+	std::size_t sent{ 0 };
+	while (sent < m_output.size()) {
+		const ssize_t written{ ::send(m_fd, m_output.data() + sent, m_output.size() - sent, MSG_NOSIGNAL) };
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error{ "Error sending to the lookup server: " + std::string{ std::strerror(errno) } };
+		}
+		sent += static_cast<std::size_t>(written);
+	}
+	m_output.clear();
+}
+
+
+std::vector<LookupResult> LookupClient::receive(std::uint32_t* outRequestID) {
+	if (m_pending.empty()) throw std::runtime_error{ "There are no lookups waiting for results" };
+	flush();
+
+	LookupFrame frame;
+	while (!nextLookupFrame(std::string_view{ m_input }.substr(m_inputRead), frame, std::numeric_limits<std::uint32_t>::max())) {
+		//Make room by dropping the frames already taken, before reading more.
+		m_input.erase(0, m_inputRead);
+		m_inputRead = 0;
+		char buffer[65536];
+		const ssize_t received{ ::recv(m_fd, buffer, sizeof(buffer), 0) };
+		if (received < 0 && errno == EINTR) continue;
+		if (received <= 0) throw std::runtime_error{ received == 0 ? std::string{ "The lookup server closed the connection" } : "Error reading from the lookup server: " + std::string{ std::strerror(errno) } };
+		m_input.append(buffer, static_cast<std::size_t>(received));
+	}
+	m_inputRead += frame.length;
+
+	const std::uint32_t expected{ m_pending.front() };
+	m_pending.pop_front();
+	if (frame.type == LookupFrameType::Error) throw std::runtime_error{ "The lookup server refused the request: " + std::string{ WireReader{ frame.body }.text() } };
+	if (frame.type != LookupFrameType::Results || frame.requestID != expected) throw std::runtime_error{ "Unexpected reply from the lookup server" };
+	if (outRequestID) *outRequestID = frame.requestID;
+	try {
+		return readLookupResults(frame.body);
+	}
+	catch (std::invalid_argument& e) {
+		throw std::runtime_error{ "Malformed reply from the lookup server: " + std::string{ e.what() } };
+	}
+}
+
+#endif
+
+
+std::uint32_t LookupClient::send(const LookupKey* inKeys, std::size_t inKeyCount) {
+	std::size_t frameBytes{ lookupFrameHeaderBytes + 2 };
+	for (std::size_t i = 0; i < inKeyCount; ++i) frameBytes += keyBytes(inKeys[i]);
+	if (frameBytes > maxLookupFrameBytes) throw std::invalid_argument{ "Too many lookups for one frame" };
+
+	const std::uint32_t requestID{ m_nextRequestID++ };
+	writeLookupRequest(m_output, requestID, inKeys, inKeyCount);
+	m_pending.push_back(requestID);
+	if (m_output.size() >= outputFlushBytes) flush();
+	return requestID;
+}
+
+
+std::vector<LookupResult> LookupClient::lookup(const std::vector<LookupKey>& inKeys, std::size_t inKeysPerFrame, std::size_t inFramesInFlight) {
+	inKeysPerFrame = std::clamp<std::size_t>(inKeysPerFrame, 1, maxLookupsPerFrame);
+	inFramesInFlight = std::max<std::size_t>(inFramesInFlight, 1);
+
+	std::vector<LookupResult> results;
+	results.reserve(inKeys.size());
+	std::size_t next{ 0 };
+	while (next < inKeys.size() || !m_pending.empty()) {
+		//Keep the pipeline full, so the server always has the next frame to hand when it finishes one. It's kept to a limited depth, or
+		//with a big enough list we'd fill the socket's buffers in both directions, and we and the server would each wait for the other.
+		while (next < inKeys.size() && m_pending.size() < inFramesInFlight) {
+			std::size_t count{ 0 };
+			std::size_t frameBytes{ lookupFrameHeaderBytes + 2 };
+			while (next + count < inKeys.size() && count < inKeysPerFrame && frameBytes + keyBytes(inKeys[next + count]) <= maxLookupFrameBytes) {
+				frameBytes += keyBytes(inKeys[next + count]);
+				++count;
+			}
+			send(inKeys.data() + next, count);
+			next += count;
+		}
+		for (auto& result : receive()) results.push_back(std::move(result));
+	}
+	return results;
+}
+
+
+std::optional<CustomerRecord> LookupClient::findOne(const LookupKey& inKey) {
+	send(&inKey, 1);
+	std::vector<LookupResult> results{ receive() };
+	if (results.size() != 1) throw std::runtime_error{ "Unexpected reply from the lookup server" };
+	if (results[0].status == LookupStatus::Found) return std::move(results[0].customer);
+	if (results[0].status == LookupStatus::NotFound) return std::nullopt;
+	throw std::runtime_error{ results[0].status == LookupStatus::Busy ? "The lookup server is too busy. Please try again shortly" : "The lookup server couldn't look the customer up" };
+}
+
+
+std::optional<CustomerRecord> LookupClient::findByShortName(const std::string& inShortName) {
+	return findOne(LookupKey::byShortName(inShortName));
+}
+
+
+std::optional<CustomerRecord> LookupClient::findByCustomerID(std::int64_t inCustomerID) {
+	return findOne(LookupKey::byCustomerID(inCustomerID));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+//Standard library includes
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "LookupProtocol.h"
+
+
+//A client for the lookup server (see LookupServer.h), for other programs to build in along with LookupProtocol.h/.cpp.
+//
+//	LookupClient client{ "Customers.sock" };
+//	auto customer{ client.findByShortName("JSMITH") };
+//	auto results{ client.lookup(keys) };		//Any number of keys, results in the same order.
+//
+//lookup() splits the keys into frames and keeps several frames in flight at once, which is how the protocol is meant to be used: the cost
+//of each round trip is shared by every key in every frame in flight. For finer control, send() and receive() pipeline frames by hand.
+//
+//A client is a single connection, so it should only be used by one thread at a time. Give each thread its own.
+//Errors talking to the server are thrown as std::runtime_error, after which the client should be thrown away.
+class LookupClient {
+public:
+	explicit LookupClient(const std::string& inSocketPath = "Customers.sock");
+	~LookupClient();
+	LookupClient(const LookupClient&) = delete;
+	LookupClient& operator=(const LookupClient&) = delete;
+
+	//Looks every key up, inKeysPerFrame to a frame with up to inFramesInFlight frames sent ahead of the replies.
+	std::vector<LookupResult> lookup(const std::vector<LookupKey>& inKeys, std::size_t inKeysPerFrame = 1024, std::size_t inFramesInFlight = 8);
+	//One customer at a time, for convenience. Each is a round trip, so these are slower per lookup than a batch. Throws std::runtime_error
+	//if the server couldn't do the lookup (rather than finding no such customer).
+	std::optional<CustomerRecord> findByShortName(const std::string& inShortName);
+	std::optional<CustomerRecord> findByCustomerID(std::int64_t inCustomerID);
+
+	//Queues a frame of lookups, returning its request ID. Frames are written when the queue gets large, or on flush() or receive().
+	//Throws std::invalid_argument if the keys won't fit in one frame.
+	std::uint32_t send(const LookupKey* inKeys, std::size_t inKeyCount);
+	std::uint32_t send(const std::vector<LookupKey>& inKeys) { return send(inKeys.data(), inKeys.size()); }
+	void flush();
+	//Waits for the results of the oldest frame sent and not yet received, and returns them in the order of its keys.
+	std::vector<LookupResult> receive(std::uint32_t* outRequestID = nullptr);
+	//Frames sent whose results haven't been received.
+	std::size_t pending() const { return m_pending.size(); }
+
+private:
+	std::optional<CustomerRecord> findOne(const LookupKey& inKey);
+
+	int m_fd{ -1 };
+	std::string m_output;
+	std::string m_input;
+	std::size_t m_inputRead{ 0 };			//How much of m_input has been taken as frames already.
+	std::uint32_t m_nextRequestID{ 1 };
+	std::deque<std::uint32_t> m_pending;
+};
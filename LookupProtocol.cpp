@@ -0,0 +1,149 @@
+//Standard library includes
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+//Project includes
+#include "LookupProtocol.h"
+
+
+void WireWriter::f64(double inValue) {
+	std::uint64_t bits;
+	static_assert(sizeof(bits) == sizeof(inValue));
+	std::memcpy(&bits, &inValue, sizeof(bits));
+	appendLittleEndian(bits, 8);
+}
+
+
+void WireWriter::text(std::string_view inText) {
+	const std::size_t length{ std::min<std::size_t>(inText.size(), 0xFFFF) };
+	u16(static_cast<std::uint16_t>(length));
+	m_out.append(inText.data(), length);
+}
+
+
+void WireWriter::beginFrame(LookupFrameType inType, std::uint32_t inRequestID) {
+	m_frameStart = m_out.size();
+	u32(0);
+	u32(inRequestID);
+	u8(static_cast<std::uint8_t>(inType));
+}
+
+
+void WireWriter::endFrame() {
+	const std::uint32_t length{ static_cast<std::uint32_t>(m_out.size() - m_frameStart - 4) };
+	for (int i = 0; i < 4; ++i) m_out[m_frameStart + i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+}
+
+
+double WireReader::f64() {
+	const std::uint64_t bits{ readLittleEndian(8) };
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+std::string_view WireReader::text() {
+	const std::uint16_t length{ u16() };
+	require(length);
+	const std::string_view value{ m_data.substr(m_position, length) };
+	m_position += length;
+	return value;
+}
+
+
+std::uint64_t WireReader::readLittleEndian(int inBytes) {
+	require(static_cast<std::size_t>(inBytes));
+	std::uint64_t value{ 0 };
+	for (int i = 0; i < inBytes; ++i) value |= static_cast<std::uint64_t>(static_cast<unsigned char>(m_data[m_position + i])) << (8 * i);
+	m_position += inBytes;
+	return value;
+}
+
+
+void WireReader::require(std::size_t inBytes) const {
+	if (m_data.size() - m_position < inBytes) throw std::invalid_argument{ "The frame ended part way through a value" };
+}
+
+
+bool nextLookupFrame(std::string_view inBuffer, LookupFrame& frame, std::uint32_t inMaxBytes) {
+	if (inBuffer.size() < 4) return false;
+	WireReader header{ inBuffer };
+	const std::uint32_t length{ header.u32() };
+	if (length > inMaxBytes) throw std::invalid_argument{ "Frame of " + std::to_string(length) + " bytes is too big" };
+	if (length < lookupFrameHeaderBytes - 4) throw std::invalid_argument{ "Frame is too short to have a header" };
+	if (inBuffer.size() - 4 < length) return false;
+	frame.requestID = header.u32();
+	frame.type = static_cast<LookupFrameType>(header.u8());
+	frame.length = 4 + static_cast<std::size_t>(length);
+	frame.body = inBuffer.substr(lookupFrameHeaderBytes, frame.length - lookupFrameHeaderBytes);
+	return true;
+}
+
+
+void writeLookupRequest(std::string& out, std::uint32_t inRequestID, const LookupKey* inKeys, std::size_t inKeyCount) {
+	if (inKeyCount > maxLookupsPerFrame) throw std::invalid_argument{ "Too many lookups for one frame" };
+	WireWriter writer{ out };
+	writer.beginFrame(LookupFrameType::Lookup, inRequestID);
+	writer.u16(static_cast<std::uint16_t>(inKeyCount));
+	for (std::size_t i = 0; i < inKeyCount; ++i) {
+		writer.u8(static_cast<std::uint8_t>(inKeys[i].kind));
+		if (inKeys[i].kind == LookupKeyKind::ShortName) writer.text(inKeys[i].shortName);
+		else writer.i64(inKeys[i].customerID);
+	}
+	writer.endFrame();
+}
+
+
+std::vector<LookupKey> readLookupRequest(std::string_view inBody) {
+	WireReader reader{ inBody };
+	std::vector<LookupKey> keys(reader.u16());
+	for (auto& key : keys) {
+		key.kind = static_cast<LookupKeyKind>(reader.u8());
+		if (key.kind == LookupKeyKind::ShortName) key.shortName = std::string{ reader.text() };
+		else if (key.kind == LookupKeyKind::CustomerID) key.customerID = reader.i64();
+		else throw std::invalid_argument{ "Unknown lookup key kind " + std::to_string(static_cast<int>(key.kind)) };
+	}
+	if (!reader.atEnd()) throw std::invalid_argument{ "Unexpected bytes after the last lookup" };
+	return keys;
+}
+
+
+void writeCustomerRecord(WireWriter& writer, const CustomerRecord& inCustomer) {
+	writer.i64(inCustomer.customerID);
+	writer.text(inCustomer.shortName);
+	writer.text(inCustomer.firstName);
+	writer.text(inCustomer.lastName);
+	writer.text(inCustomer.groupName);
+	writer.f64(inCustomer.creditLimit);
+	writer.f64(inCustomer.outstandingCredit);
+	writer.i64(inCustomer.createdOn);
+	writer.i64(inCustomer.updatedOn);
+}
+
+
+CustomerRecord readCustomerRecord(WireReader& reader) {
+	CustomerRecord customer;
+	customer.customerID = reader.i64();
+	customer.shortName = reader.text();
+	customer.firstName = reader.text();
+	customer.lastName = reader.text();
+	customer.groupName = reader.text();
+	customer.creditLimit = reader.f64();
+	customer.outstandingCredit = reader.f64();
+	customer.createdOn = reader.i64();
+	customer.updatedOn = reader.i64();
+	return customer;
+}
+
+
+std::vector<LookupResult> readLookupResults(std::string_view inBody) {
+	WireReader reader{ inBody };
+	std::vector<LookupResult> results(reader.u16());
+	for (auto& result : results) {
+		result.status = static_cast<LookupStatus>(reader.u8());
+		if (result.status == LookupStatus::Found) result.customer = readCustomerRecord(reader);
+	}
+	return results;
+}
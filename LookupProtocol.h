@@ -0,0 +1,149 @@
+#pragma once
+
+//Standard library includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+//The binary protocol spoken by the lookup server (--serve-lookups, see LookupServer.h) and its client library (LookupClient.h).
+//
+//It's for services doing customer lookups at a high rate, where parsing HTTP and JSON for each one would cost more than the lookup itself.
+//Everything is sent as frames:
+//
+//	u32 length		Of everything after this field, so a frame can be skipped without understanding it.
+//	u32 requestID	Chosen by the client, and echoed in the reply, so replies can be matched to requests.
+//	u8  type		A LookupFrameType.
+//	...				The body, which depends on the type.
+//
+//A Lookup frame's body is a u16 count, followed by that many keys, each a u8 LookupKeyKind and then either a string (a short name, matched
+//ignoring case as the menus do) or an i64 Customer_ID. The server replies with a Results frame with the same request ID, whose body is a
+//u16 count and then, for each key in the same order, a u8 LookupStatus followed, if Found, by the customer (see writeCustomerRecord()).
+//A frame the server can't make sense of is answered with an Error frame, whose body is a string saying what was wrong.
+//
+//Integers are little-endian, doubles are IEEE 754 sent as their bit pattern in a u64, and strings are a u16 byte count then UTF-8 bytes.
+//
+//Clients may pipeline: send any number of frames without waiting for replies. Replies on one connection always come back in the order
+//the requests were sent. Putting many keys in one frame, and keeping several frames in flight, is what makes the protocol cheap - the server
+//answers all of the frames it has to hand at once, in one read transaction on one worker.
+
+enum class LookupFrameType : std::uint8_t {
+	Lookup = 1,
+	Results = 2,
+	Error = 3
+};
+
+enum class LookupKeyKind : std::uint8_t {
+	ShortName = 1,
+	CustomerID = 2
+};
+
+enum class LookupStatus : std::uint8_t {
+	Found = 0,
+	NotFound = 1,
+	Busy = 2,			//The server was too busy to look it up. Try again shortly.
+	Failed = 3			//The lookup went wrong on the server, e.g. the database was locked for too long.
+};
+
+constexpr std::size_t lookupFrameHeaderBytes{ 9 };
+constexpr std::uint32_t maxLookupFrameBytes{ 1 << 20 };		//Larger frames are refused, and the connection closed.
+constexpr std::size_t maxLookupsPerFrame{ 65535 };
+
+
+struct LookupKey {
+	LookupKeyKind kind{ LookupKeyKind::CustomerID };
+	std::int64_t customerID{ 0 };
+	std::string shortName;
+
+	static LookupKey byShortName(std::string inShortName) { return { LookupKeyKind::ShortName, 0, std::move(inShortName) }; }
+	static LookupKey byCustomerID(std::int64_t inCustomerID) { return { LookupKeyKind::CustomerID, inCustomerID, {} }; }
+};
+
+//A customer as the protocol sends them. NULL names are sent as empty strings, and NULL amounts as 0.
+struct CustomerRecord {
+	std::int64_t customerID{ 0 };
+	std::string shortName;
+	std::string firstName;
+	std::string lastName;
+	std::string groupName;
+	double creditLimit{ 0 };
+	double outstandingCredit{ 0 };
+	std::int64_t createdOn{ 0 };				//Seconds since 1970.
+	std::int64_t updatedOn{ 0 };
+};
+
+struct LookupResult {
+	LookupStatus status{ LookupStatus::NotFound };
+	CustomerRecord customer;					//Only filled in if status is Found.
+};
+
+
+//Appends values in the protocol's encoding.
+class WireWriter {
+public:
+	explicit WireWriter(std::string& out) : m_out{ out } {}
+
+	void u8(std::uint8_t inValue) { m_out += static_cast<char>(inValue); }
+	void u16(std::uint16_t inValue) { appendLittleEndian(inValue, 2); }
+	void u32(std::uint32_t inValue) { appendLittleEndian(inValue, 4); }
+	void i64(std::int64_t inValue) { appendLittleEndian(static_cast<std::uint64_t>(inValue), 8); }
+	void f64(double inValue);
+	//Strings longer than 65535 bytes are cut short. No column we send is anywhere near that.
+	void text(std::string_view inText);
+
+	//Starts a frame, leaving its length to be filled in by endFrame().
+	void beginFrame(LookupFrameType inType, std::uint32_t inRequestID);
+	void endFrame();
+
+private:
+	void appendLittleEndian(std::uint64_t inValue, int inBytes) {
+		for (int i = 0; i < inBytes; ++i) m_out += static_cast<char>((inValue >> (8 * i)) & 0xFF);
+	}
+
+	std::string& m_out;
+	std::size_t m_frameStart{ 0 };
+};
+
+//Reads values in the protocol's encoding. Every method throws std::invalid_argument if the data runs out first.
+class WireReader {
+public:
+	explicit WireReader(std::string_view inData) : m_data{ inData } {}
+
+	std::uint8_t u8() { return static_cast<std::uint8_t>(readLittleEndian(1)); }
+	std::uint16_t u16() { return static_cast<std::uint16_t>(readLittleEndian(2)); }
+	std::uint32_t u32() { return static_cast<std::uint32_t>(readLittleEndian(4)); }
+	std::int64_t i64() { return static_cast<std::int64_t>(readLittleEndian(8)); }
+	double f64();
+	std::string_view text();
+
+	bool atEnd() const { return m_position == m_data.size(); }
+
+private:
+	std::uint64_t readLittleEndian(int inBytes);
+	void require(std::size_t inBytes) const;
+
+	std::string_view m_data;
+	std::size_t m_position{ 0 };
+};
+
+//A frame's header, as read by nextLookupFrame().
+struct LookupFrame {
+	LookupFrameType type;
+	std::uint32_t requestID;
+	std::string_view body;
+	std::size_t length;							//Of the whole frame, header included.
+};
+
+//Reads the frame at the start of inBuffer into frame, returning false if it hasn't all arrived yet. Throws std::invalid_argument if the
+//frame claims to be bigger than inMaxBytes, as there's no sense in waiting for it. Replies can be bigger than requests, as each customer
+//found takes more room than the key which found it, so clients pass a larger limit.
+bool nextLookupFrame(std::string_view inBuffer, LookupFrame& frame, std::uint32_t inMaxBytes = maxLookupFrameBytes);
+
+void writeLookupRequest(std::string& out, std::uint32_t inRequestID, const LookupKey* inKeys, std::size_t inKeyCount);
+std::vector<LookupKey> readLookupRequest(std::string_view inBody);
+
+void writeCustomerRecord(WireWriter& writer, const CustomerRecord& inCustomer);
+CustomerRecord readCustomerRecord(WireReader& reader);
+std::vector<LookupResult> readLookupResults(std::string_view inBody);
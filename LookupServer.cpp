@@ -0,0 +1,442 @@
+//Standard library includes
+#include <stdexcept>
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "LookupServer.h"
+#include "LookupProtocol.h"
+#include "StopSignals.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	//The columns every lookup returns, in the order writeCustomerRecord() sends them.
+	const std::string selectByShortName{ "SELECT Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On "
+		"FROM Customers WHERE Customer_Short_Name = ? COLLATE NOCASE;" };
+	const std::string selectByID{ "SELECT Customer_ID, Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On "
+		"FROM Customers WHERE Customer_ID = ?;" };
+
+	std::string_view columnText(sqlite3_stmt* inStatement, int inColumn) {
+		const auto text{ reinterpret_cast<const char*>(sqlite3_column_text(inStatement, inColumn)) };
+		return text ? std::string_view{ text, static_cast<std::size_t>(sqlite3_column_bytes(inStatement, inColumn)) } : std::string_view{};
+	}
+
+	//Sends the current row straight from the statement, rather than copying it into a CustomerRecord first.
+	void writeCustomerColumns(WireWriter& writer, sqlite3_stmt* inStatement) {
+		writer.i64(sqlite3_column_int64(inStatement, 0));
+		writer.text(columnText(inStatement, 1));
+		writer.text(columnText(inStatement, 2));
+		writer.text(columnText(inStatement, 3));
+		writer.text(columnText(inStatement, 4));
+		writer.f64(sqlite3_column_double(inStatement, 5));
+		writer.f64(sqlite3_column_double(inStatement, 6));
+		writer.i64(sqlite3_column_int64(inStatement, 7));
+		writer.i64(sqlite3_column_int64(inStatement, 8));
+	}
+
+	void writeError(std::string& out, std::uint32_t inRequestID, std::string_view inMessage) {
+		WireWriter writer{ out };
+		writer.beginFrame(LookupFrameType::Error, inRequestID);
+		writer.text(inMessage);
+		writer.endFrame();
+	}
+
+	//Answers every lookup in every frame with the same status, for when they can't be looked up at all.
+	void writeUnanswered(std::string& out, std::string_view inFrames, LookupStatus inStatus) {
+		LookupFrame frame;
+		while (nextLookupFrame(inFrames, frame)) {
+			inFrames.remove_prefix(frame.length);
+			if (frame.type != LookupFrameType::Lookup || frame.body.size() < 2) {
+				writeError(out, frame.requestID, "Expected a Lookup frame");
+				continue;
+			}
+			WireWriter writer{ out };
+			writer.beginFrame(LookupFrameType::Results, frame.requestID);
+			const std::uint16_t count{ WireReader{ frame.body }.u16() };
+			writer.u16(count);
+			for (std::uint16_t i = 0; i < count; ++i) writer.u8(static_cast<std::uint8_t>(inStatus));
+			writer.endFrame();
+		}
+	}
+
+}
+
+
+LookupServer::LookupServer(LookupServerOptions inOptions, ConnectionPool& inPool)
+	: m_options{ std::move(inOptions) }, m_pool{ inPool }, m_admission{ m_options.admission } {}
+
+
+LookupServer::Stats LookupServer::stats() const {
+	std::lock_guard lock{ m_statsMutex };
+	return m_stats;
+}
+
+
+//Looks up every key in every frame, all in one read transaction, so that the whole batch sees the database as it was at one moment, and
+//SQLite takes its shared lock once rather than once per lookup.
+std::string LookupServer::answerBatch(const std::string& inFrames, BatchCounts& counts) {
+	if (m_options.onBatch) m_options.onBatch();
+	std::string output;
+	ConnectionPool::Lease connection{ m_pool.acquire() };
+	sqlite3* db{ connection.get() };
+	sqlite3_stmt* byShortName{ connection.statement(selectByShortName) };
+	sqlite3_stmt* byID{ connection.statement(selectByID) };
+	if (sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK) throw std::runtime_error{ "Error beginning transaction: " + std::string{ sqlite3_errmsg(db) } };
+
+	std::string_view frames{ inFrames };
+	LookupFrame frame;
+	while (nextLookupFrame(frames, frame)) {
+		frames.remove_prefix(frame.length);
+		++counts.frames;
+		std::vector<LookupKey> keys;
+		try {
+			if (frame.type != LookupFrameType::Lookup) throw std::invalid_argument{ "Expected a Lookup frame" };
+			keys = readLookupRequest(frame.body);
+		}
+		catch (std::invalid_argument& e) {
+			++counts.badFrames;
+			writeError(output, frame.requestID, e.what());
+			continue;
+		}
+
+		WireWriter writer{ output };
+		writer.beginFrame(LookupFrameType::Results, frame.requestID);
+		writer.u16(static_cast<std::uint16_t>(keys.size()));
+		for (const auto& key : keys) {
+			sqlite3_stmt* statement{ key.kind == LookupKeyKind::ShortName ? byShortName : byID };
+			if (key.kind == LookupKeyKind::ShortName) sqlite3_bind_text(statement, 1, key.shortName.data(), static_cast<int>(key.shortName.size()), SQLITE_STATIC);
+			else sqlite3_bind_int64(statement, 1, key.customerID);
+
+			const int stepStatus{ sqlite3_step(statement) };
+			if (stepStatus == SQLITE_ROW) {
+				writer.u8(static_cast<std::uint8_t>(LookupStatus::Found));
+				writeCustomerColumns(writer, statement);
+				++counts.found;
+			}
+			else writer.u8(static_cast<std::uint8_t>(stepStatus == SQLITE_DONE ? LookupStatus::NotFound : LookupStatus::Failed));
+			sqlite3_reset(statement);
+			++counts.lookups;
+		}
+		writer.endFrame();
+	}
+
+	sqlite3_exec(db, "COMMIT TRANSACTION", NULL, NULL, NULL);
+	return output;
+}
+
+
+#ifndef __linux__
+
+LookupServer::~LookupServer() {}
+void LookupServer::listen() { throw std::runtime_error{ "The lookup server is only available on Linux" }; }
+void LookupServer::run() { throw std::runtime_error{ "The lookup server is only available on Linux" }; }
+void LookupServer::stop() {}
+
+#else
+
+LookupServer::~LookupServer() {
+	m_admission.stop();
+	for (auto& [fd, connection] : m_connections) ::close(fd);
+	if (m_listenFd >= 0) {
+		::close(m_listenFd);
+		::unlink(m_options.socketPath.c_str());
+	}
+	if (m_wakeFd >= 0) ::close(m_wakeFd);
+	if (m_epollFd >= 0) ::close(m_epollFd);
+}
+
+
+void LookupServer::listen() {
+	auto fail{ [&](const std::string& inWhat) { throw std::runtime_error{ inWhat + ": " + std::strerror(errno) }; } };
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (m_options.socketPath.empty() || m_options.socketPath.size() >= sizeof(address.sun_path)) throw std::runtime_error{ "Socket path is empty or too long: " + m_options.socketPath };
+	std::memcpy(address.sun_path, m_options.socketPath.c_str(), m_options.socketPath.size() + 1);
+
+	//A socket file can outlive its server, if that was killed, and would stop us binding. We only remove it if nothing answers on it.
+	const int probe{ ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) };
+	if (probe >= 0) {
+		const bool answered{ ::connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 };
+		const bool stale{ !answered && errno == ECONNREFUSED };
+		::close(probe);
+		if (answered) throw std::runtime_error{ "Another server is already answering on " + m_options.socketPath };
+		if (stale) ::unlink(m_options.socketPath.c_str());
+	}
+
+	m_listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_listenFd < 0) fail("Error creating socket");
+	if (::bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+		const int bindError{ errno };
+		::close(m_listenFd);
+		m_listenFd = -1;
+		errno = bindError;
+		fail("Error binding to " + m_options.socketPath);
+	}
+	if (::listen(m_listenFd, SOMAXCONN) < 0) fail("Error listening");
+
+	m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+	m_wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_epollFd < 0 || m_wakeFd < 0) fail("Error setting up the event loop");
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.fd = m_listenFd;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+	event.data.fd = m_wakeFd;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+}
+
+
+void LookupServer::run() {
+	if (m_listenFd < 0) listen();
+	StopSignalScope stopSignals{ m_wakeFd };
+
+	constexpr int maxEvents{ 64 };
+	epoll_event events[maxEvents];
+	while (!m_stopping && !stopSignals.signalled()) {
+		const int ready{ ::epoll_wait(m_epollFd, events, maxEvents, -1) };
+		if (ready < 0 && errno != EINTR) break;
+
+		for (int i = 0; i < ready; ++i) {
+			const int fd{ events[i].data.fd };
+			if (fd == m_listenFd) acceptConnections();
+			else if (fd == m_wakeFd) {
+				std::uint64_t count;
+				while (::read(m_wakeFd, &count, sizeof(count)) > 0) {}
+				takeCompletions();
+			}
+			else {
+				auto connection{ m_connections.find(fd) };
+				if (connection == m_connections.end()) continue;
+				if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+					closeConnection(fd);
+					continue;
+				}
+				if (events[i].events & EPOLLOUT) flush(fd, connection->second);
+				connection = m_connections.find(fd);
+				if (connection != m_connections.end() && (events[i].events & EPOLLIN)) readFrom(fd, connection->second);
+			}
+		}
+	}
+
+	m_admission.stop();
+	while (!m_connections.empty()) closeConnection(m_connections.begin()->first);
+	::close(m_listenFd);
+	m_listenFd = -1;
+	::unlink(m_options.socketPath.c_str());
+}
+
+
+void LookupServer::stop() {
+	m_stopping = true;
+	wake();
+}
+
+
+void LookupServer::wake() {
+	const std::uint64_t one{ 1 };
+	[[maybe_unused]] auto written{ ::write(m_wakeFd, &one, sizeof(one)) };
+}
+
+
+void LookupServer::acceptConnections() {
+	while (true) {
+		const int fd{ ::accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) };
+		if (fd < 0) return;
+		if (m_connections.size() >= m_options.maxConnections) {
+			::close(fd);
+			continue;
+		}
+
+		Connection& connection{ m_connections[fd] };
+		connection.id = m_nextConnectionID++;
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = fd;
+		::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event);
+		std::lock_guard lock{ m_statsMutex };
+		++m_stats.connectionsAccepted;
+		m_stats.connectionsOpen = m_connections.size();
+	}
+}
+
+
+void LookupServer::readFrom(int fd, Connection& connection) {
+	char buffer[65536];
+	while (connection.input.size() < m_options.maxBufferedBytes) {
+		const ssize_t received{ ::recv(fd, buffer, sizeof(buffer), 0) };
+		if (received > 0) {
+			connection.input.append(buffer, static_cast<std::size_t>(received));
+			continue;
+		}
+		if (received < 0 && errno == EINTR) continue;
+		if (received == 0) {
+			//The client has finished sending, but may still want the answers to what it sent. dispatch() hangs up once they're delivered.
+			connection.inputClosed = true;
+			break;
+		}
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			closeConnection(fd);
+			return;
+		}
+		break;
+	}
+	dispatch(fd, connection);
+	updateInterest(fd, connection);
+}
+
+
+//Hands every complete frame which has arrived to a worker as one batch, unless the connection's last batch is still being answered, or
+//it hasn't read the answers yet.
+void LookupServer::dispatch(int fd, Connection& connection) {
+	if (connection.busy || connection.closeAfterWrite || connection.output.size() - connection.outputSent >= m_options.maxBufferedBytes) return;
+
+	std::size_t batchLength{ 0 };
+	LookupFrame frame;
+	try {
+		while (nextLookupFrame(std::string_view{ connection.input }.substr(batchLength), frame)) batchLength += frame.length;
+	}
+	catch (std::invalid_argument& e) {
+		//We can't tell where the next frame would start, so answer what came before this one and then hang up.
+		{
+			std::lock_guard lock{ m_statsMutex };
+			++m_stats.badFrames;
+		}
+		//The error mustn't overtake the answers to the frames before it, so if there are any it waits until they've been written.
+		writeError(batchLength == 0 ? connection.output : connection.afterBatch, 0, e.what());
+		connection.closeAfterWrite = true;
+		connection.input.resize(batchLength);
+		if (batchLength == 0) {
+			flush(fd, connection);
+			return;
+		}
+	}
+	if (batchLength == 0) {
+		//A client which has stopped sending and has had every answer is done with us. Anything left over is part of a frame which can never be finished.
+		if (connection.inputClosed && connection.outputSent == connection.output.size()) closeConnection(fd);
+		return;
+	}
+
+	std::string frames{ connection.input.substr(0, batchLength) };
+	connection.input.erase(0, batchLength);
+	connection.busy = true;
+
+	const std::uint64_t connectionID{ connection.id };
+	auto job{ [this, fd, connectionID, frames] {
+		BatchCounts counts;
+		std::string output;
+		try {
+			output = answerBatch(frames, counts);
+		}
+		catch (std::exception&) {
+			//Most likely the database was locked for longer than the busy timeout. Each lookup is answered Failed, so the client can retry.
+			output.clear();
+			writeUnanswered(output, frames, LookupStatus::Failed);
+		}
+		{
+			std::lock_guard lock{ m_statsMutex };
+			++m_stats.batches;
+			m_stats.frames += counts.frames;
+			m_stats.lookups += counts.lookups;
+			m_stats.found += counts.found;
+			m_stats.badFrames += counts.badFrames;
+		}
+		{
+			std::lock_guard lock{ m_completionsMutex };
+			m_completions.push_back({ fd, connectionID, std::move(output) });
+		}
+		wake();
+	} };
+
+	if (!m_admission.submit(RequestCost::Cheap, std::move(job))) {
+		connection.busy = false;
+		std::size_t rejected{ 0 };
+		for (std::string_view remaining{ frames }; nextLookupFrame(remaining, frame); remaining.remove_prefix(frame.length)) ++rejected;
+		{
+			std::lock_guard lock{ m_statsMutex };
+			m_stats.framesRejected += rejected;
+		}
+		writeUnanswered(connection.output, frames, LookupStatus::Busy);
+		connection.output += connection.afterBatch;
+		connection.afterBatch.clear();
+		flush(fd, connection);
+	}
+}
+
+
+void LookupServer::flush(int fd, Connection& connection) {
+	while (connection.outputSent < connection.output.size()) {
+		const ssize_t sent{ ::send(fd, connection.output.data() + connection.outputSent, connection.output.size() - connection.outputSent, MSG_NOSIGNAL) };
+		if (sent > 0) {
+			connection.outputSent += static_cast<std::size_t>(sent);
+			continue;
+		}
+		if (errno == EINTR) continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			updateInterest(fd, connection);
+			return;
+		}
+		closeConnection(fd);
+		return;
+	}
+
+	connection.output.clear();
+	connection.outputSent = 0;
+	if (connection.closeAfterWrite && !connection.busy) {
+		closeConnection(fd);
+		return;
+	}
+	dispatch(fd, connection);
+	updateInterest(fd, connection);
+}
+
+
+void LookupServer::updateInterest(int fd, const Connection& connection) {
+	auto found{ m_connections.find(fd) };
+	if (found == m_connections.end() || &found->second != &connection) return;		//Closed while we were working on it.
+	epoll_event event{};
+	event.data.fd = fd;
+	if (connection.outputSent < connection.output.size()) event.events |= EPOLLOUT;
+	if (connection.input.size() < m_options.maxBufferedBytes && !connection.closeAfterWrite && !connection.inputClosed) event.events |= EPOLLIN;
+	::epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+
+void LookupServer::closeConnection(int fd) {
+	::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	::close(fd);
+	m_connections.erase(fd);
+	std::lock_guard lock{ m_statsMutex };
+	m_stats.connectionsOpen = m_connections.size();
+}
+
+
+void LookupServer::takeCompletions() {
+	std::vector<Completion> completions;
+	{
+		std::lock_guard lock{ m_completionsMutex };
+		completions.swap(m_completions);
+	}
+	for (auto& completion : completions) {
+		auto connection{ m_connections.find(completion.fd) };
+		if (connection == m_connections.end() || connection->second.id != completion.connectionID) continue;
+		connection->second.busy = false;
+		connection->second.output += completion.output;
+		connection->second.output += connection->second.afterBatch;
+		connection->second.afterBatch.clear();
+		flush(completion.fd, connection->second);
+	}
+}
+
+#endif
@@ -0,0 +1,120 @@
+#pragma once
+
+//Standard library includes
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Project includes
+#include "AdmissionControl.h"
+#include "ConnectionPool.h"
+
+
+//Serves customer lookups over a Unix socket, in the binary protocol described in LookupProtocol.h.
+//
+//This is built the same way as the HTTP server (see HttpServer.h): one thread runs an epoll loop over non-blocking sockets, and the lookups
+//themselves run on an AdmissionController's workers, each with a connection from the pool. What's different is that a connection may have
+//any number of requests in flight. While its last batch is being answered we carry on reading, and once the answers are sent every frame
+//which has arrived in the meantime goes to a worker as the next batch, to be answered in one read transaction with statements which stay
+//prepared on the worker's connection. So the busier a client keeps its connection, the less each lookup costs.
+//
+//Unix sockets are only reachable from this machine, and only by users the socket file's permissions allow, so there's no authentication.
+//This uses epoll, so the server is only available on Linux. Elsewhere run() throws.
+
+struct LookupServerOptions {
+	std::string socketPath{ "Customers.sock" };
+	AdmissionController::Limits admission;				//Every batch of lookups is Cheap, so only the cheap limits matter.
+	std::size_t maxConnections{ 1024 };
+	std::size_t maxBufferedBytes{ 4 << 20 };			//We stop reading from a connection with this much waiting to be answered or sent.
+	std::function<void()> onBatch;						//Called on the worker before each batch, if set, e.g. to hold off maintenance.
+};
+
+class LookupServer {
+public:
+	struct Stats {
+		std::size_t connectionsAccepted{ 0 };
+		std::size_t connectionsOpen{ 0 };
+		std::size_t batches{ 0 };						//Each a set of frames answered together by one worker.
+		std::size_t frames{ 0 };
+		std::size_t lookups{ 0 };
+		std::size_t found{ 0 };
+		std::size_t framesRejected{ 0 };				//Answered Busy, as admission control turned their batch away.
+		std::size_t badFrames{ 0 };
+	};
+
+	LookupServer(LookupServerOptions inOptions, ConnectionPool& inPool);
+	~LookupServer();
+	LookupServer(const LookupServer&) = delete;
+	LookupServer& operator=(const LookupServer&) = delete;
+
+	//Creates the socket. A socket file left by a server which is no longer running is replaced, but if another server is answering on it,
+	//this throws std::runtime_error, as it does for any other failure.
+	void listen();
+	const std::string& socketPath() const { return m_options.socketPath; }
+
+	//Runs the event loop on the calling thread until stop() is called, or the process is sent SIGINT or SIGTERM. The socket file is
+	//removed before it returns.
+	void run();
+	//Asks run() to return. Safe to call from any thread.
+	void stop();
+
+	Stats stats() const;
+
+private:
+	struct Connection {
+		std::uint64_t id;
+		std::string input;
+		std::string output;
+		std::size_t outputSent{ 0 };
+		std::string afterBatch;							//Sent once the batch in progress is answered, e.g. the error for a bad frame after it.
+		bool busy{ false };								//A batch from this connection is queued or running.
+		bool closeAfterWrite{ false };
+		bool inputClosed{ false };						//The client has shut down its side, so nothing more will arrive.
+	};
+
+	struct Completion {
+		int fd;
+		std::uint64_t connectionID;
+		std::string output;
+	};
+
+	struct BatchCounts {
+		std::size_t frames{ 0 };
+		std::size_t lookups{ 0 };
+		std::size_t found{ 0 };
+		std::size_t badFrames{ 0 };
+	};
+
+	void acceptConnections();
+	void readFrom(int fd, Connection& connection);
+	void dispatch(int fd, Connection& connection);
+	void flush(int fd, Connection& connection);
+	void updateInterest(int fd, const Connection& connection);
+	void closeConnection(int fd);
+	void takeCompletions();
+	void wake();
+	std::string answerBatch(const std::string& inFrames, BatchCounts& counts);
+
+	LookupServerOptions m_options;
+	ConnectionPool& m_pool;
+	AdmissionController m_admission;
+
+	int m_listenFd{ -1 };
+	int m_epollFd{ -1 };
+	int m_wakeFd{ -1 };
+	std::atomic<bool> m_stopping{ false };
+
+	std::unordered_map<int, Connection> m_connections;		//Keyed on socket. Only touched by the loop thread.
+	std::uint64_t m_nextConnectionID{ 1 };
+
+	std::mutex m_completionsMutex;
+	std::vector<Completion> m_completions;
+
+	mutable std::mutex m_statsMutex;
+	Stats m_stats;
+};
@@ -0,0 +1,197 @@
+//Standard library includes
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+
+//Project includes
+#include "Maintenance.h"
+#include "PreparedStatement.h"
+#include "SqlFunctions.h"
+#include "ConnectionStatus.h"
+
+namespace {
+
+	//The tables we keep statistics fresh for.
+	constexpr const char* maintainedTables[]{ "Customers", "CustomerAddress", "CustomerNameTrigrams" };
+
+	bool isBusy(int status) {
+		return status == SQLITE_BUSY || status == SQLITE_LOCKED;
+	}
+
+	//Reads a single integer, e.g. from a PRAGMA. Returns -1 if the statement gives no rows.
+	sqlite3_int64 selectInteger(sqlite3* db, const std::string& inStatement) {
+		PreparedStatement select{ db, inStatement };
+		return select.stepRow() ? sqlite3_column_int64(select.get(), 0) : -1;
+	}
+
+}
+
+
+MaintenanceScheduler::MaintenanceScheduler(std::string inDatabasePath, Settings inSettings) : m_databasePath{ std::move(inDatabasePath) }, m_settings{ inSettings } {}
+
+
+MaintenanceScheduler::~MaintenanceScheduler() {
+	{
+		std::lock_guard lock{ m_mutex };
+		m_stopping = true;
+	}
+	m_wakeUp.notify_all();
+	if (m_thread.joinable()) m_thread.join();
+	unregisterConnection(m_db);
+	sqlite3_close(m_db);
+}
+
+
+void MaintenanceScheduler::start() {
+	if (sqlite3_open_v2(m_databasePath.c_str(), &m_db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+		std::string errorMessage{ "Error opening maintenance connection: " + std::string{ sqlite3_errmsg(m_db) } };
+		sqlite3_close(m_db);
+		m_db = nullptr;
+		throw std::runtime_error{ errorMessage };
+	}
+	//ANALYZE evaluates the expression in the credit utilisation index, so this connection needs our functions too.
+	registerSqlFunctions(m_db);
+	m_busyHandler.install(m_db);
+	//Limits how many rows of each index ANALYZE looks at, so that it stays quick on big tables. The statistics are approximate anyway.
+	sqlite3_exec(m_db, "PRAGMA analysis_limit = 1000;", NULL, NULL, NULL);
+
+	m_thread = std::thread{ &MaintenanceScheduler::run, this };
+}
+
+
+void MaintenanceScheduler::noteActivity() {
+	std::lock_guard lock{ m_mutex };
+	m_lastActivity = std::chrono::steady_clock::now();
+}
+
+
+MaintenanceScheduler::Stats MaintenanceScheduler::stats() const {
+	std::lock_guard lock{ m_mutex };
+	return m_stats;
+}
+
+
+void MaintenanceScheduler::run() {
+	registerConnection(m_db, "Background maintenance", &m_busyHandler);
+	while (waitUntilIdle()) runPass();
+}
+
+
+//Sleeps until the program has been idle for idleDelay and the next pass is due. Returns false if we're stopping instead.
+bool MaintenanceScheduler::waitUntilIdle() {
+	std::unique_lock lock{ m_mutex };
+	while (!m_stopping) {
+		const auto readyAt{ std::max(m_lastActivity + m_settings.idleDelay, m_nextPassDue) };
+		if (std::chrono::steady_clock::now() >= readyAt) return true;
+		//noteActivity() only ever pushes readyAt later, so it doesn't need to wake us. We just check again when we wake.
+		m_wakeUp.wait_until(lock, readyAt);
+	}
+	return false;
+}
+
+
+bool MaintenanceScheduler::stillIdle() const {
+	std::lock_guard lock{ m_mutex };
+	return !m_stopping && std::chrono::steady_clock::now() - m_lastActivity >= m_settings.idleDelay;
+}
+
+
+void MaintenanceScheduler::runPass() {
+	//Runs one task a step at a time until it's done, the database is busy, or the program stops being idle. Returns false in that last case.
+	auto runTask{ [&](auto step) {
+		while (true) {
+			if (!stillIdle()) return false;
+
+			StepResult result;
+			try {
+				result = step();
+			}
+			catch (std::exception& e) {
+				std::lock_guard lock{ m_mutex };
+				if (isBusy(sqlite3_errcode(m_db))) result = StepResult::Busy;
+				else {
+					m_stats.lastError = e.what();
+					return true;			//Give up on this task, but carry on with the others.
+				}
+			}
+
+			if (result == StepResult::Busy) {
+				std::lock_guard lock{ m_mutex };
+				++m_stats.stepsSkippedBusy;
+				return true;
+			}
+			if (result == StepResult::Done) return true;
+
+			std::unique_lock lock{ m_mutex };
+			m_wakeUp.wait_for(lock, m_settings.pauseBetweenSteps, [&] { return m_stopping; });
+		}
+	} };
+
+	bool completed{ runTask([&] { return optimizeStep(); }) };
+	for (const char* table : maintainedTables) {
+		completed = completed && runTask([&] { return analyzeStep(table); });
+	}
+	completed = completed && runTask([&] { return vacuumStep(); });
+
+	std::lock_guard lock{ m_mutex };
+	if (completed) {
+		++m_stats.passesCompleted;
+		m_stats.lastPass = std::chrono::system_clock::now();
+		m_nextPassDue = std::chrono::steady_clock::now() + m_settings.passInterval;
+	}
+	else ++m_stats.passesInterrupted;			//The pass is still due, so we'll start again as soon as we're next idle.
+}
+
+
+MaintenanceScheduler::StepResult MaintenanceScheduler::optimizeStep() {
+	int status{ sqlite3_exec(m_db, "PRAGMA optimize;", NULL, NULL, NULL) };
+	if (isBusy(status)) return StepResult::Busy;
+	if (status != SQLITE_OK) throw std::runtime_error{ "PRAGMA optimize failed: " + std::string{ sqlite3_errmsg(m_db) } };
+
+	std::lock_guard lock{ m_mutex };
+	++m_stats.optimizeRuns;
+	return StepResult::Done;
+}
+
+
+//ANALYZEs the table if its row count has drifted far enough from the count recorded by its last ANALYZE, or if it has never been analyzed.
+MaintenanceScheduler::StepResult MaintenanceScheduler::analyzeStep(const char* inTable) {
+	sqlite3_int64 analyzedRows{ -1 };
+	if (selectInteger(m_db, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'sqlite_stat1';") > 0) {
+		PreparedStatement selectStat{ m_db, "SELECT stat FROM sqlite_stat1 WHERE tbl = ? LIMIT 1;" };
+		sqlite3_bind_text(selectStat.get(), 1, inTable, -1, SQLITE_STATIC);
+		//The first number in the stat column is the number of rows in the table when it was analyzed.
+		if (selectStat.stepRow()) analyzedRows = std::atoll(selectStat.columnText(0).c_str());
+	}
+	//COUNT(*) walks the table's smallest index rather than the table, so this is cheap next to the ANALYZE it saves.
+	const sqlite3_int64 currentRows{ selectInteger(m_db, "SELECT COUNT(*) FROM \"" + std::string{ inTable } + "\";") };
+
+	if (analyzedRows >= 0 && std::llabs(currentRows - analyzedRows) <= m_settings.analyzeDriftRatio * std::max<sqlite3_int64>(analyzedRows, 1)) return StepResult::Done;
+
+	int status{ sqlite3_exec(m_db, ("ANALYZE \"" + std::string{ inTable } + "\";").c_str(), NULL, NULL, NULL) };
+	if (isBusy(status)) return StepResult::Busy;
+	if (status != SQLITE_OK) throw std::runtime_error{ "ANALYZE failed: " + std::string{ sqlite3_errmsg(m_db) } };
+
+	std::lock_guard lock{ m_mutex };
+	++m_stats.tablesAnalyzed;
+	return StepResult::Done;
+}
+
+
+//Frees up to vacuumPagesPerStep pages. Returns MoreToDo while there are still free pages left.
+MaintenanceScheduler::StepResult MaintenanceScheduler::vacuumStep() {
+	//Without auto_vacuum = INCREMENTAL, incremental_vacuum does nothing, and we'd loop here forever waiting for the free list to shrink.
+	if (selectInteger(m_db, "PRAGMA auto_vacuum;") != 2) return StepResult::Done;
+
+	const sqlite3_int64 freePages{ selectInteger(m_db, "PRAGMA freelist_count;") };
+	if (freePages <= 0) return StepResult::Done;
+
+	int status{ sqlite3_exec(m_db, ("PRAGMA incremental_vacuum(" + std::to_string(m_settings.vacuumPagesPerStep) + ");").c_str(), NULL, NULL, NULL) };
+	if (isBusy(status)) return StepResult::Busy;
+	if (status != SQLITE_OK) throw std::runtime_error{ "Incremental vacuum failed: " + std::string{ sqlite3_errmsg(m_db) } };
+
+	const sqlite3_int64 remainingPages{ selectInteger(m_db, "PRAGMA freelist_count;") };
+	std::lock_guard lock{ m_mutex };
+	m_stats.pagesVacuumed += static_cast<std::size_t>(std::max<sqlite3_int64>(freePages - remainingPages, 0));
+	return remainingPages > 0 && remainingPages < freePages ? StepResult::MoreToDo : StepResult::Done;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "BusyHandler.h"
+
+
+//Keeps the database tidy in the background while nobody is using it. Deletes leave free pages behind, and bulk loads and churn leave the query
+//planner's statistics out of date, so every so often (once the program has been idle for a while) a pass is made which:
+//	- runs PRAGMA optimize, which re-analyzes anything SQLite thinks has changed enough to need it,
+//	- ANALYZEs any of our tables whose row count has drifted well away from the one recorded in sqlite_stat1, and
+//	- returns free pages to the file system with PRAGMA incremental_vacuum (the database is switched to auto_vacuum = INCREMENTAL by a migration).
+//Each of these is done in small steps, and the idle check is repeated before each step, so as soon as the user does something the pass stops
+//and picks up again next time. The scheduler uses its own connection, with a short busy handler timeout so it gives way rather than waits.
+class MaintenanceScheduler {
+public:
+	struct Settings {
+		std::chrono::seconds idleDelay{ 30 };				//How long the program must have been idle before we start.
+		std::chrono::minutes passInterval{ 10 };			//How long to leave between complete passes.
+		int vacuumPagesPerStep{ 256 };						//Pages freed per incremental_vacuum step. At 4KB a page that's 1MB.
+		std::chrono::milliseconds pauseBetweenSteps{ 50 };	//Breathing space between steps, so other connections get a look in.
+		double analyzeDriftRatio{ 0.25 };					//ANALYZE a table once its row count is this far from its last ANALYZE.
+	};
+
+	//Counters shown in the maintenance status report.
+	struct Stats {
+		std::size_t passesCompleted{ 0 };
+		std::size_t passesInterrupted{ 0 };
+		std::size_t optimizeRuns{ 0 };
+		std::size_t tablesAnalyzed{ 0 };
+		std::size_t pagesVacuumed{ 0 };
+		std::size_t stepsSkippedBusy{ 0 };					//Steps which found the database locked, and were left for next time.
+		std::string lastError;
+		std::chrono::system_clock::time_point lastPass{};
+	};
+
+	MaintenanceScheduler(std::string inDatabasePath, Settings inSettings);
+	explicit MaintenanceScheduler(std::string inDatabasePath) : MaintenanceScheduler{ std::move(inDatabasePath), Settings{} } {}
+	~MaintenanceScheduler();
+	MaintenanceScheduler(const MaintenanceScheduler&) = delete;
+	MaintenanceScheduler& operator=(const MaintenanceScheduler&) = delete;
+
+	//Opens the scheduler's connection and starts its thread. Throws std::runtime_error if the database can't be opened.
+	void start();
+
+	//Tells the scheduler the program is in use, which holds off (or interrupts) maintenance for another idleDelay.
+	void noteActivity();
+
+	Stats stats() const;
+	const Settings& settings() const { return m_settings; }
+
+private:
+	enum class StepResult { Done, MoreToDo, Busy };
+
+	void run();
+	bool waitUntilIdle();
+	bool stillIdle() const;
+	void runPass();
+	StepResult optimizeStep();
+	StepResult analyzeStep(const char* inTable);
+	StepResult vacuumStep();
+
+	std::string m_databasePath;
+	Settings m_settings;
+	sqlite3* m_db{ nullptr };
+	//We would rather skip a step than hold anyone up, so we don't wait long for locks.
+	BusyHandler m_busyHandler{ { std::chrono::milliseconds{ 1 }, std::chrono::milliseconds{ 20 }, std::chrono::milliseconds{ 100 } } };
+	std::thread m_thread;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	bool m_stopping{ false };
+	std::chrono::steady_clock::time_point m_lastActivity{ std::chrono::steady_clock::now() };
+	std::chrono::steady_clock::time_point m_nextPassDue{ std::chrono::steady_clock::now() };
+	Stats m_stats;
+};
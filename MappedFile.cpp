@@ -0,0 +1,81 @@
+//Standard library includes
+#include <stdexcept>
+
+//Platform includes
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Project includes
+#include "MappedFile.h"
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& inPath) {
+	HANDLE file{ CreateFileA(inPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL) };
+	if (file == INVALID_HANDLE_VALUE) throw std::runtime_error{ "Could not open " + inPath };
+	m_fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error{ "Could not read the size of " + inPath };
+	}
+	m_size = static_cast<std::size_t>(fileSize.QuadPart);
+	if (m_size == 0) return;		//Windows won't map an empty file, and there's nothing to map anyway.
+
+	m_mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mappingHandle) m_data = static_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data) {
+		if (m_mappingHandle) CloseHandle(m_mappingHandle);
+		CloseHandle(file);
+		throw std::runtime_error{ "Could not map " + inPath + " into memory" };
+	}
+}
+
+
+MappedFile::~MappedFile() {
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mappingHandle) CloseHandle(m_mappingHandle);
+	if (m_fileHandle) CloseHandle(m_fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& inPath) {
+	m_fileDescriptor = open(inPath.c_str(), O_RDONLY);
+	if (m_fileDescriptor < 0) throw std::runtime_error{ "Could not open " + inPath };
+
+	struct stat fileStatus;
+	if (fstat(m_fileDescriptor, &fileStatus) != 0) {
+		close(m_fileDescriptor);
+		throw std::runtime_error{ "Could not read the size of " + inPath };
+	}
+	m_size = static_cast<std::size_t>(fileStatus.st_size);
+	if (m_size == 0) return;
+
+	void* mapping{ mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0) };
+	if (mapping == MAP_FAILED) {
+		close(m_fileDescriptor);
+		throw std::runtime_error{ "Could not map " + inPath + " into memory" };
+	}
+	//We read imports from front to back, so let the kernel read ahead aggressively.
+	madvise(mapping, m_size, MADV_SEQUENTIAL);
+	m_data = static_cast<const char*>(mapping);
+}
+
+
+MappedFile::~MappedFile() {
+	if (m_data) munmap(const_cast<char*>(m_data), m_size);
+	if (m_fileDescriptor >= 0) close(m_fileDescriptor);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+
+//A read-only memory mapping of a whole file, so that large import files can be parsed in place without being copied into memory first.
+//The mapping is released when the object is destroyed. Opening or mapping the file throws std::runtime_error on failure.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& inPath);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//The file's contents. Valid for as long as this object exists.
+	std::string_view contents() const { return { m_data, m_size }; }
+
+private:
+	const char* m_data{ nullptr };
+	std::size_t m_size{ 0 };
+#ifdef _WIN32
+	void* m_fileHandle{ nullptr };
+	void* m_mappingHandle{ nullptr };
+#else
+	int m_fileDescriptor{ -1 };
+#endif
+};
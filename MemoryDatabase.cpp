@@ -0,0 +1,167 @@
+//Standard library includes
+#include <stdexcept>
+
+//Project includes
+#include "MemoryDatabase.h"
+#include "ConnectionStatus.h"
+
+namespace {
+
+	//Copies the whole of one database over another in a single step.
+	void copyWholeDatabase(sqlite3* from, sqlite3* to) {
+		sqlite3_backup* backup{ sqlite3_backup_init(to, "main", from, "main") };
+		if (!backup) throw std::runtime_error{ "Error starting database copy: " + std::string{ sqlite3_errmsg(to) } };
+		int stepStatus{ sqlite3_backup_step(backup, -1) };
+		sqlite3_backup_finish(backup);
+		if (stepStatus != SQLITE_DONE) throw std::runtime_error{ "Error copying database: " + std::string{ sqlite3_errstr(stepStatus) } };
+	}
+
+	//SQLite's count of commits to the database by any connection, including this one, which PRAGMA data_version doesn't give us.
+	unsigned dataVersion(sqlite3* db) {
+		unsigned version{ 0 };
+		sqlite3_file_control(db, "main", SQLITE_FCNTL_DATA_VERSION, &version);
+		return version;
+	}
+
+}
+
+
+MemoryDatabaseSaver::MemoryDatabaseSaver(sqlite3* inMemoryDb, std::string inPath, std::chrono::seconds inInterval) : m_memoryDb{ inMemoryDb }, m_path{ std::move(inPath) }, m_interval{ inInterval } {}
+
+
+MemoryDatabaseSaver::~MemoryDatabaseSaver() {
+	try {
+		stop();
+	}
+	catch (std::exception&) {}		//Nothing more we can do about it here. Callers who care call stop() themselves.
+}
+
+
+void MemoryDatabaseSaver::start() {
+	if (sqlite3_open_v2(m_path.c_str(), &m_fileDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK) {
+		std::string errorMessage{ "Error opening " + m_path + " to save to: " + sqlite3_errmsg(m_fileDb) };
+		sqlite3_close(m_fileDb);
+		m_fileDb = nullptr;
+		throw std::runtime_error{ errorMessage };
+	}
+	//Something else may have the file open as we start. We give it a few seconds to finish with it.
+	m_busyHandler.install(m_fileDb);
+	registerConnection(m_fileDb, "In-memory database file", &m_busyHandler);
+
+	//Every save copies over the whole file, so if anything else could write to it between saves, we'd silently throw its changes away. In
+	//exclusive locking mode, SQLite keeps a write lock until the connection is closed, so one exclusive transaction, even one which writes
+	//nothing, is enough to take the file for ourselves for the rest of the session. Doing this before loading means nothing can sneak in between the two.
+	try {
+		if (sqlite3_exec(m_fileDb, "PRAGMA locking_mode = EXCLUSIVE; BEGIN EXCLUSIVE TRANSACTION; COMMIT TRANSACTION;", NULL, NULL, NULL) != SQLITE_OK) {
+			throw std::runtime_error{ "Error locking " + m_path + ", which may be in use by another copy of the program: " + sqlite3_errmsg(m_fileDb) };
+		}
+		copyWholeDatabase(m_fileDb, m_memoryDb);
+	}
+	catch (std::exception&) {
+		unregisterConnection(m_fileDb);
+		sqlite3_close(m_fileDb);
+		m_fileDb = nullptr;
+		throw;
+	}
+
+	//What was just loaded doesn't need saving again.
+	m_savedDataVersion = dataVersion(m_memoryDb);
+
+	if (m_interval.count() > 0 && sqlite3_db_mutex(m_memoryDb)) m_thread = std::thread{ &MemoryDatabaseSaver::run, this };
+}
+
+
+void MemoryDatabaseSaver::stop() {
+	if (m_thread.joinable()) {
+		{
+			std::lock_guard lock{ m_mutex };
+			m_stopping = true;
+		}
+		m_wakeUp.notify_all();
+		m_thread.join();
+	}
+	if (!m_fileDb) return;
+
+	//The main thread is the one stopping us, so it can't be part way through a transaction of its own. One left open by custom SQL is
+	//rolled back, as it would have been if the program exited with the database on disk.
+	if (!sqlite3_get_autocommit(m_memoryDb)) sqlite3_exec(m_memoryDb, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+	//The file connection goes either way, so stopping twice (e.g. again from the destructor) does nothing.
+	auto closeFile{ [this] {
+		unregisterConnection(m_fileDb);
+		sqlite3_close(m_fileDb);
+		m_fileDb = nullptr;
+	} };
+	try {
+		save();
+	}
+	catch (std::exception&) {
+		closeFile();
+		throw;
+	}
+	closeFile();
+}
+
+
+MemoryDatabaseSaver::Stats MemoryDatabaseSaver::stats() const {
+	std::lock_guard lock{ m_mutex };
+	return m_stats;
+}
+
+
+void MemoryDatabaseSaver::run() {
+	std::unique_lock lock{ m_mutex };
+	auto waitFor{ m_interval };
+	while (!m_wakeUp.wait_for(lock, waitFor, [&] { return m_stopping; })) {
+		lock.unlock();
+		SaveResult result{ SaveResult::Unchanged };
+		std::string error;
+		try {
+			result = save();
+		}
+		catch (std::exception& e) {
+			error = e.what();
+		}
+		lock.lock();
+
+		if (!error.empty()) m_stats.lastError = error;
+		if (result == SaveResult::Unchanged) ++m_stats.skippedUnchanged;
+		//A transaction is normally over in moments, so rather than wait a whole interval we look again shortly.
+		if (result == SaveResult::InTransaction) ++m_stats.retriedInTransaction;
+		waitFor = result == SaveResult::InTransaction ? std::chrono::seconds{ 1 } : m_interval;
+	}
+}
+
+
+//Copies the in-memory database over the file, if anything has been committed since the last save. Throws std::runtime_error if the copy fails.
+MemoryDatabaseSaver::SaveResult MemoryDatabaseSaver::save() {
+	//Holding the connection's mutex keeps every other thread's calls on it waiting until we're done, so nothing can start or change a
+	//transaction under us. The mutex is recursive, so the calls we make ourselves still go through.
+	sqlite3_mutex* dbMutex{ sqlite3_db_mutex(m_memoryDb) };
+	sqlite3_mutex_enter(dbMutex);
+	if (!sqlite3_get_autocommit(m_memoryDb)) {
+		sqlite3_mutex_leave(dbMutex);
+		return SaveResult::InTransaction;
+	}
+	const unsigned version{ dataVersion(m_memoryDb) };
+	if (version == m_savedDataVersion) {
+		sqlite3_mutex_leave(dbMutex);
+		return SaveResult::Unchanged;
+	}
+
+	const auto started{ std::chrono::steady_clock::now() };
+	try {
+		copyWholeDatabase(m_memoryDb, m_fileDb);
+	}
+	catch (std::exception&) {
+		sqlite3_mutex_leave(dbMutex);
+		throw;
+	}
+	sqlite3_mutex_leave(dbMutex);
+	m_savedDataVersion = version;
+
+	std::lock_guard lock{ m_mutex };
+	++m_stats.saves;
+	m_stats.lastSaveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	m_stats.lastSave = std::chrono::system_clock::now();
+	return SaveResult::Saved;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "BusyHandler.h"
+
+
+//In-memory mode, for batch jobs and test runs which want the speed of a :memory: database but still want to keep their results. The database
+//file is copied into memory with the backup API at startup, everything runs against the copy, and it's copied back over the file every so often
+//and when the program exits. A crash loses whatever was done since the last save, but never leaves the file half written, as each save is one
+//journalled transaction on the file.
+//
+//Each save replaces the whole file, so anything another connection wrote to it in the meantime would be lost without a word. To stop that
+//happening, the file is locked exclusively from before it's loaded until the program exits, and nothing else - not even a reader - can open it
+//until then. If something else has the file open when we start, we wait a few seconds for it and then give up rather than work on a copy we
+//can't safely save.
+
+
+//Loads the database file into memory, and saves it back there, on a timer from a thread of its own and once more when stopped.
+//
+//A save has to see the database between transactions, so the timer thread holds the main connection's mutex for the length of the save,
+//which keeps the main thread out for that long. That mutex only exists when SQLite is in serialized mode, so in the other modes the timer
+//is left off and the database is only saved when the program exits.
+class MemoryDatabaseSaver {
+public:
+	struct Stats {
+		std::size_t saves{ 0 };
+		std::size_t skippedUnchanged{ 0 };			//Timer ticks which found nothing new to save.
+		std::size_t retriedInTransaction{ 0 };		//Timer ticks which found a transaction open, and tried again shortly after.
+		double lastSaveSeconds{ 0 };
+		std::string lastError;
+		std::chrono::system_clock::time_point lastSave{};
+	};
+
+	//An interval of zero saves only when stopped.
+	MemoryDatabaseSaver(sqlite3* inMemoryDb, std::string inPath, std::chrono::seconds inInterval);
+	~MemoryDatabaseSaver();
+	MemoryDatabaseSaver(const MemoryDatabaseSaver&) = delete;
+	MemoryDatabaseSaver& operator=(const MemoryDatabaseSaver&) = delete;
+
+	//Opens and locks the file, copies it into the in-memory database (which should be freshly opened, and is left empty if there's no file yet),
+	//and starts the timer if it can run. Throws std::runtime_error if the file can't be opened, locked or read.
+	void start();
+
+	//Stops the timer, makes a final save and closes the file. Must be called before the in-memory connection is closed. Throws std::runtime_error
+	//if the save fails, as the work since the last one would be lost.
+	void stop();
+
+	//Whether saves are being made on a timer, or only at exit.
+	bool timed() const { return m_thread.joinable(); }
+
+	Stats stats() const;
+
+private:
+	enum class SaveResult { Saved, Unchanged, InTransaction };
+
+	void run();
+	SaveResult save();
+
+	sqlite3* m_memoryDb;
+	sqlite3* m_fileDb{ nullptr };
+	BusyHandler m_busyHandler;
+	std::string m_path;
+	std::chrono::seconds m_interval;
+	unsigned m_savedDataVersion{ 0 };
+
+	std::thread m_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	bool m_stopping{ false };
+	Stats m_stats;
+};
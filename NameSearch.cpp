@@ -0,0 +1,231 @@
+//Standard library includes
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+//Project includes
+#include "NameSearch.h"
+#include "CustomerTracker.h"
+#include "PreparedStatement.h"
+#include "SqlFunctions.h"
+
+namespace {
+
+	//For each candidate customer the trigram table gives us, we pull back this many and then rank them properly on their actual names.
+	constexpr std::size_t candidatesPerResult{ 10 };
+
+	//Matches less similar than this are just noise from sharing a single letter or two, so we don't report them.
+	constexpr double minimumSimilarity{ 0.2 };
+
+
+	//Jaccard similarity of two sorted trigram sets: the number they share divided by the number in either.
+	double trigramSimilarity(const std::vector<std::string>& lhs, const std::vector<std::string>& rhs) {
+		if (lhs.empty() || rhs.empty()) return 0.0;
+		std::size_t shared{ 0 };
+		auto left{ lhs.begin() };
+		auto right{ rhs.begin() };
+		while (left != lhs.end() && right != rhs.end()) {
+			if (*left < *right) ++left;
+			else if (*right < *left) ++right;
+			else {
+				++shared;
+				++left;
+				++right;
+			}
+		}
+		return static_cast<double>(shared) / static_cast<double>(lhs.size() + rhs.size() - shared);
+	}
+
+
+	//Gathers up every name we index for a customer: their first, last and short names, their full name, and the contact names on their addresses.
+	//If outShortName is given, it is set to the customer's short name.
+	std::vector<std::string> indexedNamesOf(PreparedStatement& selectCustomer, PreparedStatement& selectContacts, int customerID, std::string* outShortName = nullptr) {
+		std::vector<std::string> names;
+
+		sqlite3_reset(selectCustomer.get());
+		sqlite3_bind_int(selectCustomer.get(), 1, customerID);
+		if (selectCustomer.stepRow()) {
+			std::string firstName{ selectCustomer.columnText(1) };
+			std::string lastName{ selectCustomer.columnText(2) };
+			names.push_back(selectCustomer.columnText(0));
+			if (outShortName) *outShortName = names.back();
+			if (!firstName.empty() && !lastName.empty()) names.push_back(firstName + ' ' + lastName);
+			names.push_back(std::move(firstName));
+			names.push_back(std::move(lastName));
+		}
+
+		sqlite3_reset(selectContacts.get());
+		sqlite3_bind_int(selectContacts.get(), 1, customerID);
+		while (selectContacts.stepRow()) names.push_back(selectContacts.columnText(0));
+
+		names.erase(std::remove_if(names.begin(), names.end(), [](const std::string& name) { return name.empty(); }), names.end());
+		return names;
+	}
+
+	const char* selectCustomerNamesStatement{ "SELECT Customer_Short_Name, First_Name, Last_Name FROM Customers WHERE Customer_ID = ?;" };
+	const char* selectContactNamesStatement{ "SELECT DISTINCT Contact_Name FROM CustomerAddress WHERE Customer_ID = ? AND Contact_Name IS NOT NULL AND Contact_Name <> '';" };
+
+}
+
+
+std::vector<std::string> nameTrigrams(std::string_view inName) {
+	std::vector<std::string> trigrams;
+	std::string word;
+	//We treat anything that isn't a letter or a number as a break between words, and pad each word with two spaces in front and one behind.
+	//This way "Smith" gives "  S", " SM", "SMI", "MIT", "ITH" and "TH ", so a match on the first letters of a name carries more weight.
+	auto addWord{ [&trigrams](const std::string& inWord) {
+		std::string padded{ "  " + inWord + " " };
+		for (std::size_t i = 0; i + 3 <= padded.size(); ++i) trigrams.push_back(padded.substr(i, 3));
+	} };
+
+	for (char c : inName) {
+		if (std::isalnum(static_cast<unsigned char>(c))) word += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		else if (!word.empty()) {
+			addWord(word);
+			word.clear();
+		}
+	}
+	if (!word.empty()) addWord(word);
+
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+	return trigrams;
+}
+
+
+double nameSimilarity(std::string_view lhs, std::string_view rhs) {
+	return trigramSimilarity(nameTrigrams(lhs), nameTrigrams(rhs));
+}
+
+
+void refreshNameTrigrams(sqlite3* db) {
+	//Nothing to do if no names have changed, and we'd rather not take a write lock to find that out.
+	if (selectCount(db, "*", "CustomerNameTrigramsPending") == 0) return;
+	//A read-only connection can't catch up, so it searches the index as it stands. Only names changed since the writer last searched are missed.
+	if (sqlite3_db_readonly(db, "main") == 1) return;
+
+	executeStatement("BEGIN IMMEDIATE TRANSACTION", db, false);
+	try {
+		std::vector<int> pendingIDs;
+		{
+			PreparedStatement selectPending{ db, "SELECT Customer_ID FROM CustomerNameTrigramsPending;" };
+			while (selectPending.stepRow()) pendingIDs.push_back(sqlite3_column_int(selectPending.get(), 0));
+		}
+
+		PreparedStatement selectCustomer{ db, selectCustomerNamesStatement };
+		PreparedStatement selectContacts{ db, selectContactNamesStatement };
+		PreparedStatement deleteTrigrams{ db, "DELETE FROM CustomerNameTrigrams WHERE Customer_ID = ?;" };
+		PreparedStatement insertTrigram{ db, "INSERT OR IGNORE INTO CustomerNameTrigrams(Trigram, Customer_ID) VALUES (?,?);" };
+
+		for (int customerID : pendingIDs) {
+			//Throw away whatever we had for this customer and index their names afresh. If the customer has been deleted, this just removes them.
+			sqlite3_reset(deleteTrigrams.get());
+			sqlite3_bind_int(deleteTrigrams.get(), 1, customerID);
+			deleteTrigrams.stepRow();
+
+			for (const auto& name : indexedNamesOf(selectCustomer, selectContacts, customerID)) {
+				for (const auto& trigram : nameTrigrams(name)) {
+					sqlite3_reset(insertTrigram.get());
+					sqlite3_bind_text(insertTrigram.get(), 1, trigram.c_str(), -1, SQLITE_TRANSIENT);
+					sqlite3_bind_int(insertTrigram.get(), 2, customerID);
+					insertTrigram.stepRow();
+				}
+			}
+		}
+
+		executeStatement("DELETE FROM CustomerNameTrigramsPending;", db, false);
+		executeStatement("COMMIT TRANSACTION", db, false);
+	}
+	catch (std::exception&) {
+		sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		throw;
+	}
+}
+
+
+std::vector<NameSearchMatch> fuzzySearchCustomers(sqlite3* db, const std::string& inSearchTerm, std::size_t maxResults) {
+	std::vector<std::string> searchTrigrams{ nameTrigrams(inSearchTerm) };
+	if (searchTrigrams.empty() || maxResults == 0) return {};
+
+	refreshNameTrigrams(db);
+
+	//First we let the trigram index find the customers who share the most trigrams with the search term.
+	//Each term in the IN list is a seek on the primary key of CustomerNameTrigrams, so we never touch customers who share nothing with it.
+	std::string placeholders;
+	for (std::size_t i = 0; i < searchTrigrams.size(); ++i) placeholders += (i == 0 ? "?" : ",?");
+	PreparedStatement selectCandidates{ db, "SELECT Customer_ID FROM CustomerNameTrigrams WHERE Trigram IN (" + placeholders + ") GROUP BY Customer_ID ORDER BY COUNT(*) DESC LIMIT ?;" };
+	for (std::size_t i = 0; i < searchTrigrams.size(); ++i) {
+		sqlite3_bind_text(selectCandidates.get(), static_cast<int>(i) + 1, searchTrigrams[i].c_str(), -1, SQLITE_TRANSIENT);
+	}
+	sqlite3_bind_int64(selectCandidates.get(), static_cast<int>(searchTrigrams.size()) + 1, static_cast<sqlite3_int64>(maxResults * candidatesPerResult));
+	std::vector<int> candidateIDs;
+	while (selectCandidates.stepRow()) candidateIDs.push_back(sqlite3_column_int(selectCandidates.get(), 0));
+
+	//Then we rank the candidates by how similar their closest name actually is to the search term.
+	PreparedStatement selectCustomer{ db, selectCustomerNamesStatement };
+	PreparedStatement selectContacts{ db, selectContactNamesStatement };
+	std::vector<NameSearchMatch> matches;
+	for (int customerID : candidateIDs) {
+		NameSearchMatch match{ customerID, {}, {}, 0.0 };
+		std::vector<std::string> names{ indexedNamesOf(selectCustomer, selectContacts, customerID, &match.shortName) };
+		if (match.shortName.empty()) continue;		//The customer was deleted since the index was last refreshed.
+
+		for (const auto& name : names) {
+			double similarity{ trigramSimilarity(searchTrigrams, nameTrigrams(name)) };
+			if (similarity > match.similarity) {
+				match.similarity = similarity;
+				match.matchedName = name;
+			}
+		}
+		if (match.similarity >= minimumSimilarity) matches.push_back(std::move(match));
+	}
+
+	std::stable_sort(matches.begin(), matches.end(), [](const NameSearchMatch& lhs, const NameSearchMatch& rhs) { return lhs.similarity > rhs.similarity; });
+	if (matches.size() > maxResults) matches.resize(maxResults);
+	return matches;
+}
+
+
+std::vector<NameSearchMatch> phoneticSearchCustomers(sqlite3* db, const std::string& inSearchTerm, std::size_t maxResults) {
+	//Work out the code of each word in the search term. Codes are what we compare, so two words which sound alike only need looking up once.
+	std::vector<std::string> searchKeys;
+	std::string word;
+	for (std::size_t i = 0; i <= inSearchTerm.size(); ++i) {
+		if (i < inSearchTerm.size() && !std::isspace(static_cast<unsigned char>(inSearchTerm[i]))) word += inSearchTerm[i];
+		else if (!word.empty()) {
+			std::string key{ phoneticKey(word) };
+			if (!key.empty() && std::find(searchKeys.begin(), searchKeys.end(), key) == searchKeys.end()) searchKeys.push_back(std::move(key));
+			word.clear();
+		}
+	}
+	if (searchKeys.empty() || maxResults == 0) return {};
+
+	//The OR across two indexed columns lets SQLite seek each index separately and merge the results, rather than scanning the table.
+	std::string placeholders;
+	for (std::size_t i = 0; i < searchKeys.size(); ++i) placeholders += (i == 0 ? "?" : ",?");
+	PreparedStatement selectMatches{ db, "SELECT Customer_ID, Customer_Short_Name, First_Name, Last_Name, First_Name_Phonetic, Last_Name_Phonetic FROM Customers "
+		"WHERE First_Name_Phonetic IN (" + placeholders + ") OR Last_Name_Phonetic IN (" + placeholders + ");" };
+	for (std::size_t i = 0; i < searchKeys.size(); ++i) {
+		sqlite3_bind_text(selectMatches.get(), static_cast<int>(i) + 1, searchKeys[i].c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text(selectMatches.get(), static_cast<int>(i + searchKeys.size()) + 1, searchKeys[i].c_str(), -1, SQLITE_TRANSIENT);
+	}
+
+	std::vector<NameSearchMatch> matches;
+	while (selectMatches.stepRow()) {
+		std::string firstName{ selectMatches.columnText(2) };
+		std::string lastName{ selectMatches.columnText(3) };
+		bool firstMatched{ std::find(searchKeys.begin(), searchKeys.end(), selectMatches.columnText(4)) != searchKeys.end() };
+		bool lastMatched{ std::find(searchKeys.begin(), searchKeys.end(), selectMatches.columnText(5)) != searchKeys.end() };
+
+		//Similarity here is the share of the words in the search term which this customer's names sound like.
+		double matchedWords{ static_cast<double>(firstMatched) + static_cast<double>(lastMatched) };
+		std::string matchedName{ firstMatched && lastMatched ? firstName + ' ' + lastName : (firstMatched ? firstName : lastName) };
+		matches.push_back({ sqlite3_column_int(selectMatches.get(), 0), selectMatches.columnText(1), std::move(matchedName), std::min(1.0, matchedWords / static_cast<double>(searchKeys.size())) });
+	}
+
+	std::stable_sort(matches.begin(), matches.end(), [](const NameSearchMatch& lhs, const NameSearchMatch& rhs) { return lhs.similarity > rhs.similarity; });
+	if (matches.size() > maxResults) matches.resize(maxResults);
+	return matches;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//A customer found by one of the approximate name searches below.
+struct NameSearchMatch {
+	int customerID;
+	std::string shortName;
+	std::string matchedName;	//The name (first, last, short or contact) which matched best.
+	double similarity;			//Between 0 and 1, where 1 is an exact match.
+};
+
+
+//----------------------------------------------------------------------------------------------------------//
+//										Trigram fuzzy matching												//
+//----------------------------------------------------------------------------------------------------------//
+//Every customer's First_Name, Last_Name, Customer_Short_Name and the Contact_Name of each of their addresses is broken into trigrams
+//(runs of three characters) which are stored in the CustomerNameTrigrams table, keyed on the trigram. A misspelled name still shares most
+//of its trigrams with the correct one, so looking up the trigrams of the search term finds the likely candidates with index seeks alone.
+//Triggers on both tables queue every customer whose names change in CustomerNameTrigramsPending, whether the change came from this program
+//or from custom SQL, and the queue is worked off before each search.
+
+//Returns the distinct trigrams of a name, in sorted order. Case and punctuation are ignored, and each word is padded so that the start
+//and end of a word count for more than the middle.
+std::vector<std::string> nameTrigrams(std::string_view inName);
+
+//How similar two names are on their trigrams, between 0 (nothing in common) and 1 (the same once case and punctuation are ignored).
+double nameSimilarity(std::string_view lhs, std::string_view rhs);
+
+//Brings the trigram index up to date with every customer queued in CustomerNameTrigramsPending. Runs in its own transaction.
+void refreshNameTrigrams(sqlite3* db);
+
+//Returns up to maxResults customers whose names are most similar to the search term, best match first.
+std::vector<NameSearchMatch> fuzzySearchCustomers(sqlite3* db, const std::string& inSearchTerm, std::size_t maxResults);
+
+
+//----------------------------------------------------------------------------------------------------------//
+//										Phonetic matching													//
+//----------------------------------------------------------------------------------------------------------//
+//Customers' first and last names have their Soundex codes stored in the indexed First_Name_Phonetic and Last_Name_Phonetic columns.
+//Searching on the codes of the words in the search term finds everyone whose name "sounds like" it, e.g. Smyth finds Smith, through index seeks alone.
+
+//Returns up to maxResults customers with a first or last name which sounds like one of the words in the search term.
+//Customers matching more of the words come first, so "John Smyth" ranks John Smith above Mary Smith.
+std::vector<NameSearchMatch> phoneticSearchCustomers(sqlite3* db, const std::string& inSearchTerm, std::size_t maxResults);
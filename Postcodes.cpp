@@ -0,0 +1,138 @@
+//Standard library includes
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+//Project includes
+#include "Postcodes.h"
+#include "CustomerTracker.h"
+#include "PreparedStatement.h"
+
+namespace {
+
+	bool isUpperLetter(char c) { return c >= 'A' && c <= 'Z'; }
+	bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	//An outward code is one or two letters, a digit, then optionally a second digit or letter. e.g. W1, W12, EC4, EC4A, SW1A.
+	bool isOutwardCode(std::string_view inToken) {
+		std::size_t letters{ 0 };
+		while (letters < inToken.size() && isUpperLetter(inToken[letters])) ++letters;
+		if (letters < 1 || letters > 2) return false;
+		std::string_view rest{ inToken.substr(letters) };
+		if (rest.empty() || rest.size() > 2 || !isDigit(rest[0])) return false;
+		return rest.size() == 1 || isDigit(rest[1]) || isUpperLetter(rest[1]);
+	}
+
+	//An inward code is a digit followed by two letters. e.g. 5GG.
+	bool isInwardCode(std::string_view inToken) {
+		return inToken.size() == 3 && isDigit(inToken[0]) && isUpperLetter(inToken[1]) && isUpperLetter(inToken[2]);
+	}
+
+	//Splits an address line into upper-case tokens, treating anything other than letters and digits as a separator.
+	std::vector<std::string> postcodeTokens(std::string_view inLine) {
+		std::vector<std::string> tokens;
+		std::string token;
+		for (char c : inLine) {
+			if (std::isalnum(static_cast<unsigned char>(c))) token += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+			else if (!token.empty()) {
+				tokens.push_back(std::move(token));
+				token.clear();
+			}
+		}
+		if (!token.empty()) tokens.push_back(std::move(token));
+		return tokens;
+	}
+
+}
+
+
+std::string extractPostcode(const std::array<std::string_view, 5>& inAddressLines) {
+	//Outward codes on their own are a weaker match than a full postcode, so we only fall back on one if there's no full postcode anywhere.
+	std::string outwardOnly;
+	for (auto line = inAddressLines.rbegin(); line != inAddressLines.rend(); ++line) {
+		std::vector<std::string> tokens{ postcodeTokens(*line) };
+		for (std::size_t i = tokens.size(); i-- > 0;) {
+			const std::string& token{ tokens[i] };
+			//Written properly, e.g. "W12 5GG".
+			if (i + 1 < tokens.size() && isOutwardCode(token) && isInwardCode(tokens[i + 1])) return token + ' ' + tokens[i + 1];
+			//Written without the space, e.g. "W125GG".
+			if (token.size() >= 5 && isInwardCode(std::string_view{ token }.substr(token.size() - 3)) && isOutwardCode(std::string_view{ token }.substr(0, token.size() - 3))) {
+				return token.substr(0, token.size() - 3) + ' ' + token.substr(token.size() - 3);
+			}
+			if (outwardOnly.empty() && isOutwardCode(token)) outwardOnly = token;
+		}
+	}
+	return outwardOnly;
+}
+
+
+std::size_t backfillPostcodes(sqlite3* db, std::size_t batchSize) {
+	//Nearly always there's nothing to do, and we'd rather not take a write lock to find that out. A read-only connection couldn't do it anyway.
+	if (sqlite3_db_readonly(db, "main") == 1) return 0;
+	{
+		PreparedStatement selectPending{ db, "SELECT EXISTS (SELECT * FROM CustomerAddress WHERE Postcode IS NULL);" };
+		if (!selectPending.stepRow() || sqlite3_column_int(selectPending.get(), 0) == 0) return 0;
+	}
+
+	//NULL postcodes are in the index like any other value, so finding the next batch is a seek rather than a scan.
+	PreparedStatement updateBatch{ db, "UPDATE CustomerAddress SET Postcode = EXTRACT_POSTCODE(Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5) "
+		"WHERE Address_ID IN (SELECT Address_ID FROM CustomerAddress WHERE Postcode IS NULL LIMIT ?);" };
+	sqlite3_bind_int64(updateBatch.get(), 1, static_cast<sqlite3_int64>(batchSize));
+
+	std::size_t processed{ 0 };
+	while (true) {
+		//Each batch is its own transaction, so a long backfill never holds the write lock for long and can be interrupted without losing earlier batches.
+		executeStatement("BEGIN IMMEDIATE TRANSACTION", db, false);
+		try {
+			sqlite3_reset(updateBatch.get());
+			updateBatch.stepRow();
+			executeStatement("COMMIT TRANSACTION", db, false);
+		}
+		catch (std::exception&) {
+			sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+			throw;
+		}
+		std::size_t batchCount{ static_cast<std::size_t>(sqlite3_changes(db)) };
+		processed += batchCount;
+		if (batchCount < batchSize) break;
+	}
+	return processed;
+}
+
+
+std::vector<PostcodeMatch> findAddressesByPostcode(sqlite3* db, const std::string& inPostcodeKey) {
+	//Tidy the key into the same form as the stored postcodes.
+	std::vector<std::string> tokens{ postcodeTokens(inPostcodeKey) };
+	std::string key;
+	for (const auto& token : tokens) key += (key.empty() ? "" : " ") + token;
+	if (key.empty()) return {};
+
+	backfillPostcodes(db);
+
+	//Postcodes in an area all start with its letters followed by a digit, and ':' is the character after '9', so [W0, W:) holds all of area W.
+	//Postcodes in a district are either the outward code alone or it followed by a space, and '!' is the character after ' ', so [W12, W12!) holds all of W12.
+	//NB: This relies on the Postcode index using the default BINARY collation.
+	std::string lowerBound;
+	std::string upperBound;
+	if (std::all_of(key.begin(), key.end(), isUpperLetter)) {
+		lowerBound = key + '0';
+		upperBound = key + ':';
+	}
+	else {
+		lowerBound = key;
+		upperBound = key + '!';
+	}
+
+	PreparedStatement selectAddresses{ db, "SELECT CustomerAddress.Address_ID, Customers.Customer_Short_Name, CustomerAddress.Address_Line_1, CustomerAddress.Postcode "
+		"FROM CustomerAddress INNER JOIN Customers ON Customers.Customer_ID = CustomerAddress.Customer_ID "
+		"WHERE CustomerAddress.Postcode >= ? AND CustomerAddress.Postcode < ? ORDER BY CustomerAddress.Postcode;" };
+	sqlite3_bind_text(selectAddresses.get(), 1, lowerBound.c_str(), -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(selectAddresses.get(), 2, upperBound.c_str(), -1, SQLITE_TRANSIENT);
+
+	std::vector<PostcodeMatch> matches;
+	while (selectAddresses.stepRow()) {
+		matches.push_back({ sqlite3_column_int(selectAddresses.get(), 0), selectAddresses.columnText(1), selectAddresses.columnText(2), selectAddresses.columnText(3) });
+	}
+	return matches;
+}
+
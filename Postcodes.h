@@ -0,0 +1,42 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Addresses are stored as five free-form lines, so the postcode could be on any of them. To let us find addresses by postcode without
+//scanning all five lines of every address, the postcode is extracted into the indexed CustomerAddress.Postcode column whenever an address
+//is written. Postcodes are stored in the normal UK form of outward code, space, inward code (e.g. "W12 5GG"), or just the outward code
+//(e.g. "EC4") where that's all the address gives us. Addresses with no recognisable postcode store an empty string, leaving NULL to mean
+//"not yet processed" for the backfill job below.
+
+
+//Finds the postcode in a set of address lines and returns it in normalised form, or an empty string if there isn't one.
+//Lines are checked from last to first, as that's where the postcode is usually written.
+std::string extractPostcode(const std::array<std::string_view, 5>& inAddressLines);
+
+//Fills in the postcode of every address which hasn't had one extracted yet, in batches of batchSize addresses per transaction.
+//This can be stopped and started at any point, as each batch is committed before the next is started. Returns the number of addresses processed.
+//It's called before anything which reads postcodes, and does nothing (without taking a write lock) if there are none to fill in, or if the
+//connection is read-only.
+std::size_t backfillPostcodes(sqlite3* db, std::size_t batchSize = 5000);
+
+
+//An address found by findAddressesByPostcode().
+struct PostcodeMatch {
+	int addressID;
+	std::string shortName;
+	std::string addressLine1;
+	std::string postcode;
+};
+
+//Returns every address in a postcode area (e.g. "W" or "EC"), district (e.g. "W12") or full postcode (e.g. "W12 5GG"), in postcode order.
+//Whichever is given, this is a single range scan on the Postcode index. Any postcodes not yet extracted are filled in first.
+std::vector<PostcodeMatch> findAddressesByPostcode(sqlite3* db, const std::string& inPostcodeKey);
@@ -0,0 +1,45 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <stdexcept>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//A small wrapper around a prepared statement handle, so that the statement is always finalised - even if we throw part way through using it.
+//This is used by the newer parts of the program which hold several statements open at once, where finalising each one by hand on every error path gets unwieldy.
+class PreparedStatement {
+public:
+	PreparedStatement(sqlite3* db, const std::string& inStatement) : m_db{ db } {
+		if (sqlite3_prepare_v2(db, inStatement.c_str(), -1, &m_handle, NULL) != SQLITE_OK) {
+			std::string errorMessage{ "Error preparing statement: " + std::string{sqlite3_errmsg(db)} };
+			sqlite3_finalize(m_handle);
+			throw std::runtime_error{ errorMessage };
+		}
+	}
+	~PreparedStatement() { sqlite3_finalize(m_handle); }
+	PreparedStatement(const PreparedStatement&) = delete;
+	PreparedStatement& operator=(const PreparedStatement&) = delete;
+
+	sqlite3_stmt* get() const { return m_handle; }
+
+	//Steps the statement, returning true if there is a row to read and false once the statement is done. Anything else is thrown as an error.
+	bool stepRow() {
+		int stepStatus{ sqlite3_step(m_handle) };
+		if (stepStatus == SQLITE_ROW) return true;
+		if (stepStatus == SQLITE_DONE) return false;
+		throw std::runtime_error{ "Error stepping statement: " + std::string{sqlite3_errmsg(m_db)} };
+	}
+
+	//Reads a text column, treating NULL as an empty string.
+	std::string columnText(int column) const {
+		auto text{ sqlite3_column_text(m_handle, column) };
+		return text ? reinterpret_cast<const char*>(text) : std::string{};
+	}
+
+private:
+	sqlite3* m_db;
+	sqlite3_stmt* m_handle{ nullptr };
+};
@@ -0,0 +1,167 @@
+//Standard library includes
+#include <iostream>
+#include <string>
+#include <array>
+#include <iomanip>
+#include <sstream>
+
+//Project includes
+#include "Reports.h"
+#include "CustomerTracker.h"
+#include "PreparedStatement.h"
+#include "ChangeExport.h"
+
+//The statements behind the two credit reports. They are written to match the indexes added by schema migration 5 exactly - in particular,
+//SQLite will only use an index on an expression if the query uses the very same expression.
+const char* const creditRiskStatement{ "SELECT Customer_Short_Name, Credit_Limit, Outstanding_Credit, ROUND(CREDIT_UTILISATION(Credit_Limit, Outstanding_Credit) * 100, 1) AS Utilisation_Percent "
+	"FROM Customers WHERE Outstanding_Credit > 0 ORDER BY CREDIT_UTILISATION(Credit_Limit, Outstanding_Credit) DESC;" };
+const char* const groupCreditStatement{ "SELECT Group_Name, COUNT(*) AS Customers, SUM(Credit_Limit) AS Total_Credit_Limit, SUM(Outstanding_Credit) AS Total_Outstanding_Credit "
+	"FROM Customers GROUP BY Group_Name;" };
+
+namespace {
+
+	struct BuiltInQuery {
+		const char* description;
+		const char* statement;
+	};
+
+	//The queries the program runs most often, as they appear in the code. Parameters are left unbound, which doesn't affect the plan.
+	//NB: If one of these changes in the code, it should be changed here too, or this report will be describing a query we no longer run.
+	const std::array<BuiltInQuery, 14> builtInQueries{ {
+		{ "Resolve a short name", "SELECT Customer_Short_Name FROM Customers WHERE Customer_Short_Name = ? COLLATE NOCASE;" },
+		{ "Customer ID from short name", "SELECT Customer_ID FROM Customers WHERE Customer_Short_Name = ?;" },
+		{ "Customer details", "SELECT * FROM Customers WHERE Customer_ID = ?;" },
+		{ "A customer's addresses", "SELECT * FROM CustomerAddress WHERE Customer_ID = ?;" },
+		{ "Delete a customer's addresses", "DELETE FROM CustomerAddress WHERE Customer_ID = ?;" },
+		{ "All customers and addresses", "SELECT * FROM Customers INNER JOIN CustomerAddress WHERE Customers.Customer_ID = CustomerAddress.Customer_ID ORDER BY Customers.Customer_ID;" },
+		{ "Fuzzy name search candidates", "SELECT Customer_ID FROM CustomerNameTrigrams WHERE Trigram IN (?,?,?) GROUP BY Customer_ID ORDER BY COUNT(*) DESC LIMIT ?;" },
+		{ "Phonetic name search", "SELECT Customer_ID FROM Customers WHERE First_Name_Phonetic IN (?) OR Last_Name_Phonetic IN (?);" },
+		{ "Addresses by postcode", "SELECT CustomerAddress.Address_ID, Customers.Customer_Short_Name FROM CustomerAddress INNER JOIN Customers ON Customers.Customer_ID = CustomerAddress.Customer_ID "
+			"WHERE CustomerAddress.Postcode >= ? AND CustomerAddress.Postcode < ? ORDER BY CustomerAddress.Postcode;" },
+		{ "Postcode backfill batch", "SELECT Address_ID FROM CustomerAddress WHERE Postcode IS NULL LIMIT ?;" },
+		{ "Changed customers export", "SELECT * FROM Customers WHERE Updated_On >= ? ORDER BY Updated_On;" },
+		{ "Changed addresses export", "SELECT * FROM CustomerAddress WHERE Updated_On >= ? ORDER BY Updated_On;" },
+		{ "Credit risk report", creditRiskStatement },
+		{ "Group credit report", groupCreditStatement }
+	} };
+
+	//Page-level statistics for every table and index, from the dbstat virtual table. dbstat gives one row per page, which lets us work out
+	//fragmentation as well: walking each b-tree in order (by path), a page which doesn't directly follow the one before it in the file means a seek.
+	const char* storageStatement{ "WITH Pages AS ("
+		"SELECT name, pageno, pagetype, payload, unused, pgsize, LAG(pageno) OVER (PARTITION BY name ORDER BY path) AS previous_pageno FROM dbstat) "
+		"SELECT Pages.name, COALESCE(sqlite_master.type, 'schema') AS type, "
+		"COUNT(*), SUM(pagetype = 'overflow'), SUM(payload), SUM(unused), SUM(pgsize), SUM(previous_pageno IS NOT NULL AND pageno != previous_pageno + 1) "
+		"FROM Pages LEFT JOIN sqlite_master ON sqlite_master.name = Pages.name GROUP BY Pages.name "
+		"ORDER BY COALESCE(sqlite_master.tbl_name, Pages.name), sqlite_master.type = 'index', SUM(pgsize) DESC;" };
+
+	std::string percentOf(sqlite3_int64 part, sqlite3_int64 whole) {
+		if (whole <= 0) return "-";
+		std::ostringstream percent;
+		percent << std::fixed << std::setprecision(1) << 100.0 * part / whole << '%';
+		return percent.str();
+	}
+
+}
+
+
+void printCreditRiskReport(sqlite3* db) {
+	std::cout << "Customers with outstanding credit, by utilisation of their credit limit:\n";
+	executeStatement(creditRiskStatement, db, false);
+}
+
+
+void printGroupCreditReport(sqlite3* db) {
+	std::cout << "Credit by customer group:\n";
+	executeStatement(groupCreditStatement, db, false);
+}
+
+
+void printQueryPlanReport(sqlite3* db) {
+	for (const auto& query : builtInQueries) {
+		std::cout << query.description << ":\n";
+		try {
+			PreparedStatement explainQuery{ db, "EXPLAIN QUERY PLAN " + std::string{ query.statement } };
+			//Each row is one step of the plan. Column 3 is the description, e.g. "SEARCH Customers USING INDEX ...", and column 1 says which step it belongs to, which we use to indent it.
+			while (explainQuery.stepRow()) {
+				std::cout << (sqlite3_column_int(explainQuery.get(), 1) == 0 ? "  " : "    ") << explainQuery.columnText(3) << '\n';
+			}
+		}
+		catch (std::exception& e) {
+			std::cout << "  Could not explain query: " << e.what() << '\n';
+		}
+	}
+	std::cout << "SCAN means every row of the table is read. SEARCH means an index (or the primary key) is used to find the rows.\n";
+}
+
+
+void printMaintenanceReport(sqlite3* db, const MaintenanceScheduler& maintenance) {
+	const auto stats{ maintenance.stats() };
+	const auto& settings{ maintenance.settings() };
+	std::cout << "Maintenance runs after " << settings.idleDelay.count() << " seconds idle, at most every " << settings.passInterval.count() << " minutes.\n"
+		"Passes completed: " << stats.passesCompleted << " (" << stats.passesInterrupted << " interrupted by activity)\n"
+		"PRAGMA optimize runs: " << stats.optimizeRuns << '\n' <<
+		"Tables re-analyzed: " << stats.tablesAnalyzed << '\n' <<
+		"Pages returned to the file system: " << stats.pagesVacuumed << '\n' <<
+		"Steps skipped as the database was busy: " << stats.stepsSkippedBusy << '\n';
+	if (stats.passesCompleted > 0) {
+		std::cout << "Last completed pass: " << formatTimestamp(std::chrono::system_clock::to_time_t(stats.lastPass)) << " UTC\n";
+	}
+	if (!stats.lastError.empty()) std::cout << "Last error: " << stats.lastError << '\n';
+
+	std::cout << "\nCurrent state of the database:\n";
+	executeStatement("SELECT CASE auto_vacuum WHEN 0 THEN 'NONE' WHEN 1 THEN 'FULL' ELSE 'INCREMENTAL' END AS Auto_Vacuum, page_count AS Pages, freelist_count AS Free_Pages "
+		"FROM pragma_auto_vacuum, pragma_page_count, pragma_freelist_count;", db, false);
+}
+
+
+void printStorageReport(sqlite3* db) {
+	//The file as a whole first.
+	sqlite3_int64 pageSize{ 0 }, pageCount{ 0 }, freePages{ 0 };
+	{
+		PreparedStatement selectFile{ db, "SELECT page_size, page_count, freelist_count FROM pragma_page_size, pragma_page_count, pragma_freelist_count;" };
+		if (selectFile.stepRow()) {
+			pageSize = sqlite3_column_int64(selectFile.get(), 0);
+			pageCount = sqlite3_column_int64(selectFile.get(), 1);
+			freePages = sqlite3_column_int64(selectFile.get(), 2);
+		}
+	}
+	std::cout << "Database file: " << pageCount << " pages of " << pageSize << " bytes (" << pageCount * pageSize / 1024 << " KB), of which "
+		<< freePages << " are free (" << percentOf(freePages, pageCount) << ").\n\n";
+
+	//Then each table and index. dbstat is an optional part of SQLite, so we check it's there before relying on it.
+	sqlite3_stmt* statementHandle{ nullptr };
+	if (sqlite3_prepare_v2(db, storageStatement, -1, &statementHandle, NULL) != SQLITE_OK) {
+		std::cout << "Per-table statistics are not available, as this build of SQLite does not include the dbstat virtual table (" << sqlite3_errmsg(db) << ").\n";
+		sqlite3_finalize(statementHandle);
+	}
+	else {
+		std::cout << std::left << std::setw(40) << "Table or index" << std::right << std::setw(9) << "Pages" << std::setw(10) << "Overflow" << std::setw(14) << "Payload"
+			<< std::setw(14) << "Unused" << std::setw(8) << "Fill" << std::setw(12) << "Fragmented" << '\n';
+		while (sqlite3_step(statementHandle) == SQLITE_ROW) {
+			std::string name{ reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, 0)) };
+			const std::string type{ reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, 1)) };
+			if (type == "index") name = "  " + name;		//Indexes are listed (indented) under their table.
+			if (name.size() > 39) name = name.substr(0, 36) + "...";
+
+			const sqlite3_int64 pages{ sqlite3_column_int64(statementHandle, 2) };
+			const sqlite3_int64 bytes{ sqlite3_column_int64(statementHandle, 6) };
+			std::cout << std::left << std::setw(40) << name << std::right << std::setw(9) << pages << std::setw(10) << sqlite3_column_int64(statementHandle, 3)
+				<< std::setw(14) << sqlite3_column_int64(statementHandle, 4) << std::setw(14) << sqlite3_column_int64(statementHandle, 5)
+				<< std::setw(8) << percentOf(sqlite3_column_int64(statementHandle, 4), bytes)
+				<< std::setw(12) << percentOf(sqlite3_column_int64(statementHandle, 7), pages) << '\n';
+		}
+		sqlite3_finalize(statementHandle);
+		std::cout << "Payload and unused space are in bytes. Fill is the share of each page holding data. Fragmented is the share of pages which\n"
+			"are not stored straight after the page before them, which slows down scans. VACUUM brings both back to their best.\n";
+	}
+
+	//And finally, what this connection is holding in memory for the database.
+	int current{ 0 }, highwater{ 0 };
+	std::cout << "\nMemory used by this connection:\n";
+	sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0);
+	std::cout << "  Page cache: " << current / 1024 << " KB\n";
+	sqlite3_db_status(db, SQLITE_DBSTATUS_SCHEMA_USED, &current, &highwater, 0);
+	std::cout << "  Schema: " << current / 1024 << " KB\n";
+	sqlite3_db_status(db, SQLITE_DBSTATUS_STMT_USED, &current, &highwater, 0);
+	std::cout << "  Prepared statements: " << current / 1024 << " KB\n";
+}
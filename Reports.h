@@ -0,0 +1,32 @@
+#pragma once
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "Maintenance.h"
+
+
+//Reports printed from the Reports and Diagnostics menu.
+
+//The statements behind the credit reports, for anything which wants the rows themselves rather than a printout, e.g. the HTTP interface.
+extern const char* const creditRiskStatement;
+extern const char* const groupCreditStatement;
+
+//Every customer with outstanding credit, highest utilisation first. Served by the Customers_Outstanding_Utilisation partial index, so
+//customers with nothing outstanding are never read, and no sort is needed.
+void printCreditRiskReport(sqlite3* db);
+
+//Total credit limit and outstanding credit per customer group. Served entirely from the Customers_Group_Credit covering index.
+void printGroupCreditReport(sqlite3* db);
+
+//Runs EXPLAIN QUERY PLAN over each of the program's built-in queries, and prints which index (if any) SQLite uses for each.
+//Useful for checking the schema migrations have left every query with the index it was designed for.
+void printQueryPlanReport(sqlite3* db);
+
+//Shows what the background maintenance scheduler has done so far, alongside the free space and statistics it looks after.
+void printMaintenanceReport(sqlite3* db, const MaintenanceScheduler& maintenance);
+
+//How the database file's space is used: page counts, payload, unused space, overflow pages and fragmentation for every table and index
+//(from the dbstat virtual table), plus the memory this connection holds for its cache, schema and statements (from sqlite3_db_status).
+void printStorageReport(sqlite3* db);
@@ -0,0 +1,288 @@
+//Standard library includes
+#include <iostream>
+#include <string>
+#include <vector>
+#include <utility>	//For std::pair
+
+//Third party includes
+#include<sqlite3.h>
+
+//Project includes
+#include "SchemaMigrations.h"
+#include "CustomerTracker.h"
+
+namespace {
+
+	//A single migration. The description is printed to the console as the migration is applied.
+	//Most migrations run inside a transaction, but a few statements (such as VACUUM) can't, and those migrations set inTransaction to false.
+	//They must then be safe to run again from the start if they are interrupted, as user_version is only updated once they have finished.
+	struct SchemaMigration {
+		const char* description;
+		void (*apply)(sqlite3*);
+		bool inTransaction{ true };
+	};
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//									Migration 1 - Case-insensitive short names								//
+	//----------------------------------------------------------------------------------------------------------//
+	//Short names used to be matched exactly, so the same customer could not be found as "jsmith" or " JSMITH ".
+	//Here we normalise the whitespace in every stored short name, then add a unique index on Customer_Short_Name COLLATE NOCASE.
+	//This index both enforces uniqueness on the normalised form and lets resolveShortName() find a customer with a single index seek.
+	void normaliseStoredShortNames(sqlite3* db) {
+		//First gather up every short name which isn't already in its normalised form.
+		std::vector<std::pair<int, std::string>> namesToFix;
+		sqlite3_stmt* statementHandle;
+		int prepStatus{ sqlite3_prepare_v2(db, "SELECT Customer_ID, Customer_Short_Name FROM Customers;", -1, &statementHandle, NULL) };
+		if (prepStatus != SQLITE_OK) {
+			sqlite3_finalize(statementHandle);
+			throw std::runtime_error{ "Error preparing SELECT short names statement: " + std::string{sqlite3_errmsg(db)} };
+		}
+		while (sqlite3_step(statementHandle) == SQLITE_ROW) {
+			std::string storedName{ reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, 1)) };
+			std::string normalisedName{ storedName };
+			normaliseShortName(normalisedName);
+			if (normalisedName != storedName) namesToFix.emplace_back(sqlite3_column_int(statementHandle, 0), std::move(normalisedName));
+		}
+		sqlite3_finalize(statementHandle);
+
+		//Then write the tidied names back.
+		prepStatus = sqlite3_prepare_v2(db, "UPDATE Customers SET Customer_Short_Name = ? WHERE Customer_ID = ?;", -1, &statementHandle, NULL);
+		if (prepStatus != SQLITE_OK) {
+			sqlite3_finalize(statementHandle);
+			throw std::runtime_error{ "Error preparing UPDATE short names statement: " + std::string{sqlite3_errmsg(db)} };
+		}
+		for (const auto& [customerID, normalisedName] : namesToFix) {
+			sqlite3_bind_text(statementHandle, 1, normalisedName.c_str(), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_int(statementHandle, 2, customerID);
+			if (sqlite3_step(statementHandle) != SQLITE_DONE) {
+				std::string errorMessage{ "Error normalising short name " + normalisedName + ": " + sqlite3_errmsg(db) };
+				sqlite3_finalize(statementHandle);
+				throw std::runtime_error{ errorMessage };
+			}
+			sqlite3_reset(statementHandle);
+		}
+		sqlite3_finalize(statementHandle);
+
+		//If two customers only differ by case or whitespace, this will fail with a constraint error and the migration will be rolled back until they are renamed.
+		executeStatement("CREATE UNIQUE INDEX IF NOT EXISTS Customers_Short_Name_NoCase ON Customers(Customer_Short_Name COLLATE NOCASE);", db, false);
+	}
+
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//									Migration 2 - Trigram index for fuzzy name search						//
+	//----------------------------------------------------------------------------------------------------------//
+	//Adds the table of name trigrams used by fuzzySearchCustomers(), and a queue of customers whose trigrams need refreshing.
+	//The triggers queue a customer whenever any of their indexed names could have changed, so the index stays correct however the data is written.
+	//Every existing customer is queued here, and the index is built the first time a search needs it.
+	void addNameTrigramIndex(sqlite3* db) {
+		executeStatement("CREATE TABLE IF NOT EXISTS CustomerNameTrigrams( \
+							Trigram char(3) NOT NULL, \
+							Customer_ID int NOT NULL, \
+							PRIMARY KEY(Trigram, Customer_ID)) WITHOUT ROWID;", db, false);
+		//The primary key covers searches by trigram. This one covers throwing away a customer's old trigrams when their names change.
+		executeStatement("CREATE INDEX IF NOT EXISTS CustomerNameTrigrams_Customer ON CustomerNameTrigrams(Customer_ID);", db, false);
+		executeStatement("CREATE TABLE IF NOT EXISTS CustomerNameTrigramsPending(Customer_ID INTEGER PRIMARY KEY);", db, false);
+
+		executeStatement("CREATE TRIGGER IF NOT EXISTS Customers_Insert_Trigrams AFTER INSERT ON Customers \
+							BEGIN INSERT OR IGNORE INTO CustomerNameTrigramsPending VALUES (NEW.Customer_ID); END;", db, false);
+		executeStatement("CREATE TRIGGER IF NOT EXISTS Customers_Update_Trigrams AFTER UPDATE OF Customer_Short_Name, First_Name, Last_Name ON Customers \
+							BEGIN INSERT OR IGNORE INTO CustomerNameTrigramsPending VALUES (NEW.Customer_ID); END;", db, false);
+		executeStatement("CREATE TRIGGER IF NOT EXISTS Customers_Delete_Trigrams AFTER DELETE ON Customers \
+							BEGIN INSERT OR IGNORE INTO CustomerNameTrigramsPending VALUES (OLD.Customer_ID); END;", db, false);
+		executeStatement("CREATE TRIGGER IF NOT EXISTS CustomerAddress_Insert_Trigrams AFTER INSERT ON CustomerAddress \
+							BEGIN INSERT OR IGNORE INTO CustomerNameTrigramsPending VALUES (NEW.Customer_ID); END;", db, false);
+		executeStatement("CREATE TRIGGER IF NOT EXISTS CustomerAddress_Update_Trigrams AFTER UPDATE OF Contact_Name, Customer_ID ON CustomerAddress \
+							BEGIN INSERT OR IGNORE INTO CustomerNameTrigramsPending VALUES (OLD.Customer_ID), (NEW.Customer_ID); END;", db, false);
+		executeStatement("CREATE TRIGGER IF NOT EXISTS CustomerAddress_Delete_Trigrams AFTER DELETE ON CustomerAddress \
+							BEGIN INSERT OR IGNORE INTO CustomerNameTrigramsPending VALUES (OLD.Customer_ID); END;", db, false);
+
+		executeStatement("INSERT OR IGNORE INTO CustomerNameTrigramsPending SELECT Customer_ID FROM Customers;", db, false);
+	}
+
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//									Migration 3 - Phonetic name keys										//
+	//----------------------------------------------------------------------------------------------------------//
+	//Adds the Soundex code of each customer's first and last name as indexed columns, so "sounds like" searches are index seeks.
+	//The columns are computed by our PHONETIC_KEY() SQL function, and triggers keep them up to date whenever the names are written.
+	void addPhoneticNameKeys(sqlite3* db) {
+		executeStatement("ALTER TABLE Customers ADD COLUMN First_Name_Phonetic char(4);", db, false);
+		executeStatement("ALTER TABLE Customers ADD COLUMN Last_Name_Phonetic char(4);", db, false);
+		executeStatement("UPDATE Customers SET First_Name_Phonetic = PHONETIC_KEY(First_Name), Last_Name_Phonetic = PHONETIC_KEY(Last_Name);", db, false);
+
+		executeStatement("CREATE INDEX IF NOT EXISTS Customers_First_Name_Phonetic ON Customers(First_Name_Phonetic);", db, false);
+		executeStatement("CREATE INDEX IF NOT EXISTS Customers_Last_Name_Phonetic ON Customers(Last_Name_Phonetic);", db, false);
+
+		executeStatement("CREATE TRIGGER IF NOT EXISTS Customers_Insert_Phonetic AFTER INSERT ON Customers \
+							BEGIN UPDATE Customers SET First_Name_Phonetic = PHONETIC_KEY(NEW.First_Name), Last_Name_Phonetic = PHONETIC_KEY(NEW.Last_Name) \
+							WHERE Customer_ID = NEW.Customer_ID; END;", db, false);
+		executeStatement("CREATE TRIGGER IF NOT EXISTS Customers_Update_Phonetic AFTER UPDATE OF First_Name, Last_Name ON Customers \
+							BEGIN UPDATE Customers SET First_Name_Phonetic = PHONETIC_KEY(NEW.First_Name), Last_Name_Phonetic = PHONETIC_KEY(NEW.Last_Name) \
+							WHERE Customer_ID = NEW.Customer_ID; END;", db, false);
+	}
+
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//									Migration 4 - Indexed postcodes											//
+	//----------------------------------------------------------------------------------------------------------//
+	//Adds the Postcode column to CustomerAddress, extracted from the five address lines by our EXTRACT_POSTCODE() SQL function whenever they are written.
+	//Existing addresses are left with a NULL postcode here, and filled in in batches by backfillPostcodes() so a large table doesn't hold up the migration.
+	void addPostcodeIndex(sqlite3* db) {
+		executeStatement("ALTER TABLE CustomerAddress ADD COLUMN Postcode varchar(8);", db, false);
+		executeStatement("CREATE INDEX IF NOT EXISTS CustomerAddress_Postcode ON CustomerAddress(Postcode);", db, false);
+
+		executeStatement("CREATE TRIGGER IF NOT EXISTS CustomerAddress_Insert_Postcode AFTER INSERT ON CustomerAddress \
+							BEGIN UPDATE CustomerAddress SET Postcode = EXTRACT_POSTCODE(NEW.Address_Line_1, NEW.Address_Line_2, NEW.Address_Line_3, NEW.Address_Line_4, NEW.Address_Line_5) \
+							WHERE Address_ID = NEW.Address_ID; END;", db, false);
+		executeStatement("CREATE TRIGGER IF NOT EXISTS CustomerAddress_Update_Postcode AFTER UPDATE OF Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5 ON CustomerAddress \
+							BEGIN UPDATE CustomerAddress SET Postcode = EXTRACT_POSTCODE(NEW.Address_Line_1, NEW.Address_Line_2, NEW.Address_Line_3, NEW.Address_Line_4, NEW.Address_Line_5) \
+							WHERE Address_ID = NEW.Address_ID; END;", db, false);
+	}
+
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//									Migration 5 - Indexes for common queries								//
+	//----------------------------------------------------------------------------------------------------------//
+	//A curated set of indexes for the queries we run most. The Query Plan report shows which of these each built-in query uses.
+	void addQueryIndexes(sqlite3* db) {
+		//Addresses are nearly always fetched by customer, and without this every lookup (and every customer deletion) scans the whole address table.
+		executeStatement("CREATE INDEX IF NOT EXISTS CustomerAddress_Customer ON CustomerAddress(Customer_ID);", db, false);
+
+		//The credit risk report only cares about customers who owe something, so a partial index leaves everyone else out of it entirely.
+		//Ordering it by utilisation means the report can be read straight out of the index without a sort. The catch is that any connection
+		//which writes credit figures needs CREDIT_UTILISATION() registered, as the README warns, as it does for the phonetic key triggers.
+		executeStatement("CREATE INDEX IF NOT EXISTS Customers_Outstanding_Utilisation ON Customers(CREDIT_UTILISATION(Credit_Limit, Outstanding_Credit) DESC) \
+							WHERE Outstanding_Credit > 0;", db, false);
+
+		//Group credit totals can be answered from this index alone, without touching the table.
+		executeStatement("CREATE INDEX IF NOT EXISTS Customers_Group_Credit ON Customers(Group_Name, Credit_Limit, Outstanding_Credit);", db, false);
+	}
+
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//								Migration 6 - Integer timestamps and Updated_On indexes						//
+	//----------------------------------------------------------------------------------------------------------//
+	//Dates were stored as DATE('now') text, which can only be compared as strings and only to the nearest day. From here on they're
+	//whole seconds since the Unix epoch. Anything that doesn't parse as a date is left as it was rather than being thrown away.
+	void convertTimestampsToEpoch(sqlite3* db) {
+		for (const char* table : { "Customers", "CustomerAddress" }) {
+			executeStatement(std::string{ "UPDATE " } + table + " SET Created_On = COALESCE(CAST(strftime('%s', Created_On) AS INTEGER), Created_On) WHERE typeof(Created_On) = 'text';", db, false);
+			executeStatement(std::string{ "UPDATE " } + table + " SET Updated_On = COALESCE(CAST(strftime('%s', Updated_On) AS INTEGER), Updated_On) WHERE typeof(Updated_On) = 'text';", db, false);
+		}
+
+		//With these, "everything changed since T" is a range scan from T to the end of the index.
+		executeStatement("CREATE INDEX IF NOT EXISTS Customers_Updated_On ON Customers(Updated_On);", db, false);
+		executeStatement("CREATE INDEX IF NOT EXISTS CustomerAddress_Updated_On ON CustomerAddress(Updated_On);", db, false);
+	}
+
+
+
+	//----------------------------------------------------------------------------------------------------------//
+	//									Migration 7 - Incremental auto-vacuum									//
+	//----------------------------------------------------------------------------------------------------------//
+	//Deleting customers leaves free pages in the file which are only ever reused, never given back. With auto_vacuum = INCREMENTAL, the background
+	//maintenance scheduler can hand them back a few at a time with PRAGMA incremental_vacuum. An existing database only takes on the new setting
+	//when it is rebuilt with VACUUM, so this runs outside a transaction, and takes as long as copying the database once.
+	void enableIncrementalVacuum(sqlite3* db) {
+		//Nothing to do if a previous attempt got as far as the VACUUM but was interrupted before the new version was recorded.
+		sqlite3_stmt* statementHandle;
+		int autoVacuum{ -1 };
+		if (sqlite3_prepare_v2(db, "PRAGMA auto_vacuum;", -1, &statementHandle, NULL) == SQLITE_OK && sqlite3_step(statementHandle) == SQLITE_ROW) {
+			autoVacuum = sqlite3_column_int(statementHandle, 0);
+		}
+		sqlite3_finalize(statementHandle);
+		if (autoVacuum == 2) return;
+
+		executeStatement("PRAGMA auto_vacuum = INCREMENTAL;", db, false);
+		executeStatement("VACUUM;", db, false);
+	}
+
+
+
+	//The list of migrations, in the order they must be applied. Migration N takes the database from user_version N-1 to user_version N.
+	//NB: Never reorder or remove entries from this list - existing databases rely on the numbering. New migrations go on the end.
+	const std::vector<SchemaMigration>& schemaMigrations() {
+		static const std::vector<SchemaMigration> migrations{
+			{ "Normalise short names and add case-insensitive short name index", normaliseStoredShortNames },
+			{ "Add trigram index for fuzzy name search", addNameTrigramIndex },
+			{ "Add indexed phonetic keys for first and last names", addPhoneticNameKeys },
+			{ "Add indexed postcodes extracted from address lines", addPostcodeIndex },
+			{ "Add indexes for address lookups and credit reports", addQueryIndexes },
+			{ "Store timestamps as epoch seconds and index Updated_On", convertTimestampsToEpoch },
+			{ "Switch to incremental auto-vacuum", enableIncrementalVacuum, false }
+		};
+		return migrations;
+	}
+
+}
+
+
+int readUserVersion(sqlite3* db) {
+	sqlite3_stmt* statementHandle;
+	int prepStatus{ sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &statementHandle, NULL) };
+	if (prepStatus != SQLITE_OK) {
+		sqlite3_finalize(statementHandle);
+		throw std::runtime_error{ "Error preparing user_version statement: " + std::string{sqlite3_errmsg(db)} };
+	}
+	if (sqlite3_step(statementHandle) != SQLITE_ROW) {
+		sqlite3_finalize(statementHandle);
+		throw std::runtime_error{ "Error reading user_version: " + std::string{sqlite3_errmsg(db)} };
+	}
+	int version{ sqlite3_column_int(statementHandle, 0) };
+	sqlite3_finalize(statementHandle);
+	return version;
+}
+
+
+int latestSchemaVersion() {
+	return static_cast<int>(schemaMigrations().size());
+}
+
+
+void applySchemaMigrations(sqlite3* db) {
+	int currentVersion{ 0 };
+	try {
+		currentVersion = readUserVersion(db);
+	}
+	catch (std::exception& e) {
+		std::cerr << "Error checking schema version: " << e.what() << "\nSchema migrations have been skipped.\n";
+		return;
+	}
+
+	const auto& migrations{ schemaMigrations() };
+	for (int version = currentVersion; version < latestSchemaVersion(); ++version) {
+		std::cout << "Applying schema migration " << version + 1 << ": " << migrations[version].description << '\n';
+		const bool inTransaction{ migrations[version].inTransaction };
+		try {
+			if (inTransaction) executeStatement("BEGIN IMMEDIATE TRANSACTION", db, false);
+			migrations[version].apply(db);
+			//PRAGMA statements can't be bound, but the version is an internal integer so there's no risk of injection.
+			executeStatement("PRAGMA user_version = " + std::to_string(version + 1) + ";", db, false);
+			if (inTransaction) executeStatement("COMMIT TRANSACTION", db, false);
+		}
+		catch (std::exception& e) {
+			if (inTransaction) sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);	//Not executeStatement() as we don't want a second exception thrown from in here.
+			std::cerr << "Error applying schema migration " << version + 1 << ": " << e.what() << "\nThe database has been left at schema version " << version << ".\n";
+			return;
+		}
+	}
+}
+
+
+void applyInsertTriggerEffects(sqlite3* db, sqlite3_int64 afterCustomerID, sqlite3_int64 afterAddressID) {
+	const std::string customerIDs{ std::to_string(afterCustomerID) }, addressIDs{ std::to_string(afterAddressID) };
+
+	//Customers_Insert_Phonetic
+	executeStatement("UPDATE Customers SET First_Name_Phonetic = PHONETIC_KEY(First_Name), Last_Name_Phonetic = PHONETIC_KEY(Last_Name) WHERE Customer_ID > " + customerIDs + ";", db, false);
+	//CustomerAddress_Insert_Postcode
+	executeStatement("UPDATE CustomerAddress SET Postcode = EXTRACT_POSTCODE(Address_Line_1, Address_Line_2, Address_Line_3, Address_Line_4, Address_Line_5) WHERE Address_ID > " + addressIDs + ";", db, false);
+	//Customers_Insert_Trigrams and CustomerAddress_Insert_Trigrams
+	executeStatement("INSERT OR IGNORE INTO CustomerNameTrigramsPending SELECT Customer_ID FROM Customers WHERE Customer_ID > " + customerIDs + ";", db, false);
+	executeStatement("INSERT OR IGNORE INTO CustomerNameTrigramsPending SELECT Customer_ID FROM CustomerAddress WHERE Address_ID > " + addressIDs + ";", db, false);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+//Schema migrations. Every change made to the schema after the two tables were first designed lives here as a numbered migration.
+//The number of migrations which have been applied to a database is recorded in its PRAGMA user_version, so each one only ever runs once per database file.
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Applies every migration the database has not yet seen, in order. Each migration runs inside its own transaction, apart from migration 7
+//(the switch to incremental auto-vacuum), whose VACUUM can't run inside one. If that migration is interrupted, it is simply run again on the next start.
+//If a migration fails, the error is reported and no further migrations are applied, but the database is left usable at the last good version.
+void applySchemaMigrations(sqlite3* db);
+
+//The schema version a fully migrated database will have.
+int latestSchemaVersion();
+
+//The database's PRAGMA user_version, which records how many migrations have been applied to it. Throws std::runtime_error if it can't be read.
+int readUserVersion(sqlite3* db);
+
+//Does in bulk what the insert triggers on Customers and CustomerAddress do row by row, for customers after afterCustomerID and addresses after
+//afterAddressID. For loads which drop the triggers to go faster. NB: This must be kept in step with the triggers created by the migrations.
+void applyInsertTriggerEffects(sqlite3* db, sqlite3_int64 afterCustomerID, sqlite3_int64 afterAddressID);
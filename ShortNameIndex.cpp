@@ -0,0 +1,72 @@
+//Standard library includes
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+//Project includes
+#include "ShortNameIndex.h"
+
+namespace {
+	//SQLite's NOCASE collation folds ASCII upper case to lower case and leaves everything else alone, so we do exactly the same here to keep
+	//the two orderings in step. Folding to upper case instead would put the few characters between the two alphabets (e.g. '_') on the other side.
+	unsigned char foldCase(char c) {
+		return static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+}
+
+
+bool ShortNameIndex::NoCaseLess::operator()(std::string_view lhs, std::string_view rhs) const {
+	return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+		[](char a, char b) { return foldCase(a) < foldCase(b); });
+}
+
+
+void ShortNameIndex::load(sqlite3* db) {
+	sqlite3_stmt* statementHandle;
+	//Reading the names out of the NOCASE index gives them to us already sorted, so every insert below goes on the end of the tree.
+	int prepStatus{ sqlite3_prepare_v2(db, "SELECT Customer_Short_Name FROM Customers ORDER BY Customer_Short_Name COLLATE NOCASE;", -1, &statementHandle, NULL) };
+	if (prepStatus != SQLITE_OK) {
+		sqlite3_finalize(statementHandle);
+		throw std::runtime_error{ "Error preparing short name index statement: " + std::string{sqlite3_errmsg(db)} };
+	}
+
+	std::set<std::string, NoCaseLess> names;
+	int stepStatus;
+	while ((stepStatus = sqlite3_step(statementHandle)) == SQLITE_ROW) {
+		names.emplace_hint(names.end(), reinterpret_cast<const char*>(sqlite3_column_text(statementHandle, 0)));
+	}
+	sqlite3_finalize(statementHandle);
+	if (stepStatus != SQLITE_DONE) throw std::runtime_error{ "Error reading short names into index: " + std::string{sqlite3_errmsg(db)} };
+
+	//Only swap the new names in once we know we read all of them, so a failure leaves the old index intact.
+	m_names.swap(names);
+	m_loaded = true;
+}
+
+
+void ShortNameIndex::insert(const std::string& inShortName) {
+	m_names.insert(inShortName);
+}
+
+
+void ShortNameIndex::erase(const std::string& inShortName) {
+	auto position{ m_names.find(std::string_view{ inShortName }) };
+	if (position != m_names.end()) m_names.erase(position);
+}
+
+
+std::string ShortNameIndex::find(std::string_view inShortName) const {
+	auto position{ m_names.find(inShortName) };
+	return position != m_names.end() ? *position : std::string{};
+}
+
+
+std::vector<std::string> ShortNameIndex::complete(std::string_view inPrefix, std::size_t maxResults) const {
+	std::vector<std::string> matches;
+	//Every name starting with the prefix sorts at or after the prefix itself, and they are all contiguous, so we walk forward until one doesn't match.
+	for (auto it = m_names.lower_bound(inPrefix); it != m_names.end() && matches.size() < maxResults; ++it) {
+		if (it->size() < inPrefix.size() || NoCaseLess{}(inPrefix, std::string_view{ *it }.substr(0, inPrefix.size()))) break;
+		matches.push_back(*it);
+	}
+	return matches;
+}
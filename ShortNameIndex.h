@@ -0,0 +1,52 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+#include <set>
+#include <vector>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//An in-memory sorted index of every customer short name in the database, used to offer prefix completions at the interactive prompts.
+//Names are ordered without regard to ASCII case, to match the COLLATE NOCASE index on Customer_Short_Name, so a prefix lookup is a single
+//O(log n) search in the tree followed by a walk over the matching names. This keeps lookups in the microseconds even with millions of customers.
+//NB: The index does not watch the database. Whoever adds or removes a customer is responsible for calling insert() or erase(), and if the
+//database may have been changed behind our back (e.g. by custom SQL) the index should be rebuilt with load().
+class ShortNameIndex {
+public:
+	//(Re)builds the index from the Customers table.
+	void load(sqlite3* db);
+
+	//Loading every short name takes a while on a big database, so it's put off until a prompt first needs the index. Whoever changes the
+	//customers wholesale can reset() the index to have it loaded afresh next time it's needed, rather than reloading it straight away.
+	bool loaded() const { return m_loaded; }
+	void reset() {
+		m_names.clear();
+		m_loaded = false;
+	}
+
+	void insert(const std::string& inShortName);
+	void erase(const std::string& inShortName);
+
+	//Returns the stored form of the short name if it is in the index, or an empty string otherwise.
+	std::string find(std::string_view inShortName) const;
+
+	//Returns up to maxResults short names which start with the given prefix, in sorted order.
+	std::vector<std::string> complete(std::string_view inPrefix, std::size_t maxResults) const;
+
+	std::size_t size() const { return m_names.size(); }
+
+private:
+	//A transparent case-insensitive comparison, so we can search the set with a string_view without building a temporary std::string.
+	struct NoCaseLess {
+		using is_transparent = void;
+		bool operator()(std::string_view lhs, std::string_view rhs) const;
+	};
+
+	std::set<std::string, NoCaseLess> m_names;
+	bool m_loaded{ false };
+};
@@ -0,0 +1,147 @@
+//Standard library includes
+#include <array>
+#include <cctype>
+#include <stdexcept>
+
+//Project includes
+#include "SqlFunctions.h"
+#include "Postcodes.h"
+#include "CustomerTracker.h"
+
+namespace {
+
+	//Older versions of SQLite don't know about SQLITE_INNOCUOUS. It only needs to be set for our functions to be usable from triggers when trusted_schema is off.
+#ifdef SQLITE_INNOCUOUS
+	constexpr int functionFlags{ SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS };
+#else
+	constexpr int functionFlags{ SQLITE_UTF8 | SQLITE_DETERMINISTIC };
+#endif
+
+
+	//The Soundex digit for a letter. Vowels (and Y) give '0', which separates repeated digits, while H and W give nothing at all and so don't.
+	char soundexDigit(char inLetter) {
+		switch (inLetter) {
+		case 'B': case 'F': case 'P': case 'V':
+			return '1';
+		case 'C': case 'G': case 'J': case 'K': case 'Q': case 'S': case 'X': case 'Z':
+			return '2';
+		case 'D': case 'T':
+			return '3';
+		case 'L':
+			return '4';
+		case 'M': case 'N':
+			return '5';
+		case 'R':
+			return '6';
+		case 'H': case 'W':
+			return '\0';
+		default:
+			return '0';
+		}
+	}
+
+
+	//The SQL side of phoneticKey().
+	void sqlPhoneticKey(sqlite3_context* context, int /*argc*/, sqlite3_value** argv) {
+		const unsigned char* name{ sqlite3_value_text(argv[0]) };
+		if (!name) {
+			sqlite3_result_null(context);
+			return;
+		}
+		std::string key{ phoneticKey(reinterpret_cast<const char*>(name)) };
+		if (key.empty()) sqlite3_result_null(context);
+		else sqlite3_result_text(context, key.c_str(), static_cast<int>(key.size()), SQLITE_TRANSIENT);
+	}
+
+
+	//The SQL side of extractPostcode(). NULL address lines are treated as blank.
+	void sqlExtractPostcode(sqlite3_context* context, int argc, sqlite3_value** argv) {
+		std::array<std::string_view, 5> lines;
+		for (int i = 0; i < argc && i < 5; ++i) {
+			const unsigned char* text{ sqlite3_value_text(argv[i]) };
+			if (text) lines[i] = reinterpret_cast<const char*>(text);
+		}
+		std::string postcode{ extractPostcode(lines) };
+		sqlite3_result_text(context, postcode.c_str(), static_cast<int>(postcode.size()), SQLITE_TRANSIENT);
+	}
+
+
+	//The characters trimWhiteSpace() treats as whitespace.
+	constexpr const char* whiteSpaceCharacters{ " \n\r\t\f\v" };
+
+	//TRIM_WS(text)
+	void sqlTrimWhiteSpace(sqlite3_context* context, int /*argc*/, sqlite3_value** argv) {
+		const unsigned char* text{ sqlite3_value_text(argv[0]) };
+		if (!text) {
+			sqlite3_result_null(context);
+			return;
+		}
+		//We work on a view rather than calling trimWhiteSpace() itself, as that complains about strings which are all whitespace.
+		std::string_view view{ reinterpret_cast<const char*>(text), static_cast<std::size_t>(sqlite3_value_bytes(argv[0])) };
+		std::size_t start{ view.find_first_not_of(whiteSpaceCharacters) };
+		if (start == std::string_view::npos) view = {};
+		else view = view.substr(start, view.find_last_not_of(whiteSpaceCharacters) - start + 1);
+		sqlite3_result_text(context, view.data(), static_cast<int>(view.size()), SQLITE_TRANSIENT);
+	}
+
+	//NORMALISE_NAME(text)
+	void sqlNormaliseName(sqlite3_context* context, int /*argc*/, sqlite3_value** argv) {
+		const unsigned char* text{ sqlite3_value_text(argv[0]) };
+		if (!text) {
+			sqlite3_result_null(context);
+			return;
+		}
+		std::string name{ reinterpret_cast<const char*>(text) };
+		normaliseShortName(name);
+		for (char& c : name) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		sqlite3_result_text(context, name.c_str(), static_cast<int>(name.size()), SQLITE_TRANSIENT);
+	}
+
+	//CREDIT_UTILISATION(credit_limit, outstanding_credit)
+	void sqlCreditUtilisation(sqlite3_context* context, int /*argc*/, sqlite3_value** argv) {
+		if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+			sqlite3_result_null(context);
+			return;
+		}
+		double creditLimit{ sqlite3_value_double(argv[0]) };
+		if (creditLimit <= 0.0) sqlite3_result_null(context);	//Utilisation of a zero limit is meaningless, so we don't pretend otherwise.
+		else sqlite3_result_double(context, sqlite3_value_double(argv[1]) / creditLimit);
+	}
+
+
+	void registerFunction(sqlite3* db, const char* inName, int argCount, void (*function)(sqlite3_context*, int, sqlite3_value**)) {
+		int createStatus{ sqlite3_create_function_v2(db, inName, argCount, functionFlags, NULL, function, NULL, NULL, NULL) };
+		if (createStatus != SQLITE_OK) throw std::runtime_error{ "Error registering SQL function " + std::string{inName} + ": " + sqlite3_errmsg(db) };
+	}
+
+}
+
+
+std::string phoneticKey(std::string_view inName) {
+	std::string key;
+	char previousDigit{ '\0' };
+	for (char c : inName) {
+		if (!std::isalpha(static_cast<unsigned char>(c))) continue;		//Punctuation and spaces don't count, so "O'Brien" is treated as "OBrien".
+		char letter{ static_cast<char>(std::toupper(static_cast<unsigned char>(c))) };
+		char digit{ soundexDigit(letter) };
+
+		//We always keep the first letter as it is. After that, we only add a digit if it differs from the one before it.
+		if (key.empty()) key += letter;
+		else if (digit != '\0' && digit != '0' && digit != previousDigit) key += digit;
+
+		if (key.size() == 4) break;
+		if (digit != '\0') previousDigit = digit;
+	}
+
+	if (!key.empty()) key.resize(4, '0');	//Codes are always a letter and three digits, so short names are padded with zeroes.
+	return key;
+}
+
+
+void registerSqlFunctions(sqlite3* db) {
+	registerFunction(db, "PHONETIC_KEY", 1, sqlPhoneticKey);
+	registerFunction(db, "EXTRACT_POSTCODE", 5, sqlExtractPostcode);
+	registerFunction(db, "TRIM_WS", 1, sqlTrimWhiteSpace);
+	registerFunction(db, "NORMALISE_NAME", 1, sqlNormaliseName);
+	registerFunction(db, "CREDIT_UTILISATION", 2, sqlCreditUtilisation);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <string_view>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Our own SQL functions, written in C++ and registered with each connection we open. They are all deterministic, so SQLite can use them
+//in indexes, triggers and generated columns as well as in ordinary queries.
+//NB: Any schema object which uses one of these (e.g. the phonetic key triggers) can only be written to by a connection which has them registered.
+//Other tools can still read the database as normal.
+
+//Registers every function below with the given connection. Should be called straight after the database is opened.
+void registerSqlFunctions(sqlite3* db);
+
+
+//PHONETIC_KEY(name) - The Soundex code of a name, e.g. both "Smith" and "Smyth" give "S530". Returns NULL for a NULL or letter-free name.
+std::string phoneticKey(std::string_view inName);
+
+//EXTRACT_POSTCODE(line1, line2, line3, line4, line5) - The normalised postcode found in an address, or an empty string. See extractPostcode() in Postcodes.h.
+
+//TRIM_WS(text) - The text with leading and trailing whitespace of every kind removed, as trimWhiteSpace() does. SQLite's own TRIM() only removes spaces.
+//NORMALISE_NAME(text) - The text trimmed, with each run of whitespace inside it collapsed to a single space and upper-cased, e.g. " j  smith" -> "J SMITH".
+//CREDIT_UTILISATION(credit_limit, outstanding_credit) - Outstanding credit as a fraction of the credit limit, or NULL if there is no positive limit.
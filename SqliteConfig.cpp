@@ -0,0 +1,393 @@
+//Standard library includes
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+//Project includes
+#include "SqliteConfig.h"
+#include "PreparedStatement.h"
+#include "SqlFunctions.h"
+
+namespace {
+
+	//SQLite's built-in lookaside size, which we go back to when an option asks for the default, as there's no way to read it back.
+	constexpr int defaultLookasideSlotSize{ 1200 };
+	constexpr int defaultLookasideSlots{ 100 };
+
+
+	//A simple size class allocator for SQLite. Most of SQLite's allocations are small and short-lived (parse trees, VDBE programs, row
+	//buffers), so rather than go back to malloc for each one, small blocks are carved out of 64 KB slabs and kept on a free list per size
+	//class when they're freed, ready for the next allocation of that size. Anything bigger than the largest class goes straight to malloc.
+	//Slabs are only handed back when SQLite shuts down, so memory use levels off at its peak rather than fragmenting the system heap.
+	//
+	//Every block starts with an 8 byte header holding its usable size, which xSize needs and which tells xFree where the block came from.
+	namespace PoolAllocator {
+
+		constexpr std::array<std::size_t, 7> classSizes{ 32, 64, 128, 256, 512, 1024, 2048 };
+		constexpr std::size_t headerSize{ 8 };
+		constexpr std::size_t slabSize{ 64 * 1024 };
+
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		std::mutex poolMutex;
+		std::array<FreeBlock*, classSizes.size()> freeLists{};
+		std::vector<void*> slabs;
+
+		//The index of the smallest class which fits inSize, or classSizes.size() if it needs its own malloc.
+		std::size_t sizeClass(std::size_t inSize) {
+			std::size_t index{ 0 };
+			while (index < classSizes.size() && classSizes[index] < inSize) ++index;
+			return index;
+		}
+
+		std::size_t& blockSize(void* inBlock) {
+			return *reinterpret_cast<std::size_t*>(static_cast<char*>(inBlock) - headerSize);
+		}
+
+		int roundUp(int inSize) {
+			const std::size_t index{ sizeClass(static_cast<std::size_t>(inSize)) };
+			if (index < classSizes.size()) return static_cast<int>(classSizes[index]);
+			return (inSize + 7) & ~7;
+		}
+
+		void* allocate(int inSize) {
+			const std::size_t size{ static_cast<std::size_t>(roundUp(inSize)) };
+			const std::size_t index{ sizeClass(size) };
+			char* block{ nullptr };
+
+			if (index == classSizes.size()) {
+				block = static_cast<char*>(std::malloc(headerSize + size));
+				if (!block) return nullptr;
+			}
+			else {
+				std::lock_guard lock{ poolMutex };
+				if (!freeLists[index]) {
+					//Out of blocks of this size, so carve up a new slab for them.
+					char* slab{ static_cast<char*>(std::malloc(slabSize)) };
+					if (!slab) return nullptr;
+					slabs.push_back(slab);
+					const std::size_t stride{ headerSize + size };
+					for (std::size_t offset{ 0 }; offset + stride <= slabSize; offset += stride) {
+						auto freeBlock{ reinterpret_cast<FreeBlock*>(slab + offset + headerSize) };
+						freeBlock->next = freeLists[index];
+						freeLists[index] = freeBlock;
+					}
+				}
+				block = reinterpret_cast<char*>(freeLists[index]) - headerSize;
+				freeLists[index] = freeLists[index]->next;
+			}
+
+			*reinterpret_cast<std::size_t*>(block) = size;
+			return block + headerSize;
+		}
+
+		void release(void* inBlock) {
+			const std::size_t index{ sizeClass(blockSize(inBlock)) };
+			if (index == classSizes.size()) {
+				std::free(static_cast<char*>(inBlock) - headerSize);
+				return;
+			}
+			std::lock_guard lock{ poolMutex };
+			auto freeBlock{ static_cast<FreeBlock*>(inBlock) };
+			freeBlock->next = freeLists[index];
+			freeLists[index] = freeBlock;
+		}
+
+		int size(void* inBlock) {
+			return static_cast<int>(blockSize(inBlock));
+		}
+
+		void* reallocate(void* inBlock, int inSize) {
+			if (static_cast<std::size_t>(roundUp(inSize)) == blockSize(inBlock)) return inBlock;
+			void* newBlock{ allocate(inSize) };
+			if (!newBlock) return nullptr;
+			std::memcpy(newBlock, inBlock, std::min<std::size_t>(blockSize(inBlock), static_cast<std::size_t>(inSize)));
+			release(inBlock);
+			return newBlock;
+		}
+
+		int initialise(void*) {
+			return SQLITE_OK;
+		}
+
+		//SQLite has freed everything by the time this is called, so the slabs can all go.
+		void shutdown(void*) {
+			std::lock_guard lock{ poolMutex };
+			for (void* slab : slabs) std::free(slab);
+			slabs.clear();
+			freeLists.fill(nullptr);
+		}
+
+		sqlite3_mem_methods methods{ allocate, release, reallocate, size, roundUp, initialise, shutdown, nullptr };
+	}
+
+
+	//SQLite's own allocator, which we ask for back when the pool allocator or heap isn't wanted. Until SQLite first initialises, this is all
+	//zeroes, which tells it to pick its default.
+	sqlite3_mem_methods defaultMemMethods{};
+	bool defaultMemMethodsSaved{ false };
+
+	//The fixed heap and page cache handed to SQLite. They have to stay put for as long as SQLite is using them.
+	std::unique_ptr<char[]> heapBuffer;
+	std::unique_ptr<char[]> pageCacheBuffer;
+
+
+	void checkConfig(int status, const std::string& inSetting) {
+		if (status != SQLITE_OK) throw std::runtime_error{ "SQLite would not accept the " + inSetting + " setting: " + sqlite3_errstr(status) };
+	}
+
+}
+
+
+void configureSqlite(const SqliteConfigOptions& inOptions) {
+	if (!defaultMemMethodsSaved) {
+		checkConfig(sqlite3_config(SQLITE_CONFIG_GETMALLOC, &defaultMemMethods), "allocator");
+		defaultMemMethodsSaved = true;
+	}
+
+	//Each setting is made every time, even when it's the default, as SQLite keeps its settings through a shutdown.
+	if (inOptions.heapBytes > 0 && inOptions.poolAllocator) throw std::runtime_error{ "Only one of the fixed heap and the pool allocator can be used at a time" };
+	if (inOptions.heapBytes > 0) {
+		if (!sqlite3_compileoption_used("ENABLE_MEMSYS5")) throw std::runtime_error{ "This SQLite build has no fixed heap allocator (it needs SQLITE_ENABLE_MEMSYS5). Try the pool allocator instead." };
+		//SQLite takes the heap's size as an int, so anything from 2 GB up would wrap around.
+		if (inOptions.heapBytes > static_cast<std::size_t>(std::numeric_limits<int>::max())) throw std::runtime_error{ "SQLite would not accept the heap setting: it must be under 2 GB" };
+		heapBuffer = std::make_unique<char[]>(inOptions.heapBytes);
+		checkConfig(sqlite3_config(SQLITE_CONFIG_HEAP, heapBuffer.get(), static_cast<int>(inOptions.heapBytes), 32), "heap");
+	}
+	else {
+		checkConfig(sqlite3_config(SQLITE_CONFIG_MALLOC, inOptions.poolAllocator ? &PoolAllocator::methods : &defaultMemMethods), "allocator");
+		heapBuffer.reset();
+	}
+
+	if (inOptions.pageCachePages > 0) {
+		//Each page cache slot holds a page plus SQLite's header for it.
+		int headerSize{ 0 };
+		checkConfig(sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &headerSize), "page cache");
+		const int slotSize{ (inOptions.pageCachePageSize + headerSize + 7) & ~7 };
+		pageCacheBuffer = std::make_unique<char[]>(static_cast<std::size_t>(slotSize) * inOptions.pageCachePages);
+		checkConfig(sqlite3_config(SQLITE_CONFIG_PAGECACHE, pageCacheBuffer.get(), slotSize, inOptions.pageCachePages), "page cache");
+	}
+	else {
+		checkConfig(sqlite3_config(SQLITE_CONFIG_PAGECACHE, nullptr, 0, 0), "page cache");
+		pageCacheBuffer.reset();
+	}
+
+	checkConfig(sqlite3_config(SQLITE_CONFIG_LOOKASIDE,
+		inOptions.lookasideSlotSize < 0 ? defaultLookasideSlotSize : inOptions.lookasideSlotSize,
+		inOptions.lookasideSlots < 0 ? defaultLookasideSlots : inOptions.lookasideSlots), "lookaside");
+
+	switch (inOptions.threading) {
+	case ThreadingMode::Serialized:
+		checkConfig(sqlite3_config(SQLITE_CONFIG_SERIALIZED), "threading mode");
+		break;
+	case ThreadingMode::MultiThread:
+		checkConfig(sqlite3_config(SQLITE_CONFIG_MULTITHREAD), "threading mode");
+		break;
+	case ThreadingMode::SingleThread:
+		checkConfig(sqlite3_config(SQLITE_CONFIG_SINGLETHREAD), "threading mode");
+		break;
+	}
+}
+
+
+std::string describeSqliteConfig(const SqliteConfigOptions& inOptions) {
+	std::vector<std::string> parts;
+	if (inOptions.heapBytes > 0) parts.push_back(std::to_string(inOptions.heapBytes >> 20) + " MB fixed heap");
+	if (inOptions.poolAllocator) parts.push_back("pool allocator");
+	if (inOptions.pageCachePages > 0) parts.push_back(std::to_string(inOptions.pageCachePages) + " page preallocated cache");
+	if (inOptions.lookasideSlots == 0) parts.push_back("lookaside off");
+	else if (inOptions.lookasideSlotSize >= 0 || inOptions.lookasideSlots >= 0) {
+		parts.push_back("lookaside " + std::to_string(inOptions.lookasideSlotSize < 0 ? defaultLookasideSlotSize : inOptions.lookasideSlotSize) + "x"
+			+ std::to_string(inOptions.lookasideSlots < 0 ? defaultLookasideSlots : inOptions.lookasideSlots));
+	}
+	if (inOptions.threading == ThreadingMode::MultiThread) parts.push_back("multi-thread");
+	if (inOptions.threading == ThreadingMode::SingleThread) parts.push_back("single-thread");
+	if (parts.empty()) return "SQLite defaults";
+
+	std::string description{ parts.front() };
+	for (std::size_t i = 1; i < parts.size(); ++i) description += ", " + parts[i];
+	return description;
+}
+
+
+namespace {
+
+	//Looks up customers by short name, preparing a fresh statement every time, the way most of the menu options do.
+	void lookupWorkload(sqlite3* db, const std::vector<std::string>& inShortNames) {
+		for (int i = 0; i < 20000; ++i) {
+			PreparedStatement select{ db, "SELECT * FROM Customers WHERE Customer_Short_Name = ?;" };
+			const std::string& shortName{ inShortNames[i % inShortNames.size()] };
+			sqlite3_bind_text(select.get(), 1, shortName.c_str(), -1, SQLITE_STATIC);
+			while (select.stepRow());
+		}
+	}
+
+	//Reads every customer and address, and sorts the customers, as the reports and exports do.
+	void scanWorkload(sqlite3* db) {
+		for (int i = 0; i < 5; ++i) {
+			for (const char* statement : { "SELECT COUNT(*), SUM(LENGTH(First_Name) + LENGTH(Last_Name)) FROM Customers;",
+				"SELECT COUNT(*) FROM CustomerAddress WHERE Address_Line_1 LIKE '%1%';",
+				"SELECT Customer_Short_Name FROM Customers ORDER BY Last_Name, First_Name;" }) {
+				PreparedStatement select{ db, statement };
+				while (select.stepRow());
+			}
+		}
+	}
+
+	//Adds a batch of customers through the insert triggers, then rolls them back so that every run starts from the same data.
+	void insertWorkload(sqlite3* db) {
+		if (sqlite3_exec(db, "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL) != SQLITE_OK) throw std::runtime_error{ "Error starting transaction: " + std::string{ sqlite3_errmsg(db) } };
+		try {
+			PreparedStatement insert{ db, "INSERT INTO Customers(Customer_Short_Name, First_Name, Last_Name, Group_Name, Credit_Limit, Outstanding_Credit, Created_On, Updated_On) \
+				VALUES(?, 'Bench', ?, 'BENCHMARK', 1000, 0, CAST(strftime('%s','now') AS INTEGER), CAST(strftime('%s','now') AS INTEGER));" };
+			for (int i = 0; i < 5000; ++i) {
+				const std::string shortName{ "ZZBENCHMARK" + std::to_string(i) };
+				const std::string lastName{ "Benchmark" + std::to_string(i % 97) };
+				sqlite3_reset(insert.get());
+				sqlite3_bind_text(insert.get(), 1, shortName.c_str(), -1, SQLITE_TRANSIENT);
+				sqlite3_bind_text(insert.get(), 2, lastName.c_str(), -1, SQLITE_TRANSIENT);
+				insert.stepRow();
+			}
+		}
+		catch (std::exception&) {
+			sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+			throw;
+		}
+		sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+	}
+
+	struct BenchmarkResult {
+		double lookupSeconds{ 0 };
+		double scanSeconds{ 0 };
+		double insertSeconds{ 0 };
+		sqlite3_int64 peakMemory{ 0 };
+		sqlite3_int64 peakPageCache{ 0 };
+	};
+
+	BenchmarkResult runBenchmark(const std::string& inDatabasePath) {
+		sqlite3* db{ nullptr };
+		if (sqlite3_open_v2(inDatabasePath.c_str(), &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+			std::string errorMessage{ "Error opening benchmark database: " + std::string{ sqlite3_errmsg(db) } };
+			sqlite3_close(db);
+			throw std::runtime_error{ errorMessage };
+		}
+
+		BenchmarkResult result;
+		try {
+			registerSqlFunctions(db);
+			std::vector<std::string> shortNames;
+			{
+				PreparedStatement select{ db, "SELECT Customer_Short_Name FROM Customers;" };
+				while (select.stepRow()) shortNames.push_back(select.columnText(0));
+			}
+			if (shortNames.empty()) throw std::runtime_error{ "There are no customers to benchmark with" };
+
+			sqlite3_int64 current{ 0 }, peak{ 0 };
+			sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &peak, 1);
+			sqlite3_status64(SQLITE_STATUS_PAGECACHE_USED, &current, &peak, 1);
+
+			auto timed{ [](auto workload) {
+				const auto started{ std::chrono::steady_clock::now() };
+				workload();
+				return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+			} };
+			result.lookupSeconds = timed([&] { lookupWorkload(db, shortNames); });
+			result.scanSeconds = timed([&] { scanWorkload(db); });
+			result.insertSeconds = timed([&] { insertWorkload(db); });
+
+			sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &result.peakMemory, 0);
+			sqlite3_status64(SQLITE_STATUS_PAGECACHE_USED, &current, &result.peakPageCache, 0);
+		}
+		catch (std::exception&) {
+			sqlite3_close(db);
+			throw;
+		}
+		sqlite3_close(db);
+		return result;
+	}
+
+}
+
+
+void runSqliteConfigBenchmark(const std::string& inDatabasePath, std::ostream& out) {
+	//Work on a copy, so that the real database is never touched, and so that each run starts from the same file.
+	const std::string scratchPath{ inDatabasePath + "-benchmark" };
+	{
+		sqlite3* from{ nullptr };
+		sqlite3* to{ nullptr };
+		int fromStatus{ sqlite3_open_v2(inDatabasePath.c_str(), &from, SQLITE_OPEN_READONLY, NULL) };
+		int toStatus{ sqlite3_open_v2(scratchPath.c_str(), &to, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) };
+		int copyStatus{ SQLITE_ERROR };
+		if (fromStatus == SQLITE_OK && toStatus == SQLITE_OK) {
+			if (sqlite3_backup* backup{ sqlite3_backup_init(to, "main", from, "main") }) {
+				copyStatus = sqlite3_backup_step(backup, -1);
+				sqlite3_backup_finish(backup);
+			}
+		}
+		sqlite3_close(from);
+		sqlite3_close(to);
+		if (copyStatus != SQLITE_DONE) {
+			std::remove(scratchPath.c_str());
+			throw std::runtime_error{ "Could not copy " + inDatabasePath + " to benchmark against" };
+		}
+	}
+
+	SqliteConfigOptions pool;
+	pool.poolAllocator = true;
+	SqliteConfigOptions heap;
+	heap.heapBytes = 64 << 20;
+	SqliteConfigOptions pageCache;
+	pageCache.pageCachePages = 2000;
+	SqliteConfigOptions bigLookaside;
+	bigLookaside.lookasideSlotSize = 512;
+	bigLookaside.lookasideSlots = 512;
+	SqliteConfigOptions noLookaside;
+	noLookaside.lookasideSlotSize = 0;
+	noLookaside.lookasideSlots = 0;
+	SqliteConfigOptions multiThread;
+	multiThread.threading = ThreadingMode::MultiThread;
+	SqliteConfigOptions singleThread;
+	singleThread.threading = ThreadingMode::SingleThread;
+	SqliteConfigOptions combined{ pool };
+	combined.pageCachePages = 2000;
+	combined.lookasideSlotSize = 512;
+	combined.lookasideSlots = 512;
+	combined.threading = ThreadingMode::MultiThread;
+
+	const SqliteConfigOptions configurations[]{ {}, pool, heap, pageCache, bigLookaside, noLookaside, multiThread, singleThread, combined };
+
+	out << "Benchmarking SQLite settings against a copy of " << inDatabasePath << ".\n"
+		"Lookups prepare a statement for each of 20,000 short name searches, scans read every customer and address five times over, and\n"
+		"inserts add 5,000 customers in one transaction before rolling them back. Peak heap doesn't include the preallocated page cache.\n\n"
+		<< std::right << std::setw(9) << "Lookups" << std::setw(9) << "Scans" << std::setw(9) << "Inserts" << std::setw(12) << "Peak heap" << std::setw(13) << "Cache pages"
+		<< "  Settings\n" << std::fixed << std::setprecision(3);
+
+	for (const auto& configuration : configurations) {
+		try {
+			sqlite3_shutdown();
+			configureSqlite(configuration);
+			sqlite3_initialize();
+			const BenchmarkResult result{ runBenchmark(scratchPath) };
+			out << std::setw(8) << result.lookupSeconds << 's' << std::setw(8) << result.scanSeconds << 's' << std::setw(8) << result.insertSeconds << 's'
+				<< std::setw(9) << result.peakMemory / 1024 << " KB" << std::setw(13) << result.peakPageCache << "  " << describeSqliteConfig(configuration) << '\n';
+		}
+		catch (std::exception& e) {
+			out << "  Not run: " << describeSqliteConfig(configuration) << " - " << e.what() << '\n';
+		}
+	}
+
+	sqlite3_shutdown();
+	configureSqlite({});
+	std::remove(scratchPath.c_str());
+}
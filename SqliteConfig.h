@@ -0,0 +1,41 @@
+#pragma once
+
+//Standard library includes
+#include <string>
+#include <ostream>
+#include <cstddef>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Process-wide SQLite settings, made through sqlite3_config(). SQLite only accepts these before it is initialised (which opening the first
+//connection does) or after sqlite3_shutdown(), so they're given as startup options and applied at the very top of main().
+
+enum class ThreadingMode {
+	Serialized,			//SQLite's default. Any connection can be used from any thread.
+	MultiThread,		//No locking inside a connection, so each connection must only be used by one thread at a time. Ours already are.
+	SingleThread		//No locking at all. Background maintenance and the status log need a second thread, so they're turned off.
+};
+
+struct SqliteConfigOptions {
+	std::size_t heapBytes{ 0 };				//Non-zero to give SQLite one fixed heap of this size (SQLITE_CONFIG_HEAP). Needs a build with SQLITE_ENABLE_MEMSYS5.
+	bool poolAllocator{ false };			//Use our own size class pool allocator instead of plain malloc (SQLITE_CONFIG_MALLOC).
+	int pageCachePages{ 0 };				//Non-zero to preallocate room for this many cache pages (SQLITE_CONFIG_PAGECACHE).
+	int pageCachePageSize{ 4096 };			//The page size the preallocated cache is laid out for. Bigger pages than this go to the heap instead.
+	int lookasideSlotSize{ -1 };			//Each connection's lookaside slot size and count (SQLITE_CONFIG_LOOKASIDE). -1 to leave SQLite's default,
+	int lookasideSlots{ -1 };				//and 0 slots to turn lookaside off.
+	ThreadingMode threading{ ThreadingMode::Serialized };
+};
+
+//Applies the options. Throws std::runtime_error if SQLite refuses one, e.g. because it's already initialised or wasn't built with the feature.
+//Buffers for the heap and page cache are owned here and kept until the next call, so this must not be called while any connection is open.
+void configureSqlite(const SqliteConfigOptions& inOptions);
+
+//A one-line summary of the options, e.g. "pool allocator, lookaside 512x256, multi-thread".
+std::string describeSqliteConfig(const SqliteConfigOptions& inOptions);
+
+//Times a set of workloads like ours - prepare-heavy lookups, whole table scans and a batch of inserts - against a scratch copy of the
+//database under each of the options above in turn, and prints how long each took and the peak memory SQLite used. SQLite is shut down
+//and reconfigured between runs, so this must be called before any connection is opened, and leaves SQLite with its default settings.
+void runSqliteConfigBenchmark(const std::string& inDatabasePath, std::ostream& out);
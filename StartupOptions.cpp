@@ -0,0 +1,129 @@
+//Standard library includes
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+//Project includes
+#include "StartupOptions.h"
+
+namespace {
+
+	//Reads a whole number from inText, which must be all digits and no bigger than inMaximum.
+	int parseNumber(std::string_view inText, int inMaximum, std::string_view inOption) {
+		int value{ 0 };
+		auto [end, error] { std::from_chars(inText.data(), inText.data() + inText.size(), value) };
+		if (error != std::errc{} || end != inText.data() + inText.size() || value < 0 || value > inMaximum) {
+			throw std::invalid_argument{ "Bad value for " + std::string{ inOption } + ": " + std::string{ inText } };
+		}
+		return value;
+	}
+
+}
+
+
+StartupOptions parseStartupOptions(int argc, char* argv[]) {
+	StartupOptions options;
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view argument{ argv[i] };
+		const auto equals{ argument.find('=') };
+		const std::string_view option{ argument.substr(0, equals) };
+		const std::string_view value{ equals == std::string_view::npos ? std::string_view{} : argument.substr(equals + 1) };
+
+		if (option == "--help" || option == "-h" || option == "/?") options.showUsage = true;
+		else if (option == "--heap") options.sqlite.heapBytes = static_cast<std::size_t>(parseNumber(value, 2047, option)) << 20;
+		else if (option == "--pool-allocator") options.sqlite.poolAllocator = true;
+		else if (option == "--page-cache") options.sqlite.pageCachePages = parseNumber(value, 1 << 20, option);
+		else if (option == "--lookaside") {
+			if (value == "off") {
+				options.sqlite.lookasideSlotSize = 0;
+				options.sqlite.lookasideSlots = 0;
+			}
+			else {
+				const auto times{ value.find('x') };
+				if (times == std::string_view::npos) throw std::invalid_argument{ "Bad value for --lookaside, which should be e.g. 512x256 or off: " + std::string{ value } };
+				options.sqlite.lookasideSlotSize = parseNumber(value.substr(0, times), 65536, option);
+				options.sqlite.lookasideSlots = parseNumber(value.substr(times + 1), 65536, option);
+			}
+		}
+		else if (option == "--threading") {
+			if (value == "serialized") options.sqlite.threading = ThreadingMode::Serialized;
+			else if (value == "multi") options.sqlite.threading = ThreadingMode::MultiThread;
+			else if (value == "single") options.sqlite.threading = ThreadingMode::SingleThread;
+			else throw std::invalid_argument{ "Bad value for --threading, which should be serialized, multi or single: " + std::string{ value } };
+		}
+		else if (option == "--in-memory") {
+			options.inMemory = true;
+			if (!value.empty()) options.saveIntervalSeconds = parseNumber(value, 86400, option);
+		}
+		else if (option == "--busy-timeout") options.busy.timeout = std::chrono::milliseconds{ parseNumber(value, 3600000, option) };
+		else if (option == "--busy-max-delay") options.busy.maxDelay = std::chrono::milliseconds{ std::max(parseNumber(value, 60000, option), 1) };
+		else if (option == "--batch") options.batch = true;
+		else if (option == "--batch-rows") {
+			options.batch = true;
+			options.batchLimits.maxRows = static_cast<std::size_t>(parseNumber(value, 10000000, option));
+		}
+		else if (option == "--batch-ms") {
+			options.batch = true;
+			options.batchLimits.maxTime = std::chrono::milliseconds{ parseNumber(value, 3600000, option) };
+		}
+		else if (option == "--read-only") options.readOnly = true;
+		else if (option == "--immutable") options.readOnly = options.immutable = true;
+		else if (option == "--serve-http") {
+			options.serveHttp = true;
+			if (!value.empty()) options.httpPort = std::max(parseNumber(value, 65535, option), 1);
+		}
+		else if (option == "--serve-lookups") {
+			options.serveLookups = true;
+			if (!value.empty()) options.lookupSocket = std::string{ value };
+		}
+		else if (option == "--benchmark-sqlite-config") options.benchmarkSqliteConfig = true;
+		else throw std::invalid_argument{ "Unrecognised option: " + std::string{ argument } };
+	}
+	if (options.readOnly && options.inMemory) throw std::invalid_argument{ "--in-memory can't be used with --read-only or --immutable" };
+	//The servers' worker threads each open their own connection to the file, which would never see a private in-memory copy.
+	const bool serving{ options.serveHttp || options.serveLookups };
+	if (options.serveHttp && options.serveLookups) throw std::invalid_argument{ "--serve-http and --serve-lookups can't be used together. Run a copy of the program for each" };
+	if (serving && options.inMemory) throw std::invalid_argument{ "--in-memory can't be used with --serve-http or --serve-lookups" };
+	if (serving && options.sqlite.threading == ThreadingMode::SingleThread) throw std::invalid_argument{ "--serve-http and --serve-lookups can't be used with --threading=single" };
+	return options;
+}
+
+
+void printStartupUsage(std::ostream& out) {
+	out << "Usage: CustomerTracker [options]\n"
+		"\n"
+		"SQLite memory and threading (see the README for when each helps):\n"
+		"  --heap=<MB>                Give SQLite a fixed heap of this many megabytes, up to 2047. Needs SQLite built with SQLITE_ENABLE_MEMSYS5.\n"
+		"  --pool-allocator           Serve SQLite's small allocations from size class pools rather than malloc.\n"
+		"  --page-cache=<pages>       Preallocate room for this many 4 KB database pages.\n"
+		"  --lookaside=<size>x<count> Give each connection <count> lookaside slots of <size> bytes, or 'off'.\n"
+		"  --threading=<mode>         serialized (the default), multi, or single. Single turns off background maintenance.\n"
+		"  --benchmark-sqlite-config  Time each of the settings above against a copy of the database, then exit.\n"
+		"\n"
+		"Database:\n"
+		"  --in-memory[=<seconds>]    Load the database into memory and work on it there, saving it back to the file every <seconds>\n"
+		"                             (300 by default, or 0 for only at exit) and when the program exits. The file is locked until\n"
+		"                             then, so nothing else can open it, as each save would overwrite its changes.\n"
+		"  --read-only                Open the database read-only, e.g. for reporting alongside another copy of the program which\n"
+		"                             is making changes. Nothing is written at startup, and the menus which make changes are off.\n"
+		"  --batch                    Run as a batch job alongside people using the program interactively. Imports are committed\n"
+		"                             in chunks, giving way to any interactive writer waiting between them, and the menus' writes\n"
+		"                             are reported as batch writes.\n"
+		"  --batch-rows=<rows>        The most rows a batch writes in one transaction (5000 by default, 0 for no limit). Implies --batch.\n"
+		"  --batch-ms=<ms>            The longest a batch holds one transaction open (100 by default, 0 for no limit). Implies --batch.\n"
+		"  --busy-timeout=<ms>        How long to keep retrying when another connection has the database locked, before giving up\n"
+		"                             with an error (5000 by default). Retries back off exponentially, with some randomness.\n"
+		"  --busy-max-delay=<ms>      The longest pause between retries (100 by default).\n"
+		"  --immutable                As --read-only, for a snapshot copy of the database which nothing will change. SQLite takes\n"
+		"                             no locks on it at all. Don't use this on a database which is in use.\n"
+		"\n"
+		"Serving:\n"
+		"  --serve-http[=<port>]      Serve the customer database as JSON over HTTP on 127.0.0.1 (port 8080 by default), instead\n"
+		"                             of showing the menus, until stopped with Ctrl+C. See the README for the requests it answers.\n"
+		"  --serve-lookups[=<path>]   Answer customer lookups in a compact binary protocol on a Unix socket (Customers.sock by\n"
+		"                             default), instead of showing the menus, until stopped with Ctrl+C. See LookupProtocol.h.\n"
+		"\n"
+		"  --help                     Show this message.\n";
+}
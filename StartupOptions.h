@@ -0,0 +1,35 @@
+#pragma once
+
+//Standard library includes
+#include <ostream>
+#include <string>
+
+//Project includes
+#include "SqliteConfig.h"
+#include "BusyHandler.h"
+#include "WriteScheduler.h"
+
+
+//The options the program can be started with. Run with --help for the list.
+
+struct StartupOptions {
+	SqliteConfigOptions sqlite;
+	BusyHandler::Settings busy;					//How the main connection waits for locks held by other connections.
+	bool batch{ false };						//This copy is running a batch job, so its writes give way to interactive ones. See WriteScheduler.h.
+	BatchWriteLimits batchLimits{ 5000, std::chrono::milliseconds{ 100 } };		//The most a batch writes in one transaction.
+	bool inMemory{ false };						//Work on a copy of the database in memory. See MemoryDatabase.h.
+	int saveIntervalSeconds{ 300 };				//How often an in-memory database is saved back to its file. 0 to save only at exit.
+	bool readOnly{ false };						//Open the database read-only, for reporting. Nothing is written at startup and the write menus are off.
+	bool immutable{ false };					//As readOnly, but also promise SQLite the file won't change, so it takes no locks at all.
+	bool serveHttp{ false };					//Serve the JSON interface on localhost instead of showing the menus. See CustomerApi.h.
+	int httpPort{ 8080 };
+	bool serveLookups{ false };					//Serve binary customer lookups on a Unix socket instead of showing the menus. See LookupServer.h.
+	std::string lookupSocket{ "Customers.sock" };
+	bool benchmarkSqliteConfig{ false };		//Time each of the SQLite settings against the database, then exit.
+	bool showUsage{ false };
+};
+
+//Reads the command line. Throws std::invalid_argument naming the option if one isn't recognised or its value doesn't make sense.
+StartupOptions parseStartupOptions(int argc, char* argv[]);
+
+void printStartupUsage(std::ostream& out);
@@ -0,0 +1,60 @@
+//Standard library includes
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+
+//Project includes
+#include "StopSignals.h"
+
+#ifdef __linux__
+#include <unistd.h>
+
+namespace {
+
+	//Where the handler wakes the running event loop. Signal handlers can only do very little safely, and write() is one of those things.
+	std::atomic<int> signalWakeFd{ -1 };
+	volatile std::sig_atomic_t stopSignalled{ 0 };
+
+	struct sigaction oldInterrupt {}, oldTerminate {};
+
+	extern "C" void onStopSignal(int) {
+		stopSignalled = 1;
+		const int fd{ signalWakeFd.load() };
+		if (fd >= 0) {
+			const std::uint64_t one{ 1 };
+			[[maybe_unused]] auto written{ ::write(fd, &one, sizeof(one)) };
+		}
+	}
+
+}
+
+
+StopSignalScope::StopSignalScope(int inWakeFd) {
+	struct sigaction action {};
+	action.sa_handler = onStopSignal;
+	sigemptyset(&action.sa_mask);
+	stopSignalled = 0;
+	signalWakeFd = inWakeFd;
+	::sigaction(SIGINT, &action, &oldInterrupt);
+	::sigaction(SIGTERM, &action, &oldTerminate);
+}
+
+
+StopSignalScope::~StopSignalScope() {
+	::sigaction(SIGINT, &oldInterrupt, nullptr);
+	::sigaction(SIGTERM, &oldTerminate, nullptr);
+	signalWakeFd = -1;
+}
+
+
+bool StopSignalScope::signalled() const {
+	return stopSignalled != 0;
+}
+
+#else
+
+StopSignalScope::StopSignalScope(int) {}
+StopSignalScope::~StopSignalScope() {}
+bool StopSignalScope::signalled() const { return false; }
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+
+//Lets a server's event loop stop cleanly on Ctrl+C (SIGINT) or SIGTERM, rather than the process being killed with connections open and
+//work part done. While one of these exists, either signal sets a flag and writes to the event loop's wake-up eventfd, so the loop sees it at
+//once; the handlers which were there before go back when it's destroyed. Only one should exist at a time.
+//
+//Signals like these are a POSIX matter, so elsewhere this does nothing.
+class StopSignalScope {
+public:
+	explicit StopSignalScope(int inWakeFd);
+	~StopSignalScope();
+	StopSignalScope(const StopSignalScope&) = delete;
+	StopSignalScope& operator=(const StopSignalScope&) = delete;
+
+	bool signalled() const;
+};
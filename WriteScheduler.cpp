@@ -0,0 +1,197 @@
+//Standard library includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+//Project includes
+#include "WriteScheduler.h"
+#include "CustomerTracker.h"
+
+namespace {
+
+	//Interactive writers in this process waiting for the write lock right now.
+	std::atomic<int> interactiveWritersWaiting{ 0 };
+
+	//Markers older than this are taken to be left over from a copy of the program which crashed while waiting.
+	constexpr auto staleMarkerAge{ std::chrono::minutes{ 1 } };
+
+	//Each class keeps running totals, plus its most recent delays in a ring for the percentiles.
+	class DelayRecord {
+	public:
+		void add(std::chrono::microseconds inDelay) {
+			std::lock_guard lock{ m_mutex };
+			++m_stats.writes;
+			m_stats.totalDelay += inDelay;
+			m_stats.maxDelay = std::max(m_stats.maxDelay, inDelay);
+			if (m_recent.size() < recentSize) m_recent.push_back(inDelay);
+			else m_recent[m_next] = inDelay;
+			m_next = (m_next + 1) % recentSize;
+		}
+
+		WriteQueueStats stats() const {
+			std::unique_lock lock{ m_mutex };
+			WriteQueueStats stats{ m_stats };
+			std::vector<std::chrono::microseconds> recent{ m_recent };
+			lock.unlock();
+
+			if (recent.empty()) return stats;
+			auto percentile{ [&](std::size_t percent) {
+				auto position{ recent.begin() + (recent.size() - 1) * percent / 100 };
+				std::nth_element(recent.begin(), position, recent.end());
+				return *position;
+			} };
+			stats.medianDelay = percentile(50);
+			stats.p99Delay = percentile(99);
+			return stats;
+		}
+
+	private:
+		static constexpr std::size_t recentSize{ 1000 };
+		mutable std::mutex m_mutex;
+		WriteQueueStats m_stats;
+		std::vector<std::chrono::microseconds> m_recent;
+		std::size_t m_next{ 0 };
+	};
+
+	std::array<DelayRecord, 2> delayRecords;
+
+	DelayRecord& delayRecord(WritePriority inPriority) {
+		return delayRecords[inPriority == WritePriority::Interactive ? 0 : 1];
+	}
+
+	//The file the connection's main database lives in, or empty if it's in memory (or a temporary database), where nobody else can be waiting.
+	std::string databasePath(sqlite3* db) {
+		const char* path{ sqlite3_db_filename(db, "main") };
+		return path ? path : "";
+	}
+
+	std::string markerPrefix(const std::string& inDatabasePath) {
+		return std::filesystem::path{ inDatabasePath }.filename().string() + "-interactive-";
+	}
+
+	//Announces an interactive writer's wait for the lock to this process and to any others using the same database, for as long as it lives.
+	//The marker is only a hint, so if it can't be made, or removed, we carry on regardless.
+	class InteractiveWait {
+	public:
+		explicit InteractiveWait(const std::string& inDatabasePath) {
+			++interactiveWritersWaiting;
+			if (inDatabasePath.empty()) return;
+
+			std::random_device random;
+			std::ostringstream name;
+			name << inDatabasePath << "-interactive-" << std::hex << random() << random();
+			m_markerPath = name.str();
+			std::ofstream{ m_markerPath };
+		}
+		~InteractiveWait() {
+			--interactiveWritersWaiting;
+			std::error_code error;
+			if (!m_markerPath.empty()) std::filesystem::remove(m_markerPath, error);
+		}
+		InteractiveWait(const InteractiveWait&) = delete;
+		InteractiveWait& operator=(const InteractiveWait&) = delete;
+
+	private:
+		std::string m_markerPath;
+	};
+
+	bool interactiveWriterWaiting(const std::string& inDatabasePath) {
+		if (interactiveWritersWaiting > 0) return true;
+		if (inDatabasePath.empty()) return false;
+
+		//Nothing here should stop a batch, so every filesystem call uses the non-throwing form, and an error just means nobody is waiting.
+		std::error_code error;
+		std::filesystem::path directory{ std::filesystem::path{ inDatabasePath }.parent_path() };
+		if (directory.empty()) directory = ".";
+		const std::string prefix{ markerPrefix(inDatabasePath) };
+		const auto now{ std::filesystem::file_time_type::clock::now() };
+		for (std::filesystem::directory_iterator entry{ directory, error }, end; !error && entry != end; entry.increment(error)) {
+			if (entry->path().filename().string().compare(0, prefix.size(), prefix) != 0) continue;
+			const auto written{ std::filesystem::last_write_time(entry->path(), error) };
+			if (!error && now - written < staleMarkerAge) return true;
+			error.clear();
+		}
+		return false;
+	}
+
+}
+
+
+void beginWrite(sqlite3* db, WritePriority inPriority) {
+	const auto askedAt{ std::chrono::steady_clock::now() };
+	{
+		std::optional<InteractiveWait> wait;
+		if (inPriority == WritePriority::Interactive) wait.emplace(databasePath(db));
+		executeStatement("BEGIN IMMEDIATE TRANSACTION", db, false);
+	}
+	delayRecord(inPriority).add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - askedAt));
+}
+
+
+WriteQueueStats writeQueueStats(WritePriority inPriority) {
+	return delayRecord(inPriority).stats();
+}
+
+
+BatchWriter::BatchWriter(sqlite3* db, BatchWriteLimits inLimits) : m_db{ db }, m_limits{ inLimits }, m_databasePath{ databasePath(db) } {
+	beginChunk();
+}
+
+
+BatchWriter::~BatchWriter() {
+	if (m_inTransaction) sqlite3_exec(m_db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+}
+
+
+void BatchWriter::rowWritten() {
+	++m_chunkRows;
+	const bool rowsUsedUp{ m_limits.maxRows > 0 && m_chunkRows >= m_limits.maxRows };
+	//Looking at the clock for every row of a big load would cost more than it saves, so the time limit is only checked every 64 rows.
+	const bool timeUsedUp{ m_limits.maxTime.count() > 0 && m_chunkRows % 64 == 0 && std::chrono::steady_clock::now() - m_chunkBegan >= m_limits.maxTime };
+	if (!rowsUsedUp && !timeUsedUp) return;
+
+	commitChunk();
+	yieldToInteractiveWriters();
+	beginChunk();
+}
+
+
+void BatchWriter::commit() {
+	if (m_inTransaction) commitChunk();
+}
+
+
+void BatchWriter::beginChunk() {
+	beginWrite(m_db, WritePriority::Batch);
+	m_inTransaction = true;
+	m_chunkRows = 0;
+	m_chunkBegan = std::chrono::steady_clock::now();
+}
+
+
+void BatchWriter::commitChunk() {
+	executeStatement("COMMIT TRANSACTION", m_db, false);
+	m_inTransaction = false;
+	m_rowsCommitted += m_chunkRows;
+	//A batch which ends just as a chunk fills leaves an empty one to commit, which isn't worth counting.
+	if (m_chunkRows > 0 || m_chunksCommitted == 0) ++m_chunksCommitted;
+}
+
+
+//Waits while anyone is waiting to make an interactive write, so that they get the lock before we take it again. Writers in other processes
+//only retry every so often, as their busy handler backs off, so we have to leave the lock free until they've had it, not just for a moment.
+void BatchWriter::yieldToInteractiveWriters() {
+	const auto began{ std::chrono::steady_clock::now() };
+	while (interactiveWriterWaiting(m_databasePath) && std::chrono::steady_clock::now() - began < m_limits.maxYield) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 2 });
+	}
+	m_timeYielded += std::chrono::steady_clock::now() - began;
+}
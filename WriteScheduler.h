@@ -0,0 +1,84 @@
+#pragma once
+
+//Standard library includes
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+//Third party includes
+#include<sqlite3.h>
+
+
+//Keeps long batch jobs from holding up people at the keyboard when both write to the same database.
+//
+//SQLite lets one connection write at a time, and a write transaction keeps the lock until it commits, so an import done in one transaction makes
+//every other writer wait until it finishes - or, past their busy timeout, fail. Writes are therefore split into two classes. Interactive writes
+//(a customer added from the menu) start with beginWrite(), and while they wait for the lock they let everyone know they're waiting. Batch writes
+//(an import started with --batch) go through a BatchWriter, which commits every so many rows or milliseconds, and at each commit gives way to
+//any interactive writer that is waiting, before taking the lock back and carrying on. An operator's write then waits at most for the rest of
+//one chunk, rather than for the rest of the import.
+//
+//Waiting writers in this process are counted in memory. Those in other copies of the program are found through empty marker files beside
+//the database, named after it with "-interactive-" and a random suffix, which each interactive writer makes while it waits and removes once it
+//has the lock. A copy which crashes mid-wait leaves its marker behind, so markers more than a minute old are ignored, and a batch never gives
+//way for longer than its maxYield between chunks in any case.
+//
+//Every write's queueing delay - from asking for the write lock to getting it - is recorded for its class, and shown in the SQLite statistics report.
+
+enum class WritePriority { Interactive, Batch };
+
+//Starts a write transaction with BEGIN IMMEDIATE, waiting for the lock through the connection's busy handler, and records how long that took.
+//Throws std::runtime_error if the lock can't be had.
+void beginWrite(sqlite3* db, WritePriority inPriority);
+
+struct WriteQueueStats {
+	std::size_t writes{ 0 };
+	std::chrono::microseconds totalDelay{ 0 };
+	std::chrono::microseconds maxDelay{ 0 };
+	std::chrono::microseconds medianDelay{ 0 };		//The percentiles are over the most recent 1000 writes, so they follow changes in load.
+	std::chrono::microseconds p99Delay{ 0 };
+};
+
+WriteQueueStats writeQueueStats(WritePriority inPriority);
+
+
+//How much a batch writes in each transaction. A limit of 0 is no limit, so with both at 0 the whole batch is one transaction.
+struct BatchWriteLimits {
+	std::size_t maxRows{ 0 };
+	std::chrono::milliseconds maxTime{ 0 };
+	std::chrono::milliseconds maxYield{ 2000 };		//The longest we'll give way to interactive writers between two chunks.
+};
+
+//Writes a batch in chunks of at most the given size, each in a transaction of its own. Construction begins the first chunk, rowWritten()
+//is called after each row, and commit() commits whatever is left. If the writer is destroyed without commit() - because a row failed and
+//the caller threw, say - the current chunk is rolled back, but chunks already committed stay in the database.
+class BatchWriter {
+public:
+	BatchWriter(sqlite3* db, BatchWriteLimits inLimits);
+	~BatchWriter();
+	BatchWriter(const BatchWriter&) = delete;
+	BatchWriter& operator=(const BatchWriter&) = delete;
+
+	//Once the chunk is full, commits it, lets any waiting interactive writers go first, and begins the next.
+	void rowWritten();
+	void commit();
+
+	std::size_t rowsCommitted() const { return m_rowsCommitted; }
+	std::size_t chunksCommitted() const { return m_chunksCommitted; }
+	std::chrono::milliseconds timeYielded() const { return std::chrono::duration_cast<std::chrono::milliseconds>(m_timeYielded); }
+
+private:
+	void beginChunk();
+	void commitChunk();
+	void yieldToInteractiveWriters();
+
+	sqlite3* m_db;
+	BatchWriteLimits m_limits;
+	std::string m_databasePath;				//Empty for an in-memory database, which no other process can be waiting for.
+	bool m_inTransaction{ false };
+	std::size_t m_chunkRows{ 0 };
+	std::chrono::steady_clock::time_point m_chunkBegan;
+	std::size_t m_rowsCommitted{ 0 };
+	std::size_t m_chunksCommitted{ 0 };
+	std::chrono::steady_clock::duration m_timeYielded{ 0 };
+};